@@ -0,0 +1,340 @@
+// Microbenchmarks for the promise engine: then: chains, fan-out, +when: joins,
+// cancellation and cross-thread resolve-to-callback latency.
+//
+//   make -C Benchmarks && Benchmarks/build/ks-benchmark [--json] [--filter name]
+//
+// Each case reports throughput, p50/p99 latency per iteration and heap
+// allocations per operation. --json prints the same numbers in a form that
+// can be stored and compared between releases.
+
+#import <Foundation/Foundation.h>
+#import "KSDeferred.h"
+#import "KSClock.h"
+#import "KSAllocationCounter.h"
+
+
+typedef struct {
+    uint64_t start;
+    uint64_t elapsed;
+    KSAllocationCount startCount;
+    uint64_t allocations;
+    uint64_t bytes;
+} KSBenchmarkSample;
+
+static inline void KSBenchmarkStartCounting(KSBenchmarkSample *sample) {
+    sample->startCount = KSAllocationCounterRead();
+}
+
+static inline void KSBenchmarkStopCounting(KSBenchmarkSample *sample) {
+    KSAllocationCount count = KSAllocationCounterRead();
+    sample->allocations += count.allocations - sample->startCount.allocations;
+    sample->bytes += count.bytes - sample->startCount.bytes;
+}
+
+static inline void KSBenchmarkStart(KSBenchmarkSample *sample) {
+    KSBenchmarkStartCounting(sample);
+    sample->start = KSClockNow();
+}
+
+static inline void KSBenchmarkStop(KSBenchmarkSample *sample) {
+    sample->elapsed += KSClockNow() - sample->start;
+    KSBenchmarkStopCounting(sample);
+}
+
+
+@interface KSBenchmarkResult : NSObject
+@property (copy, nonatomic) NSString *name;
+@property (assign, nonatomic) NSUInteger parameter;
+@property (assign, nonatomic) NSUInteger iterations;
+@property (assign, nonatomic) double operationsPerSecond;
+@property (assign, nonatomic) uint64_t p50;
+@property (assign, nonatomic) uint64_t p99;
+@property (assign, nonatomic) double allocationsPerOperation;
+@property (assign, nonatomic) double bytesPerOperation;
+@end
+
+@implementation KSBenchmarkResult
+
+- (NSDictionary *)dictionaryRepresentation {
+    return @{@"name": self.name,
+             @"parameter": @(self.parameter),
+             @"iterations": @(self.iterations),
+             @"ops_per_sec": @(self.operationsPerSecond),
+             @"p50_ns": @(self.p50),
+             @"p99_ns": @(self.p99),
+             @"allocs_per_op": @(self.allocationsPerOperation),
+             @"bytes_per_op": @(self.bytesPerOperation)};
+}
+
+@end
+
+
+static int KSCompareUInt64(const void *a, const void *b) {
+    uint64_t left = *(const uint64_t *)a;
+    uint64_t right = *(const uint64_t *)b;
+    return left < right ? -1 : left > right ? 1 : 0;
+}
+
+// Runs iteration `iterations` times after a short warm-up. iteration performs
+// `operations` operations and brackets the part to measure with
+// KSBenchmarkStart/KSBenchmarkStop. A case timed across threads sets
+// sample->elapsed itself and brackets the whole round trip with
+// KSBenchmarkStartCounting/KSBenchmarkStopCounting instead.
+static KSBenchmarkResult *KSBenchmarkRun(NSString *name,
+                                         NSUInteger parameter,
+                                         NSUInteger iterations,
+                                         NSUInteger operations,
+                                         void (^iteration)(KSBenchmarkSample *sample)) {
+    for (NSUInteger i = 0; i < MAX(iterations / 10, (NSUInteger)1); i++) {
+        @autoreleasepool {
+            KSBenchmarkSample sample = {0};
+            iteration(&sample);
+        }
+    }
+
+    uint64_t *latencies = calloc(iterations, sizeof(uint64_t));
+    uint64_t total = 0;
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+
+    KSAllocationCounterSetEnabled(YES);
+    for (NSUInteger i = 0; i < iterations; i++) {
+        @autoreleasepool {
+            KSBenchmarkSample sample = {0};
+            iteration(&sample);
+            latencies[i] = sample.elapsed;
+            total += sample.elapsed;
+            allocations += sample.allocations;
+            bytes += sample.bytes;
+        }
+    }
+    KSAllocationCounterSetEnabled(NO);
+
+    qsort(latencies, iterations, sizeof(uint64_t), KSCompareUInt64);
+
+    KSBenchmarkResult *result = [[KSBenchmarkResult alloc] init];
+    result.name = name;
+    result.parameter = parameter;
+    result.iterations = iterations;
+    result.operationsPerSecond = total > 0 ? (double)(iterations * operations) / KSClockInterval(total) : 0;
+    result.p50 = latencies[iterations / 2];
+    result.p99 = latencies[MIN(iterations - 1, iterations * 99 / 100)];
+    result.allocationsPerOperation = (double)allocations / (iterations * operations);
+    result.bytesPerOperation = (double)bytes / (iterations * operations);
+    free(latencies);
+    return result;
+}
+
+static NSUInteger KSBenchmarkIterations(NSUInteger parameter) {
+    return MAX((NSUInteger)50, (NSUInteger)200000 / MAX(parameter, (NSUInteger)1));
+}
+
+
+#pragma mark - Cases
+
+static NSArray *KSBenchmarkChainDepth(void) {
+    NSMutableArray *results = [NSMutableArray array];
+    for (NSNumber *depth in @[@1, @10, @100, @1000]) {
+        NSUInteger n = depth.unsignedIntegerValue;
+        [results addObject:KSBenchmarkRun(@"then-chain", n, KSBenchmarkIterations(n), n, ^(KSBenchmarkSample *sample) {
+            KSDeferred *deferred = [KSDeferred defer];
+            KSBenchmarkStart(sample);
+            KSPromise *promise = deferred.promise;
+            for (NSUInteger i = 0; i < n; i++) {
+                promise = [promise then:^id(id value) {
+                    return value;
+                }];
+            }
+            [deferred resolveWithValue:@1];
+            KSBenchmarkStop(sample);
+        })];
+    }
+    return results;
+}
+
+static NSArray *KSBenchmarkFanOut(void) {
+    NSMutableArray *results = [NSMutableArray array];
+    for (NSNumber *width in @[@10, @100, @1000]) {
+        NSUInteger n = width.unsignedIntegerValue;
+        [results addObject:KSBenchmarkRun(@"fan-out", n, KSBenchmarkIterations(n), n, ^(KSBenchmarkSample *sample) {
+            KSDeferred *deferred = [KSDeferred defer];
+            KSBenchmarkStart(sample);
+            for (NSUInteger i = 0; i < n; i++) {
+                [deferred.promise then:^id(id value) {
+                    return value;
+                }];
+            }
+            [deferred resolveWithValue:@1];
+            KSBenchmarkStop(sample);
+        })];
+    }
+    return results;
+}
+
+static NSArray *KSBenchmarkJoin(void) {
+    NSMutableArray *results = [NSMutableArray array];
+    for (NSNumber *size in @[@10, @100, @1000]) {
+        NSUInteger n = size.unsignedIntegerValue;
+        [results addObject:KSBenchmarkRun(@"when", n, KSBenchmarkIterations(n * 10), n, ^(KSBenchmarkSample *sample) {
+            NSMutableArray *deferreds = [NSMutableArray arrayWithCapacity:n];
+            NSMutableArray *promises = [NSMutableArray arrayWithCapacity:n];
+            for (NSUInteger i = 0; i < n; i++) {
+                KSDeferred *deferred = [KSDeferred defer];
+                [deferreds addObject:deferred];
+                [promises addObject:deferred.promise];
+            }
+            KSBenchmarkStart(sample);
+            [KSPromise when:promises];
+            for (KSDeferred *deferred in deferreds) {
+                [deferred resolveWithValue:@1];
+            }
+            KSBenchmarkStop(sample);
+        })];
+    }
+    return results;
+}
+
+static NSArray *KSBenchmarkCancellation(void) {
+    NSMutableArray *results = [NSMutableArray array];
+    for (NSNumber *depth in @[@10, @100, @1000]) {
+        NSUInteger n = depth.unsignedIntegerValue;
+        [results addObject:KSBenchmarkRun(@"cancel-chain", n, KSBenchmarkIterations(n), n, ^(KSBenchmarkSample *sample) {
+            KSDeferred *deferred = [KSDeferred defer];
+            KSPromise *promise = deferred.promise;
+            for (NSUInteger i = 0; i < n; i++) {
+                promise = [promise then:nil];
+            }
+            KSBenchmarkStart(sample);
+            [promise cancel];
+            KSBenchmarkStop(sample);
+        })];
+    }
+    return results;
+}
+
+static NSArray *KSBenchmarkCrossThread(void) {
+    dispatch_queue_t resolver = dispatch_queue_create("KSBenchmark.resolver", DISPATCH_QUEUE_SERIAL);
+    id<KSExecutor> executor = [KSWorkStealingExecutor sharedExecutor];
+
+    KSBenchmarkResult *callback = KSBenchmarkRun(@"cross-thread-callback", 1, 20000, 1, ^(KSBenchmarkSample *sample) {
+        KSBenchmarkStartCounting(sample);
+        KSDeferred *deferred = [KSDeferred defer];
+        dispatch_semaphore_t done = dispatch_semaphore_create(0);
+        __block uint64_t resolvedAt = 0;
+        [deferred.promise then:^id(id value) {
+            sample->elapsed = KSClockNow() - resolvedAt;
+            dispatch_semaphore_signal(done);
+            return value;
+        } error:nil onExecutor:executor];
+        dispatch_async(resolver, ^{
+            resolvedAt = KSClockNow();
+            [deferred resolveWithValue:@1];
+        });
+        dispatch_semaphore_wait(done, DISPATCH_TIME_FOREVER);
+        KSBenchmarkStopCounting(sample);
+    });
+
+    KSBenchmarkResult *wait = KSBenchmarkRun(@"wait-for-value", 1, 20000, 1, ^(KSBenchmarkSample *sample) {
+        KSBenchmarkStartCounting(sample);
+        KSDeferred *deferred = [KSDeferred defer];
+        __block uint64_t resolvedAt = 0;
+        dispatch_async(resolver, ^{
+            resolvedAt = KSClockNow();
+            [deferred resolveWithValue:@1];
+        });
+        [deferred.promise waitForValue];
+        sample->elapsed = KSClockNow() - resolvedAt;
+        KSBenchmarkStopCounting(sample);
+    });
+
+    return @[callback, wait];
+}
+
+#if defined(__linux__)
+static NSArray *KSBenchmarkEventLoop(void) {
+    KSEventLoopExecutor *loop = [[KSEventLoopExecutor alloc] init];
+    [NSThread detachNewThreadSelector:@selector(run) toTarget:loop withObject:nil];
+
+    KSBenchmarkResult *result = KSBenchmarkRun(@"event-loop-execute", 1, 20000, 1, ^(KSBenchmarkSample *sample) {
+        KSBenchmarkStartCounting(sample);
+        dispatch_semaphore_t done = dispatch_semaphore_create(0);
+        uint64_t submittedAt = KSClockNow();
+        [loop execute:^{
+            sample->elapsed = KSClockNow() - submittedAt;
+            dispatch_semaphore_signal(done);
+        }];
+        dispatch_semaphore_wait(done, DISPATCH_TIME_FOREVER);
+        KSBenchmarkStopCounting(sample);
+    });
+    [loop stop];
+    return @[result];
+}
+#endif
+
+
+#pragma mark - Reporting
+
+static void KSBenchmarkPrint(NSArray *results, BOOL json) {
+    if (json) {
+        NSMutableArray *benchmarks = [NSMutableArray array];
+        for (KSBenchmarkResult *result in results) {
+            [benchmarks addObject:[result dictionaryRepresentation]];
+        }
+        NSDictionary *report = @{@"suite": @"KSDeferred",
+                                 @"host": [[NSProcessInfo processInfo] hostName],
+                                 @"processors": @([[NSProcessInfo processInfo] activeProcessorCount]),
+                                 @"timestamp": @((long long)[[NSDate date] timeIntervalSince1970]),
+                                 @"benchmarks": benchmarks};
+        NSData *data = [NSJSONSerialization dataWithJSONObject:report options:NSJSONWritingPrettyPrinted error:nil];
+        fwrite(data.bytes, 1, data.length, stdout);
+        fputc('\n', stdout);
+        return;
+    }
+
+    printf("%-24s %8s %10s %14s %12s %12s %10s %12s\n",
+           "benchmark", "param", "iters", "ops/s", "p50 ns", "p99 ns", "allocs/op", "bytes/op");
+    for (KSBenchmarkResult *result in results) {
+        printf("%-24s %8lu %10lu %14.0f %12llu %12llu %10.2f %12.1f\n",
+               [result.name UTF8String], (unsigned long)result.parameter, (unsigned long)result.iterations,
+               result.operationsPerSecond, (unsigned long long)result.p50, (unsigned long long)result.p99,
+               result.allocationsPerOperation, result.bytesPerOperation);
+    }
+}
+
+int main(int argc, const char *argv[]) {
+    @autoreleasepool {
+        BOOL json = NO;
+        NSString *filter = nil;
+        for (int i = 1; i < argc; i++) {
+            if (strcmp(argv[i], "--json") == 0) {
+                json = YES;
+            } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+                filter = [NSString stringWithUTF8String:argv[++i]];
+            } else {
+                fprintf(stderr, "usage: %s [--json] [--filter name]\n", argv[0]);
+                return 1;
+            }
+        }
+
+        NSMutableDictionary *cases = [NSMutableDictionary dictionary];
+        cases[@"then-chain"] = [^NSArray *{ return KSBenchmarkChainDepth(); } copy];
+        cases[@"fan-out"] = [^NSArray *{ return KSBenchmarkFanOut(); } copy];
+        cases[@"when"] = [^NSArray *{ return KSBenchmarkJoin(); } copy];
+        cases[@"cancel-chain"] = [^NSArray *{ return KSBenchmarkCancellation(); } copy];
+        cases[@"cross-thread"] = [^NSArray *{ return KSBenchmarkCrossThread(); } copy];
+#if defined(__linux__)
+        cases[@"event-loop"] = [^NSArray *{ return KSBenchmarkEventLoop(); } copy];
+#endif
+
+        NSMutableArray *results = [NSMutableArray array];
+        for (NSString *name in [[cases allKeys] sortedArrayUsingSelector:@selector(compare:)]) {
+            if (filter && [name rangeOfString:filter].location == NSNotFound) {
+                continue;
+            }
+            NSArray *(^benchmark)(void) = cases[name];
+            [results addObjectsFromArray:benchmark()];
+        }
+        KSBenchmarkPrint(results, json);
+    }
+    return 0;
+}
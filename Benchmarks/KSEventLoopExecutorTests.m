@@ -0,0 +1,145 @@
+// Checks KSEventLoopExecutor against real epoll and eventfd descriptors, which
+// the spec suite can't reach on macOS. Exits non-zero if any check fails.
+//
+//   make -C Benchmarks test
+
+#import <Foundation/Foundation.h>
+#import "KSEventLoopExecutor.h"
+#import "KSDeferred.h"
+#import <errno.h>
+#import <pthread.h>
+#import <sys/epoll.h>
+#import <sys/socket.h>
+#import <unistd.h>
+
+static int failures;
+
+#define KSCheck(condition) do { \
+    if (!(condition)) { \
+        printf("  FAILED %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while (0)
+
+static BOOL KSWait(dispatch_semaphore_t semaphore) {
+    return dispatch_semaphore_wait(semaphore, dispatch_time(DISPATCH_TIME_NOW, 2 * NSEC_PER_SEC)) == 0;
+}
+
+// Runs executor on a thread of its own; the semaphore is signalled when -run returns.
+static dispatch_semaphore_t KSRunOnThread(KSEventLoopExecutor *executor) {
+    dispatch_semaphore_t finished = dispatch_semaphore_create(0);
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [executor run];
+        dispatch_semaphore_signal(finished);
+    });
+    return finished;
+}
+
+static void KSTestExecuteWakesTheLoop(void) {
+    printf("execute: wakes a loop blocked in epoll_wait\n");
+    KSEventLoopExecutor *executor = [[KSEventLoopExecutor alloc] init];
+    dispatch_semaphore_t finished = KSRunOnThread(executor);
+    // let the loop block before work arrives
+    usleep(50 * 1000);
+
+    dispatch_semaphore_t ran = dispatch_semaphore_create(0);
+    __block pthread_t loopThread;
+    [executor execute:^{
+        loopThread = pthread_self();
+        dispatch_semaphore_signal(ran);
+    }];
+    KSCheck(KSWait(ran));
+    KSCheck(!pthread_equal(loopThread, pthread_self()));
+
+    [executor stop];
+    KSCheck(KSWait(finished));
+}
+
+static void KSTestReadinessRearmsForTheRemainingWaiters(void) {
+    printf("readiness resolves the ready waiter and re-arms for the rest\n");
+    KSEventLoopExecutor *executor = [[KSEventLoopExecutor alloc] init];
+    int sockets[2];
+    KSCheck(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+
+    KSPromise *readable = [executor promiseForFileDescriptor:sockets[0] events:EPOLLIN];
+    KSPromise *writable = [executor promiseForFileDescriptor:sockets[0] events:EPOLLOUT];
+    [executor processEventsWithTimeout:0];
+    [executor processEventsWithTimeout:1];
+    KSCheck(writable.fulfilled);
+    KSCheck([writable.value unsignedIntValue] & EPOLLOUT);
+    KSCheck(!readable.fulfilled);
+
+    // the one-shot registration fired, so this only arrives if it was re-armed
+    KSCheck(write(sockets[1], "x", 1) == 1);
+    [executor processEventsWithTimeout:1];
+    KSCheck(readable.fulfilled);
+    KSCheck([readable.value unsignedIntValue] & EPOLLIN);
+
+    // with nobody waiting the descriptor was removed, so it can be added again
+    KSPromise *again = [executor promiseForFileDescriptor:sockets[0] events:EPOLLIN];
+    [executor processEventsWithTimeout:0];
+    [executor processEventsWithTimeout:1];
+    KSCheck(again.fulfilled);
+
+    close(sockets[0]);
+    close(sockets[1]);
+}
+
+static void KSTestCancellingRemovesTheWatch(void) {
+    printf("cancelling a promise removes its watch\n");
+    KSEventLoopExecutor *executor = [[KSEventLoopExecutor alloc] init];
+    int pipeDescriptors[2];
+    KSCheck(pipe(pipeDescriptors) == 0);
+
+    KSPromise *cancelled = [executor promiseForFileDescriptor:pipeDescriptors[0] events:EPOLLIN];
+    [executor processEventsWithTimeout:0];
+    [cancelled cancel];
+    [executor processEventsWithTimeout:0];
+
+    // the descriptor has left the epoll set, so it stays quiet once readable
+    KSCheck(write(pipeDescriptors[1], "x", 1) == 1);
+    struct epoll_event event;
+    KSCheck(epoll_wait(executor.fileDescriptor, &event, 1, 50) == 0);
+    KSCheck(epoll_ctl(executor.fileDescriptor, EPOLL_CTL_DEL, pipeDescriptors[0], NULL) != 0 && errno == ENOENT);
+
+    KSPromise *next = [executor promiseForFileDescriptor:pipeDescriptors[0] events:EPOLLIN];
+    [executor processEventsWithTimeout:0];
+    [executor processEventsWithTimeout:1];
+    KSCheck(next.fulfilled);
+    KSCheck(!next.rejected);
+
+    close(pipeDescriptors[0]);
+    close(pipeDescriptors[1]);
+}
+
+static void KSTestStopEndsTheLoop(void) {
+    printf("stop ends run after the blocks queued before it\n");
+    KSEventLoopExecutor *executor = [[KSEventLoopExecutor alloc] init];
+    dispatch_semaphore_t finished = KSRunOnThread(executor);
+
+    __block NSUInteger ran = 0;
+    for (NSUInteger i = 0; i < 100; i++) {
+        [executor execute:^{
+            ran++;
+        }];
+    }
+    [executor stop];
+    KSCheck(KSWait(finished));
+    KSCheck(ran == 100);
+
+    // a stopped executor can be run again
+    finished = KSRunOnThread(executor);
+    [executor stop];
+    KSCheck(KSWait(finished));
+}
+
+int main(int argc, const char *argv[]) {
+    @autoreleasepool {
+        KSTestExecuteWakesTheLoop();
+        KSTestReadinessRearmsForTheRemainingWaiters();
+        KSTestCancellingRemovesTheWatch();
+        KSTestStopEndsTheLoop();
+        printf("%d failed\n", failures);
+        return failures > 0;
+    }
+}
@@ -0,0 +1,35 @@
+// Runs the KSPromise stress harness from the spec suite as a contention
+// benchmark and exits non-zero if any invariant was broken.
+//
+//   make -C Benchmarks && Benchmarks/build/ks-stress-benchmark [seed]
+
+#import <Foundation/Foundation.h>
+#import "KSPromiseStressHarness.h"
+
+int main(int argc, const char *argv[]) {
+    @autoreleasepool {
+        KSPromiseStressHarness *harness = [[KSPromiseStressHarness alloc] init];
+        if (argc > 1) {
+            harness.seed = (unsigned int)strtoul(argv[1], NULL, 10);
+        }
+
+        NSUInteger promiseCounts[] = {2, 64, 4096};
+        int status = 0;
+        for (size_t i = 0; i < sizeof(promiseCounts) / sizeof(promiseCounts[0]); i++) {
+            harness.promisesPerRound = promiseCounts[i];
+            KSPromiseStressResult *result = [harness run];
+            printf("threads=%-3lu promises=%-5lu %12.0f ops/s  %lu duplicate settles  %lu violations\n",
+                   (unsigned long)harness.threadCount, (unsigned long)promiseCounts[i],
+                   result.operationsPerSecond, (unsigned long)result.duplicateSettleCount,
+                   (unsigned long)result.violations.count);
+            for (NSString *violation in [result.violations subarrayWithRange:NSMakeRange(0, MIN(result.violations.count, (NSUInteger)10))]) {
+                printf("  %s\n", [violation UTF8String]);
+            }
+            if (result.violations.count > 0) {
+                status = 1;
+            }
+        }
+        printf("seed=%u\n", harness.seed);
+        return status;
+    }
+}
@@ -0,0 +1,79 @@
+// Compares KSWorkStealingExecutor with dispatch_async to a global queue on
+// fork-join promise trees.
+//
+//   make -C Benchmarks && Benchmarks/build/ks-executor-benchmark
+
+#import <Foundation/Foundation.h>
+#import "KSPromise.h"
+#import "KSWorkStealingExecutor.h"
+
+
+@interface KSGlobalQueueExecutor : NSObject <KSExecutor>
+@end
+
+@implementation KSGlobalQueueExecutor
+
+- (void)execute:(void (^)(void))block {
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), block);
+}
+
+@end
+
+
+static double KSLeafWork(NSUInteger iterations) {
+    double sum = 0;
+    for (NSUInteger i = 1; i <= iterations; i++) {
+        sum += 1.0 / (double)(i * i);
+    }
+    return sum;
+}
+
+static KSPromise *KSForkJoin(id<KSExecutor> executor, NSUInteger depth, NSUInteger leafIterations) {
+    return [KSPromise async:^id{
+        if (depth == 0) {
+            return @(KSLeafWork(leafIterations));
+        }
+        KSPromise *left = KSForkJoin(executor, depth - 1, leafIterations);
+        KSPromise *right = KSForkJoin(executor, depth - 1, leafIterations);
+        return [[KSPromise when:@[left, right]] then:^id(NSArray *values) {
+            return @([values[0] doubleValue] + [values[1] doubleValue]);
+        }];
+    } onExecutor:executor];
+}
+
+static NSTimeInterval KSMeasure(NSString *name, id<KSExecutor> executor, NSUInteger depth, NSUInteger leafIterations, NSUInteger runs) {
+    NSTimeInterval best = DBL_MAX;
+    for (NSUInteger run = 0; run < runs; run++) {
+        @autoreleasepool {
+            NSDate *start = [NSDate date];
+            id value = [KSForkJoin(executor, depth, leafIterations) waitForValue];
+            NSTimeInterval elapsed = -[start timeIntervalSinceNow];
+            best = MIN(best, elapsed);
+            if (![value isKindOfClass:[NSNumber class]]) {
+                NSLog(@"%@: unexpected result %@", name, value);
+            }
+        }
+    }
+    printf("%-24s depth=%-3lu leaf=%-6lu best=%8.2f ms  %10.0f nodes/s\n",
+           [name UTF8String], (unsigned long)depth, (unsigned long)leafIterations,
+           best * 1000.0, (double)((2UL << depth) - 1) / best);
+    return best;
+}
+
+int main(int argc, const char *argv[]) {
+    @autoreleasepool {
+        id<KSExecutor> workStealing = [KSWorkStealingExecutor sharedExecutor];
+        id<KSExecutor> globalQueue = [[KSGlobalQueueExecutor alloc] init];
+
+        NSUInteger depths[] = {10, 14, 16};
+        NSUInteger leaves[] = {0, 1000, 20000};
+        for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+            for (size_t l = 0; l < sizeof(leaves) / sizeof(leaves[0]); l++) {
+                NSTimeInterval stealing = KSMeasure(@"KSWorkStealingExecutor", workStealing, depths[d], leaves[l], 5);
+                NSTimeInterval dispatch = KSMeasure(@"dispatch_async(global)", globalQueue, depths[d], leaves[l], 5);
+                printf("%-24s speedup=%.2fx\n\n", "", dispatch / stealing);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+#import <Foundation/Foundation.h>
+#import "KSPromise.h"
+#import "KSNullabilityCompat.h"
+#import "KSGenericsCompat.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+FOUNDATION_EXPORT NSString *const KSAsyncChannelErrorDomain;
+
+typedef NS_ENUM(NSInteger, KSAsyncChannelErrorCode) {
+    KSAsyncChannelErrorClosed = 1,
+};
+
+// A queue of at most capacity items between any number of producers and
+// consumers. A send to a full channel stays pending until a receive makes
+// room, and a receive from an empty one stays pending until an item arrives,
+// so producers can't outrun consumers by more than capacity items. Waiting
+// sends and receives are served first in, first out; cancelling one
+// withdraws it.
+@interface KSAsyncChannel KS_GENERIC(ObjectType) : NSObject
+
+// With a capacity of 0 each send waits for a receive to take its item.
+- (instancetype)initWithCapacity:(NSUInteger)capacity;
+
+@property (nonatomic, readonly) NSUInteger capacity;
+// Items buffered, not counting those of waiting sends.
+@property (nonatomic, readonly) NSUInteger count;
+@property (nonatomic, readonly, getter=isClosed) BOOL closed;
+
+// Fulfills with nil once the channel has taken item. Rejects with
+// KSAsyncChannelErrorClosed if the channel closes first.
+- (KSPromise *)send:(KS_GENERIC_TYPE(ObjectType))item;
+// Takes item only if there is room now.
+- (BOOL)trySend:(KS_GENERIC_TYPE(ObjectType))item;
+
+// Fulfills with the oldest item. Rejects with KSAsyncChannelErrorClosed once
+// the channel is closed and every item has been received.
+- (KSPromise KS_GENERIC(ObjectType) *)receive;
+// Fulfills with between 1 and maximumCount of the oldest items, as many as
+// are there when the first one is.
+- (KSPromise KS_GENERIC(NSArray *) *)receiveUpTo:(NSUInteger)maximumCount;
+
+// Rejects the waiting sends. The buffered items can still be received.
+- (void)close;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,213 @@
+#import "KSAsyncChannel.h"
+#import "KSDeferred.h"
+#import <pthread.h>
+
+NSString *const KSAsyncChannelErrorDomain = @"KSAsyncChannelErrorDomain";
+
+static NSError *KSAsyncChannelClosedError(void) {
+    return [NSError errorWithDomain:KSAsyncChannelErrorDomain
+                               code:KSAsyncChannelErrorClosed
+                           userInfo:@{NSLocalizedDescriptionKey: @"The channel is closed."}];
+}
+
+
+@interface KSAsyncChannelWaiter : NSObject
+@property (strong, nonatomic) KSDeferred *deferred;
+// the item of a send
+@property (strong, nonatomic) id item;
+// the limit of a receiveUpTo:, or 0 for a receive
+@property (assign, nonatomic) NSUInteger maximumCount;
+@end
+
+@implementation KSAsyncChannelWaiter
+@end
+
+
+@interface KSAsyncChannel () {
+    pthread_mutex_t _lock;
+    NSMutableArray *_buffer;
+    // KSAsyncChannelWaiters, oldest first. Senders only wait while the buffer
+    // is full and receivers only while it is empty.
+    NSMutableArray *_senders;
+    NSMutableArray *_receivers;
+    BOOL _closed;
+}
+@property (assign, nonatomic) NSUInteger capacity;
+@end
+
+@implementation KSAsyncChannel
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity {
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_lock, NULL);
+        _buffer = [NSMutableArray arrayWithCapacity:capacity];
+        _senders = [NSMutableArray array];
+        _receivers = [NSMutableArray array];
+        self.capacity = capacity;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    pthread_mutex_destroy(&_lock);
+}
+
+- (NSUInteger)count {
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = _buffer.count;
+    pthread_mutex_unlock(&_lock);
+    return count;
+}
+
+- (BOOL)isClosed {
+    pthread_mutex_lock(&_lock);
+    BOOL closed = _closed;
+    pthread_mutex_unlock(&_lock);
+    return closed;
+}
+
+- (KSPromise *)send:(id)item {
+    return [self send:item waiting:YES];
+}
+
+- (BOOL)trySend:(id)item {
+    return [self send:item waiting:NO] != nil;
+}
+
+- (KSPromise *)receive {
+    return [self receiveUpTo:1 batch:NO];
+}
+
+- (KSPromise *)receiveUpTo:(NSUInteger)maximumCount {
+    NSAssert(maximumCount > 0, @"A receive needs room for at least one item.");
+    return [self receiveUpTo:MAX(maximumCount, 1) batch:YES];
+}
+
+- (void)close {
+    pthread_mutex_lock(&_lock);
+    NSArray *waiters = nil;
+    if (!_closed) {
+        _closed = YES;
+        waiters = [_senders arrayByAddingObjectsFromArray:_receivers];
+        [_senders removeAllObjects];
+        [_receivers removeAllObjects];
+    }
+    pthread_mutex_unlock(&_lock);
+
+    NSError *error = KSAsyncChannelClosedError();
+    for (KSAsyncChannelWaiter *waiter in waiters) {
+        [waiter.deferred rejectWithError:error];
+    }
+}
+
+#pragma mark - Private methods
+
+// Returns nil if the channel has no room for item and waiting is NO.
+- (KSPromise *)send:(id)item waiting:(BOOL)waiting {
+    while (YES) {
+        pthread_mutex_lock(&_lock);
+        if (_closed) {
+            pthread_mutex_unlock(&_lock);
+            return waiting ? [KSPromise reject:KSAsyncChannelClosedError()] : nil;
+        }
+        KSAsyncChannelWaiter *receiver = _receivers.firstObject;
+        KSAsyncChannelWaiter *sender = nil;
+        BOOL buffered = NO;
+        if (receiver) {
+            [_receivers removeObjectAtIndex:0];
+        } else if (_buffer.count < self.capacity) {
+            [_buffer addObject:item];
+            buffered = YES;
+        } else if (waiting) {
+            sender = [self enqueueWaiterInQueue:_senders];
+            sender.item = item;
+        }
+        pthread_mutex_unlock(&_lock);
+
+        if (sender) {
+            return sender.deferred.promise;
+        }
+        if (!receiver && !buffered) {
+            return nil;
+        }
+        // a receiver cancelled after leaving the queue doesn't fulfill, so
+        // the item goes round again
+        if (buffered || [self deliverItem:item toReceiver:receiver]) {
+            return [KSPromise resolve:nil];
+        }
+    }
+}
+
+- (KSPromise *)receiveUpTo:(NSUInteger)maximumCount batch:(BOOL)batch {
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = MIN(maximumCount, _buffer.count);
+    NSMutableArray *items = [[_buffer subarrayWithRange:NSMakeRange(0, count)] mutableCopy];
+    [_buffer removeObjectsInRange:NSMakeRange(0, count)];
+
+    // Waiting sends come after the buffer: first any taken directly, when the
+    // channel has no capacity, then those moved into the room just made.
+    NSMutableArray *sent = [NSMutableArray array];
+    while (items.count < maximumCount && _buffer.count == 0 && _senders.count > 0) {
+        KSAsyncChannelWaiter *sender = _senders.firstObject;
+        [_senders removeObjectAtIndex:0];
+        [items addObject:sender.item];
+        [sent addObject:sender];
+    }
+    while (_buffer.count < self.capacity && _senders.count > 0) {
+        KSAsyncChannelWaiter *sender = _senders.firstObject;
+        [_senders removeObjectAtIndex:0];
+        [_buffer addObject:sender.item];
+        [sent addObject:sender];
+    }
+
+    BOOL closed = _closed;
+    KSAsyncChannelWaiter *receiver = nil;
+    if (items.count == 0 && !closed) {
+        receiver = [self enqueueWaiterInQueue:_receivers];
+        receiver.maximumCount = batch ? maximumCount : 0;
+    }
+    pthread_mutex_unlock(&_lock);
+
+    for (KSAsyncChannelWaiter *sender in sent) {
+        [sender.deferred resolveWithValue:nil];
+    }
+    if (receiver) {
+        return receiver.deferred.promise;
+    }
+    if (items.count == 0) {
+        return [KSPromise reject:KSAsyncChannelClosedError()];
+    }
+    return [KSPromise resolve:batch ? items : items.firstObject];
+}
+
+// Call with the lock held.
+- (KSAsyncChannelWaiter *)enqueueWaiterInQueue:(NSMutableArray *)queue {
+    KSAsyncChannelWaiter *waiter = [[KSAsyncChannelWaiter alloc] init];
+    waiter.deferred = [KSDeferred defer];
+    __weak KSAsyncChannel *weakSelf = self;
+    __weak KSAsyncChannelWaiter *weakWaiter = waiter;
+    [waiter.deferred whenCancelled:^{
+        [weakSelf removeWaiter:weakWaiter];
+    }];
+    [queue addObject:waiter];
+    return waiter;
+}
+
+- (void)removeWaiter:(KSAsyncChannelWaiter *)waiter {
+    if (!waiter) {
+        return;
+    }
+    pthread_mutex_lock(&_lock);
+    [_senders removeObjectIdenticalTo:waiter];
+    [_receivers removeObjectIdenticalTo:waiter];
+    pthread_mutex_unlock(&_lock);
+}
+
+// Returns NO if the receiver was cancelled and didn't take the item.
+- (BOOL)deliverItem:(id)item toReceiver:(KSAsyncChannelWaiter *)receiver {
+    [receiver.deferred resolveWithValue:receiver.maximumCount ? @[item] : item];
+    return receiver.deferred.promise.fulfilled;
+}
+
+@end
@@ -0,0 +1,50 @@
+#import <Foundation/Foundation.h>
+#import "KSPromise.h"
+#import "KSNullabilityCompat.h"
+#import "KSGenericsCompat.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Lends out objects that are expensive to create, such as parsers, database
+// handles or connections. At most maximumCount objects are alive at once;
+// checkouts made while they are all lent out wait, first in, first out, and
+// each object checked in goes straight to the first waiter.
+//
+// Set the properties before the first checkout.
+@interface KSAsyncPool KS_GENERIC(ObjectType) : NSObject
+
+// factory creates an object, or rejects, when a checkout finds no idle object
+// and fewer than maximumCount are alive.
+- (instancetype)initWithMaximumCount:(NSUInteger)maximumCount factory:(KSPromise KS_GENERIC(ObjectType) *(^)(void))factory;
+
+// Called on an object as it is checked in and again before an idle object is
+// lent out; objects it returns NO for are discarded.
+@property (copy, nonatomic, nullable) BOOL (^healthCheck)(KS_GENERIC_TYPE(ObjectType) object);
+// Called on every object the pool discards.
+@property (copy, nonatomic, nullable) void (^destroyBlock)(KS_GENERIC_TYPE(ObjectType) object);
+// Objects idle for longer are discarded. 0, the default, keeps them.
+@property (nonatomic) NSTimeInterval idleTimeout;
+
+@property (nonatomic, readonly) NSUInteger maximumCount;
+@property (nonatomic, readonly) NSUInteger liveCount;
+@property (nonatomic, readonly) NSUInteger idleCount;
+@property (nonatomic, readonly) NSUInteger waiterCount;
+
+// Fulfills with an object, which the caller hands back with checkin: or
+// discard:. Cancelling it before then leaves the queue.
+- (KSPromise KS_GENERIC(ObjectType) *)checkout;
+- (void)checkin:(KS_GENERIC_TYPE(ObjectType))object;
+// For an object that is broken; its place goes to a new one.
+- (void)discard:(KS_GENERIC_TYPE(ObjectType))object;
+
+// Checks out an object for block and checks it in once the promise block
+// returns settles or is cancelled, or once the returned promise is cancelled.
+- (KSPromise *)withObject:(KSPromise * __nullable (^)(KS_GENERIC_TYPE(ObjectType) object))block;
+
+// Discards the objects idle for longer than idleTimeout. The pool also does
+// this on its own every half idleTimeout.
+- (void)evictIdleObjects;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,376 @@
+#import "KSAsyncPool.h"
+#import "KSDeferred.h"
+#import "KSClock.h"
+#import "KSPromiseEnd.h"
+#import <pthread.h>
+
+
+@interface KSAsyncPoolIdleObject : NSObject
+@property (strong, nonatomic) id object;
+// KSClockNow() when it was checked in
+@property (assign, nonatomic) uint64_t since;
+@end
+
+@implementation KSAsyncPoolIdleObject
+@end
+
+
+// One withObject: call. Whichever of the work settling and the caller
+// cancelling comes first checks the object back in.
+@interface KSAsyncPoolLease : NSObject<KSCancellable> {
+    pthread_mutex_t _lock;
+    // block is being called; the object is checked in once it returns
+    BOOL _running;
+    BOOL _finished;
+}
+@property (strong, nonatomic) KSAsyncPool *pool;
+@property (strong, nonatomic) KSDeferred *deferred;
+@property (strong, nonatomic) KSPromise *checkout;
+@property (strong, nonatomic) KSPromise *work;
+@property (strong, nonatomic) id object;
+@end
+
+@implementation KSAsyncPoolLease
+
+- (id)init {
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_lock, NULL);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    pthread_mutex_destroy(&_lock);
+}
+
+- (void)checkedOut:(id)object block:(KSPromise *(^)(id object))block {
+    pthread_mutex_lock(&_lock);
+    BOOL finished = _finished;
+    if (!finished) {
+        self.object = object;
+        _running = YES;
+    }
+    pthread_mutex_unlock(&_lock);
+    if (finished) {
+        [self.pool checkin:object];
+        return;
+    }
+
+    KSPromise *work = block(object);
+    pthread_mutex_lock(&_lock);
+    _running = NO;
+    self.work = work;
+    finished = _finished;
+    pthread_mutex_unlock(&_lock);
+    if (finished) {
+        [work cancel];
+        [self.pool checkin:object];
+        return;
+    }
+
+    if (!work) {
+        if ([self finishCancellingWork:NO]) {
+            [self.deferred resolveWithValue:nil];
+        }
+        return;
+    }
+    // work cancelled from elsewhere, say by the client it wraps, still gives
+    // the object back and cancels the lease's promise
+    KSPromiseOnEnd(work, ^(KSPromise *ended) {
+        if ([self finishCancellingWork:NO]) {
+            if (ended.fulfilled) {
+                [self.deferred resolveWithValue:ended.value];
+            } else if (ended.rejected) {
+                [self.deferred rejectWithError:ended.error];
+            } else {
+                [self.deferred.promise cancel];
+            }
+        }
+    });
+}
+
+- (void)checkoutFailed:(NSError *)error {
+    if ([self finishCancellingWork:NO]) {
+        [self.deferred rejectWithError:error];
+    }
+}
+
+- (void)cancel {
+    [self finishCancellingWork:YES];
+}
+
+// Returns NO if the lease had already finished.
+- (BOOL)finishCancellingWork:(BOOL)cancelWork {
+    pthread_mutex_lock(&_lock);
+    BOOL finished = _finished;
+    _finished = YES;
+    id object = _running ? nil : self.object;
+    KSPromise *work = self.work;
+    self.object = nil;
+    pthread_mutex_unlock(&_lock);
+    if (finished) {
+        return NO;
+    }
+
+    if (cancelWork) {
+        [work cancel];
+        [self.checkout cancel];
+    }
+    if (object) {
+        [self.pool checkin:object];
+    }
+    return YES;
+}
+
+@end
+
+
+@interface KSAsyncPool () {
+    pthread_mutex_t _lock;
+    NSUInteger _liveCount;
+    // KSAsyncPoolIdleObjects, least recently checked in first
+    NSMutableArray *_idle;
+    // KSDeferreds, oldest first
+    NSMutableArray *_waiters;
+}
+@property (copy, nonatomic) KSPromise *(^factory)(void);
+@property (assign, nonatomic) NSUInteger maximumCount;
+@property (strong, nonatomic) dispatch_source_t evictionTimer;
+@end
+
+@implementation KSAsyncPool
+
+- (instancetype)initWithMaximumCount:(NSUInteger)maximumCount factory:(KSPromise *(^)(void))factory {
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_lock, NULL);
+        _idle = [NSMutableArray array];
+        _waiters = [NSMutableArray array];
+        self.maximumCount = maximumCount;
+        self.factory = factory;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    if (_evictionTimer) {
+        dispatch_source_cancel(_evictionTimer);
+    }
+    pthread_mutex_destroy(&_lock);
+}
+
+- (void)setIdleTimeout:(NSTimeInterval)idleTimeout {
+    _idleTimeout = idleTimeout;
+    if (self.evictionTimer) {
+        dispatch_source_cancel(self.evictionTimer);
+        self.evictionTimer = nil;
+    }
+    if (idleTimeout <= 0) {
+        return;
+    }
+
+    uint64_t interval = (uint64_t)(idleTimeout / 2 * NSEC_PER_SEC);
+    self.evictionTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0,
+                                                dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+    dispatch_source_set_timer(self.evictionTimer, dispatch_time(DISPATCH_TIME_NOW, interval), interval, interval / 10);
+    __weak KSAsyncPool *weakSelf = self;
+    dispatch_source_set_event_handler(self.evictionTimer, ^{
+        [weakSelf evictIdleObjects];
+    });
+    dispatch_resume(self.evictionTimer);
+}
+
+- (NSUInteger)liveCount {
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = _liveCount;
+    pthread_mutex_unlock(&_lock);
+    return count;
+}
+
+- (NSUInteger)idleCount {
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = _idle.count;
+    pthread_mutex_unlock(&_lock);
+    return count;
+}
+
+- (NSUInteger)waiterCount {
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = _waiters.count;
+    pthread_mutex_unlock(&_lock);
+    return count;
+}
+
+- (KSPromise *)checkout {
+    [self evictIdleObjects];
+
+    while (YES) {
+        pthread_mutex_lock(&_lock);
+        // the most recently used object is the likeliest to still be warm
+        id object = [_idle.lastObject object];
+        [_idle removeLastObject];
+        BOOL create = !object && _liveCount < self.maximumCount;
+        if (create) {
+            _liveCount++;
+        }
+        KSDeferred *waiter = nil;
+        if (!object && !create) {
+            waiter = [self enqueueWaiter];
+        }
+        pthread_mutex_unlock(&_lock);
+
+        if (waiter) {
+            return waiter.promise;
+        }
+        if (create) {
+            waiter = [KSDeferred defer];
+            [self createObjectForWaiter:waiter];
+            return waiter.promise;
+        }
+        if (!self.healthCheck || self.healthCheck(object)) {
+            return [KSPromise resolve:object];
+        }
+        [self discard:object];
+    }
+}
+
+- (void)checkin:(id)object {
+    // checked here as well as on checkout, since a waiter gets the object
+    // without it ever going idle
+    if (self.healthCheck && !self.healthCheck(object)) {
+        [self discard:object];
+        return;
+    }
+
+    while (YES) {
+        pthread_mutex_lock(&_lock);
+        KSDeferred *waiter = _waiters.firstObject;
+        if (waiter) {
+            [_waiters removeObjectAtIndex:0];
+        } else {
+            KSAsyncPoolIdleObject *idle = [[KSAsyncPoolIdleObject alloc] init];
+            idle.object = object;
+            idle.since = KSClockNow();
+            [_idle addObject:idle];
+        }
+        pthread_mutex_unlock(&_lock);
+
+        if (!waiter) {
+            return;
+        }
+        // a waiter cancelled after leaving the queue doesn't fulfill
+        [waiter resolveWithValue:object];
+        if (waiter.promise.fulfilled) {
+            return;
+        }
+    }
+}
+
+- (void)discard:(id)object {
+    if (self.destroyBlock) {
+        self.destroyBlock(object);
+    }
+
+    [self releasePlace];
+}
+
+- (KSPromise *)withObject:(KSPromise *(^)(id object))block {
+    KSAsyncPoolLease *lease = [[KSAsyncPoolLease alloc] init];
+    lease.pool = self;
+    lease.deferred = [KSDeferred defer];
+    __weak KSAsyncPoolLease *weakLease = lease;
+    [lease.deferred whenCancelled:^{
+        [weakLease cancel];
+    }];
+
+    lease.checkout = [self checkout];
+    [lease.checkout then:^id(id object) {
+        [lease checkedOut:object block:block];
+        return nil;
+    } error:^id(NSError *error) {
+        [lease checkoutFailed:error];
+        return nil;
+    }];
+    return lease.deferred.promise;
+}
+
+- (void)evictIdleObjects {
+    NSTimeInterval idleTimeout = self.idleTimeout;
+    if (idleTimeout <= 0) {
+        return;
+    }
+    uint64_t now = KSClockNow();
+    uint64_t timeout = (uint64_t)(idleTimeout * NSEC_PER_SEC);
+    uint64_t cutoff = now > timeout ? now - timeout : 0;
+
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = 0;
+    while (count < _idle.count && ((KSAsyncPoolIdleObject *)_idle[count]).since <= cutoff) {
+        count++;
+    }
+    NSArray *evicted = [_idle subarrayWithRange:NSMakeRange(0, count)];
+    [_idle removeObjectsInRange:NSMakeRange(0, count)];
+    pthread_mutex_unlock(&_lock);
+
+    for (KSAsyncPoolIdleObject *idle in evicted) {
+        [self discard:idle.object];
+    }
+}
+
+#pragma mark - Private methods
+
+// Call with the lock held.
+- (KSDeferred *)enqueueWaiter {
+    KSDeferred *waiter = [KSDeferred defer];
+    __weak KSAsyncPool *weakSelf = self;
+    __weak KSDeferred *weakWaiter = waiter;
+    [waiter whenCancelled:^{
+        [weakSelf removeWaiter:weakWaiter];
+    }];
+    [_waiters addObject:waiter];
+    return waiter;
+}
+
+- (void)removeWaiter:(KSDeferred *)waiter {
+    if (!waiter) {
+        return;
+    }
+    pthread_mutex_lock(&_lock);
+    [_waiters removeObjectIdenticalTo:waiter];
+    pthread_mutex_unlock(&_lock);
+}
+
+// An object has gone, so the first waiter gets a new one.
+- (void)releasePlace {
+    pthread_mutex_lock(&_lock);
+    _liveCount--;
+    KSDeferred *waiter = _liveCount < self.maximumCount ? _waiters.firstObject : nil;
+    if (waiter) {
+        [_waiters removeObjectAtIndex:0];
+        _liveCount++;
+    }
+    pthread_mutex_unlock(&_lock);
+
+    if (waiter) {
+        [self createObjectForWaiter:waiter];
+    }
+}
+
+// The place for the object has been counted in liveCount. An object made for
+// a waiter cancelled in the meantime goes to the next one.
+- (void)createObjectForWaiter:(KSDeferred *)waiter {
+    [self.factory() then:^id(id object) {
+        [waiter resolveWithValue:object];
+        if (!waiter.promise.fulfilled) {
+            [self checkin:object];
+        }
+        return nil;
+    } error:^id(NSError *error) {
+        [waiter rejectWithError:error];
+        [self releasePlace];
+        return nil;
+    }];
+}
+
+@end
@@ -0,0 +1,32 @@
+#import <Foundation/Foundation.h>
+#import "KSPromise.h"
+#import "KSNullabilityCompat.h"
+#import "KSGenericsCompat.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Any number of readers or one writer, with promises for waiters. Waiters are
+// served in the order they asked: a reader queued behind a writer waits for
+// that writer even while others read, so writers aren't starved. Releasing
+// hands the lock straight to the waiters at the front of the queue.
+@interface KSAsyncReadWriteLock : NSObject
+
+@property (nonatomic, readonly) NSUInteger readerCount;
+@property (nonatomic, readonly, getter=isWriting) BOOL writing;
+@property (nonatomic, readonly) NSUInteger waiterCount;
+
+// Fulfill with nil once the lock is held. Cancelling one before then leaves
+// the queue without taking the lock.
+- (KSPromise *)acquireRead;
+- (KSPromise *)acquireWrite;
+- (void)releaseRead;
+- (void)releaseWrite;
+
+// Call block with the lock held and release it when the promise block returns
+// fulfills, rejects or is cancelled, or straight away if it returns nil.
+- (KSPromise *)withReadLock:(KSPromise * __nullable (^)(void))block;
+- (KSPromise *)withWriteLock:(KSPromise * __nullable (^)(void))block;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,190 @@
+#import "KSAsyncReadWriteLock.h"
+#import "KSDeferred.h"
+#import "KSPromiseEnd.h"
+#import <pthread.h>
+
+
+@interface KSAsyncReadWriteLockWaiter : NSObject
+@property (strong, nonatomic) KSDeferred *deferred;
+@property (assign, nonatomic) BOOL writer;
+@end
+
+@implementation KSAsyncReadWriteLockWaiter
+@end
+
+
+@interface KSAsyncReadWriteLock () {
+    pthread_mutex_t _lock;
+    NSUInteger _readers;
+    BOOL _writing;
+    // KSAsyncReadWriteLockWaiters, oldest first
+    NSMutableArray *_waiters;
+}
+@end
+
+@implementation KSAsyncReadWriteLock
+
+- (id)init {
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_lock, NULL);
+        _waiters = [NSMutableArray array];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    pthread_mutex_destroy(&_lock);
+}
+
+- (NSUInteger)readerCount {
+    pthread_mutex_lock(&_lock);
+    NSUInteger readers = _readers;
+    pthread_mutex_unlock(&_lock);
+    return readers;
+}
+
+- (BOOL)isWriting {
+    pthread_mutex_lock(&_lock);
+    BOOL writing = _writing;
+    pthread_mutex_unlock(&_lock);
+    return writing;
+}
+
+- (NSUInteger)waiterCount {
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = _waiters.count;
+    pthread_mutex_unlock(&_lock);
+    return count;
+}
+
+- (KSPromise *)acquireRead {
+    return [self acquireWriter:NO];
+}
+
+- (KSPromise *)acquireWrite {
+    return [self acquireWriter:YES];
+}
+
+- (void)releaseRead {
+    pthread_mutex_lock(&_lock);
+    NSAssert(_readers > 0, @"The lock is not held for reading.");
+    _readers--;
+    NSArray *granted = [self grantWaiters];
+    pthread_mutex_unlock(&_lock);
+
+    [self fulfillWaiters:granted];
+}
+
+- (void)releaseWrite {
+    pthread_mutex_lock(&_lock);
+    NSAssert(_writing, @"The lock is not held for writing.");
+    _writing = NO;
+    NSArray *granted = [self grantWaiters];
+    pthread_mutex_unlock(&_lock);
+
+    [self fulfillWaiters:granted];
+}
+
+- (KSPromise *)withReadLock:(KSPromise *(^)(void))block {
+    return [[self acquireRead] then:^id(id value) {
+        KSPromise *promise = block();
+        if (!promise) {
+            [self releaseRead];
+            return nil;
+        }
+        KSPromiseOnEnd(promise, ^(KSPromise *ended) {
+            [self releaseRead];
+        });
+        return promise;
+    }];
+}
+
+- (KSPromise *)withWriteLock:(KSPromise *(^)(void))block {
+    return [[self acquireWrite] then:^id(id value) {
+        KSPromise *promise = block();
+        if (!promise) {
+            [self releaseWrite];
+            return nil;
+        }
+        KSPromiseOnEnd(promise, ^(KSPromise *ended) {
+            [self releaseWrite];
+        });
+        return promise;
+    }];
+}
+
+#pragma mark - Private methods
+
+- (KSPromise *)acquireWriter:(BOOL)writer {
+    KSAsyncReadWriteLockWaiter *waiter = [[KSAsyncReadWriteLockWaiter alloc] init];
+    waiter.deferred = [KSDeferred defer];
+    waiter.writer = writer;
+    __weak KSAsyncReadWriteLock *weakSelf = self;
+    __weak KSAsyncReadWriteLockWaiter *weakWaiter = waiter;
+    [waiter.deferred whenCancelled:^{
+        [weakSelf removeWaiter:weakWaiter];
+    }];
+
+    pthread_mutex_lock(&_lock);
+    [_waiters addObject:waiter];
+    NSArray *granted = [self grantWaiters];
+    pthread_mutex_unlock(&_lock);
+
+    [self fulfillWaiters:granted];
+    return waiter.deferred.promise;
+}
+
+// Call with the lock held. Takes the waiters at the front of the queue that
+// can hold the lock now, and marks the lock as theirs.
+- (NSArray *)grantWaiters {
+    NSUInteger count = 0;
+    for (KSAsyncReadWriteLockWaiter *waiter in _waiters) {
+        if (_writing || (waiter.writer && _readers > 0)) {
+            break;
+        }
+        count++;
+        if (waiter.writer) {
+            _writing = YES;
+        } else {
+            _readers++;
+        }
+    }
+    if (count == 0) {
+        return nil;
+    }
+    NSRange range = NSMakeRange(0, count);
+    NSArray *granted = [_waiters subarrayWithRange:range];
+    [_waiters removeObjectsInRange:range];
+    return granted;
+}
+
+// A waiter cancelled after leaving the queue doesn't fulfill, so what it was
+// granted is released again.
+- (void)fulfillWaiters:(NSArray *)waiters {
+    for (KSAsyncReadWriteLockWaiter *waiter in waiters) {
+        [waiter.deferred resolveWithValue:nil];
+        if (!waiter.deferred.promise.fulfilled) {
+            if (waiter.writer) {
+                [self releaseWrite];
+            } else {
+                [self releaseRead];
+            }
+        }
+    }
+}
+
+- (void)removeWaiter:(KSAsyncReadWriteLockWaiter *)waiter {
+    if (!waiter) {
+        return;
+    }
+    pthread_mutex_lock(&_lock);
+    [_waiters removeObjectIdenticalTo:waiter];
+    // a writer leaving the front may let the readers behind it in
+    NSArray *granted = [self grantWaiters];
+    pthread_mutex_unlock(&_lock);
+
+    [self fulfillWaiters:granted];
+}
+
+@end
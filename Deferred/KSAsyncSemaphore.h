@@ -0,0 +1,41 @@
+#import <Foundation/Foundation.h>
+#import "KSPromise.h"
+#import "KSNullabilityCompat.h"
+#import "KSGenericsCompat.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// A counting semaphore whose waiters are promises rather than parked
+// threads. Waiters are served in the order they called acquire, and a signal
+// hands its permit straight to the first of them.
+@interface KSAsyncSemaphore : NSObject
+
+- (instancetype)initWithValue:(NSUInteger)value;
+
+// The number of permits free to acquire.
+@property (nonatomic, readonly) NSUInteger value;
+@property (nonatomic, readonly) NSUInteger waiterCount;
+
+// Fulfills with nil once the caller holds a permit. Cancelling it before then
+// leaves the queue without taking one.
+- (KSPromise *)acquire;
+// Takes a free permit if there is one, without waiting.
+- (BOOL)tryAcquire;
+- (void)signal;
+
+// Calls block once a permit is held and signals when the promise it returns
+// fulfills, rejects or is cancelled, or straight away if it returns nil.
+- (KSPromise *)withPermit:(KSPromise * __nullable (^)(void))block;
+
+@end
+
+// A semaphore with a single permit.
+@interface KSAsyncMutex : KSAsyncSemaphore
+
+- (KSPromise *)lock;
+- (BOOL)tryLock;
+- (void)unlock;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,151 @@
+#import "KSAsyncSemaphore.h"
+#import "KSDeferred.h"
+#import "KSPromiseEnd.h"
+#import <pthread.h>
+
+
+@interface KSAsyncSemaphore () {
+    pthread_mutex_t _lock;
+    NSUInteger _value;
+    // KSDeferreds, oldest first
+    NSMutableArray *_waiters;
+}
+@end
+
+@implementation KSAsyncSemaphore
+
+- (instancetype)initWithValue:(NSUInteger)value {
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_lock, NULL);
+        _value = value;
+        _waiters = [NSMutableArray array];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    pthread_mutex_destroy(&_lock);
+}
+
+- (NSUInteger)value {
+    pthread_mutex_lock(&_lock);
+    NSUInteger value = _value;
+    pthread_mutex_unlock(&_lock);
+    return value;
+}
+
+- (NSUInteger)waiterCount {
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = _waiters.count;
+    pthread_mutex_unlock(&_lock);
+    return count;
+}
+
+- (KSPromise *)acquire {
+    if ([self tryAcquire]) {
+        return [KSPromise resolve:nil];
+    }
+
+    KSDeferred *waiter = [KSDeferred defer];
+    __weak KSAsyncSemaphore *weakSelf = self;
+    __weak KSDeferred *weakWaiter = waiter;
+    [waiter whenCancelled:^{
+        [weakSelf removeWaiter:weakWaiter];
+    }];
+
+    pthread_mutex_lock(&_lock);
+    BOOL acquired = _value > 0;
+    if (acquired) {
+        _value--;
+    } else {
+        [_waiters addObject:waiter];
+    }
+    pthread_mutex_unlock(&_lock);
+
+    if (acquired) {
+        [waiter resolveWithValue:nil];
+    }
+    return waiter.promise;
+}
+
+- (BOOL)tryAcquire {
+    pthread_mutex_lock(&_lock);
+    BOOL acquired = _value > 0;
+    if (acquired) {
+        _value--;
+    }
+    pthread_mutex_unlock(&_lock);
+    return acquired;
+}
+
+// A waiter cancelled after leaving the queue doesn't fulfill, so the permit
+// moves on to the next one.
+- (void)signal {
+    while (YES) {
+        pthread_mutex_lock(&_lock);
+        KSDeferred *waiter = _waiters.firstObject;
+        if (waiter) {
+            [_waiters removeObjectAtIndex:0];
+        } else {
+            _value++;
+        }
+        pthread_mutex_unlock(&_lock);
+
+        if (!waiter) {
+            return;
+        }
+        [waiter resolveWithValue:nil];
+        if (waiter.promise.fulfilled) {
+            return;
+        }
+    }
+}
+
+- (KSPromise *)withPermit:(KSPromise *(^)(void))block {
+    return [[self acquire] then:^id(id value) {
+        KSPromise *promise = block();
+        if (!promise) {
+            [self signal];
+            return nil;
+        }
+        KSPromiseOnEnd(promise, ^(KSPromise *ended) {
+            [self signal];
+        });
+        return promise;
+    }];
+}
+
+#pragma mark - Private methods
+
+- (void)removeWaiter:(KSDeferred *)waiter {
+    if (!waiter) {
+        return;
+    }
+    pthread_mutex_lock(&_lock);
+    [_waiters removeObjectIdenticalTo:waiter];
+    pthread_mutex_unlock(&_lock);
+}
+
+@end
+
+
+@implementation KSAsyncMutex
+
+- (id)init {
+    return [self initWithValue:1];
+}
+
+- (KSPromise *)lock {
+    return [self acquire];
+}
+
+- (BOOL)tryLock {
+    return [self tryAcquire];
+}
+
+- (void)unlock {
+    [self signal];
+}
+
+@end
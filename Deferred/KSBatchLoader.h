@@ -0,0 +1,44 @@
+#import <Foundation/Foundation.h>
+#import "KSPromise.h"
+#import "KSNullabilityCompat.h"
+#import "KSGenericsCompat.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+FOUNDATION_EXPORT NSString *const KSBatchLoaderErrorDomain;
+
+typedef NS_ENUM(NSInteger, KSBatchLoaderErrorCode) {
+    // The batch function's array didn't have one entry per key.
+    KSBatchLoaderErrorValueCountMismatch = 1,
+};
+
+// Fulfills with one entry per key, in the order of keys. NSNull stands for
+// nil and an NSError rejects that key alone; rejecting rejects every key.
+typedef KSPromise KS_GENERIC(NSArray *) * _Nonnull (^KSBatchLoadFunction)(NSArray *keys);
+
+// Collects the keys passed to load: until the current tick ends, then asks
+// the batch function for all of them at once and hands each caller its own
+// entry. A key requested twice in a tick is sent once; each caller still gets
+// its own promise, so cancelling one doesn't affect the others.
+@interface KSBatchLoader : NSObject
+
+// Batches are sent from the main queue, so one run loop turn is one batch.
+- (instancetype)initWithBatchFunction:(KSBatchLoadFunction)batchFunction;
+// Batches are sent from a block dispatch_async'ed onto queue when the first
+// key of a batch is requested.
+- (instancetype)initWithQueue:(dispatch_queue_t)queue batchFunction:(KSBatchLoadFunction)batchFunction;
+
+// Batches with more keys are split into calls of at most this many. 0, the
+// default, means no limit.
+@property (nonatomic) NSUInteger maximumBatchSize;
+
+- (KSPromise *)load:(id<NSCopying>)key;
+// Fulfills with the values in the order of keys, or rejects as +when: does.
+- (KSPromise KS_GENERIC(NSArray *) *)loadMany:(NSArray *)keys;
+
+// Sends the keys collected so far without waiting for the tick to end.
+- (void)dispatch;
+
+@end
+
+NS_ASSUME_NONNULL_END
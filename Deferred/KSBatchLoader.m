@@ -0,0 +1,129 @@
+#import "KSBatchLoader.h"
+#import "KSDeferred.h"
+#import <pthread.h>
+
+NSString *const KSBatchLoaderErrorDomain = @"KSBatchLoaderErrorDomain";
+
+
+@interface KSBatchLoader () {
+    pthread_mutex_t _lock;
+    // the keys of the open batch in request order, and their deferreds, which
+    // every caller loading the key follows
+    NSMutableArray *_keys;
+    NSMutableDictionary *_deferreds;
+}
+@property (strong, nonatomic) dispatch_queue_t queue;
+@property (copy, nonatomic) KSBatchLoadFunction batchFunction;
+@end
+
+@implementation KSBatchLoader
+
+- (instancetype)initWithBatchFunction:(KSBatchLoadFunction)batchFunction {
+    return [self initWithQueue:dispatch_get_main_queue() batchFunction:batchFunction];
+}
+
+- (instancetype)initWithQueue:(dispatch_queue_t)queue batchFunction:(KSBatchLoadFunction)batchFunction {
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_lock, NULL);
+        self.queue = queue;
+        self.batchFunction = batchFunction;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    pthread_mutex_destroy(&_lock);
+}
+
+- (KSPromise *)load:(id<NSCopying>)key {
+    pthread_mutex_lock(&_lock);
+    BOOL opened = _keys == nil;
+    if (opened) {
+        _keys = [NSMutableArray array];
+        _deferreds = [NSMutableDictionary dictionary];
+    }
+    KSDeferred *deferred = _deferreds[key];
+    if (!deferred) {
+        deferred = [KSDeferred defer];
+        _deferreds[key] = deferred;
+        [_keys addObject:key];
+    }
+    pthread_mutex_unlock(&_lock);
+
+    if (opened) {
+        dispatch_async(self.queue, ^{
+            [self dispatch];
+        });
+    }
+
+    // each caller gets its own promise, so one cancelling leaves the others be
+    KSDeferred *caller = [KSDeferred defer];
+    [deferred.promise onSettled:^(KSPromise *settled) {
+        if (settled.fulfilled) {
+            [caller resolveWithValue:settled.value];
+        } else {
+            [caller rejectWithError:settled.error];
+        }
+    }];
+    return caller.promise;
+}
+
+- (KSPromise *)loadMany:(NSArray *)keys {
+    NSMutableArray *promises = [NSMutableArray arrayWithCapacity:keys.count];
+    for (id<NSCopying> key in keys) {
+        [promises addObject:[self load:key]];
+    }
+    return [KSPromise when:promises];
+}
+
+- (void)dispatch {
+    pthread_mutex_lock(&_lock);
+    NSArray *keys = _keys;
+    NSDictionary *deferreds = _deferreds;
+    _keys = nil;
+    _deferreds = nil;
+    NSUInteger maximumBatchSize = self.maximumBatchSize;
+    pthread_mutex_unlock(&_lock);
+
+    if (keys.count == 0) {
+        return;
+    }
+    NSUInteger size = maximumBatchSize ?: keys.count;
+    for (NSUInteger start = 0; start < keys.count; start += size) {
+        NSArray *chunk = [keys subarrayWithRange:NSMakeRange(start, MIN(size, keys.count - start))];
+        [self sendKeys:chunk deferreds:[deferreds objectsForKeys:chunk notFoundMarker:[NSNull null]]];
+    }
+}
+
+#pragma mark - Private methods
+
+- (void)sendKeys:(NSArray *)keys deferreds:(NSArray *)deferreds {
+    [self.batchFunction(keys) then:^id(NSArray *values) {
+        if (values.count != keys.count) {
+            NSString *description = [NSString stringWithFormat:@"The batch function returned %lu values for %lu keys.",
+                                     (unsigned long)values.count, (unsigned long)keys.count];
+            NSError *error = [NSError errorWithDomain:KSBatchLoaderErrorDomain
+                                                 code:KSBatchLoaderErrorValueCountMismatch
+                                             userInfo:@{NSLocalizedDescriptionKey: description}];
+            [KSDeferred rejectDeferreds:deferreds withError:error];
+            return nil;
+        }
+        [KSDeferred performBatchedResolution:^{
+            [deferreds enumerateObjectsUsingBlock:^(KSDeferred *deferred, NSUInteger i, BOOL *stop) {
+                id value = values[i];
+                if ([value isKindOfClass:[NSError class]]) {
+                    [deferred rejectWithError:value];
+                } else {
+                    [deferred resolveWithValue:value == [NSNull null] ? nil : value];
+                }
+            }];
+        }];
+        return nil;
+    } error:^id(NSError *error) {
+        [KSDeferred rejectDeferreds:deferreds withError:error];
+        return nil;
+    }];
+}
+
+@end
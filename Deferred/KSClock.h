@@ -0,0 +1,27 @@
+#import <Foundation/Foundation.h>
+
+#if defined(__APPLE__)
+#import <mach/mach_time.h>
+#else
+#import <time.h>
+#endif
+
+// Monotonic time in nanoseconds, cheap enough to call on every promise
+// operation.
+static inline uint64_t KSClockNow(void) {
+#if defined(__APPLE__)
+    static mach_timebase_info_data_t timebase;
+    if (timebase.denom == 0) {
+        mach_timebase_info(&timebase);
+    }
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * NSEC_PER_SEC + (uint64_t)now.tv_nsec;
+#endif
+}
+
+static inline NSTimeInterval KSClockInterval(uint64_t nanoseconds) {
+    return (NSTimeInterval)nanoseconds / NSEC_PER_SEC;
+}
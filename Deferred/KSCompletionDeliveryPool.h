@@ -0,0 +1,62 @@
+#import <Foundation/Foundation.h>
+#import "KSExecutor.h"
+#import "KSNullabilityCompat.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+FOUNDATION_EXPORT NSString *const KSCompletionDeliveryPoolErrorDomain;
+
+typedef NS_ENUM(NSInteger, KSCompletionDeliveryPoolErrorCode) {
+    KSCompletionDeliveryPoolErrorQueueFull = 1,
+};
+
+// What happens to a block submitted while maximumQueueDepth blocks are queued.
+typedef NS_ENUM(NSInteger, KSCompletionDeliveryOverflowPolicy) {
+    // Wait for space. Blocks submitted from a pool thread run inline instead.
+    KSCompletionDeliveryOverflowPolicyBlock,
+    // Refuse the block; -tryExecute: returns NO.
+    KSCompletionDeliveryOverflowPolicyReject,
+    // Run the block on the submitting thread.
+    KSCompletionDeliveryOverflowPolicyRunInline,
+};
+
+@interface KSCompletionDeliveryPoolMetrics : NSObject
+
+@property (nonatomic, readonly) NSUInteger deliveredCount;
+@property (nonatomic, readonly) NSUInteger rejectedCount;
+@property (nonatomic, readonly) NSUInteger inlineCount;
+@property (nonatomic, readonly) NSUInteger blockedCount;
+@property (nonatomic, readonly) NSUInteger queueDepth;
+@property (nonatomic, readonly) NSUInteger maximumQueueDepth;
+// Time blocks spent queued before a pool thread picked them up.
+@property (nonatomic, readonly) NSTimeInterval totalQueueWait;
+@property (nonatomic, readonly) NSTimeInterval maximumQueueWait;
+@property (nonatomic, readonly) NSTimeInterval averageQueueWait;
+
+@end
+
+// Delivers completions on a fixed number of threads with a bounded queue.
+@interface KSCompletionDeliveryPool : NSObject <KSExecutor>
+
+@property (nonatomic, readonly) NSUInteger threadCount;
+@property (nonatomic, readonly) NSUInteger maximumQueueDepth;
+@property (nonatomic, readonly) KSCompletionDeliveryOverflowPolicy overflowPolicy;
+
+// Two threads, 1024 queued blocks, KSCompletionDeliveryOverflowPolicyBlock.
++ (instancetype)sharedPool;
+
+- (instancetype)initWithThreadCount:(NSUInteger)threadCount
+                  maximumQueueDepth:(NSUInteger)maximumQueueDepth
+                     overflowPolicy:(KSCompletionDeliveryOverflowPolicy)overflowPolicy;
+
+// Same as -tryExecute:, ignoring the result.
+- (void)execute:(void (^)(void))block;
+// Returns NO if the block was rejected because the queue is full.
+- (BOOL)tryExecute:(void (^)(void))block;
+
+- (KSCompletionDeliveryPoolMetrics *)metrics;
+- (void)resetMetrics;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,256 @@
+#import "KSCompletionDeliveryPool.h"
+#import "KSClock.h"
+#import <pthread.h>
+
+
+NSString *const KSCompletionDeliveryPoolErrorDomain = @"KSCompletionDeliveryPoolErrorDomain";
+
+typedef struct {
+    void *block;
+    uint64_t enqueuedAt;
+} KSDeliveryEntry;
+
+static __thread void *ks_currentDeliveryQueue;
+
+
+@interface KSCompletionDeliveryPoolMetrics ()
+@property (nonatomic, readwrite) NSUInteger deliveredCount;
+@property (nonatomic, readwrite) NSUInteger rejectedCount;
+@property (nonatomic, readwrite) NSUInteger inlineCount;
+@property (nonatomic, readwrite) NSUInteger blockedCount;
+@property (nonatomic, readwrite) NSUInteger queueDepth;
+@property (nonatomic, readwrite) NSUInteger maximumQueueDepth;
+@property (nonatomic, readwrite) NSTimeInterval totalQueueWait;
+@property (nonatomic, readwrite) NSTimeInterval maximumQueueWait;
+@end
+
+@implementation KSCompletionDeliveryPoolMetrics
+
+- (NSTimeInterval)averageQueueWait {
+    return self.deliveredCount > 0 ? self.totalQueueWait / self.deliveredCount : 0;
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %lu delivered, %lu rejected, %lu inline, %lu blocked, depth %lu (max %lu), wait avg %.3fms max %.3fms>",
+            NSStringFromClass([self class]),
+            (unsigned long)self.deliveredCount, (unsigned long)self.rejectedCount,
+            (unsigned long)self.inlineCount, (unsigned long)self.blockedCount,
+            (unsigned long)self.queueDepth, (unsigned long)self.maximumQueueDepth,
+            self.averageQueueWait * 1000.0, self.maximumQueueWait * 1000.0];
+}
+
+@end
+
+
+// Owns the bounded queue and is retained by the pool threads, so the pool
+// itself can be deallocated while they are parked.
+@interface KSCompletionDeliveryQueue : NSObject {
+@public
+    pthread_mutex_t _lock;
+    pthread_cond_t _notEmpty;
+    pthread_cond_t _notFull;
+    KSDeliveryEntry *_entries;
+    NSUInteger _capacity;
+    NSUInteger _head;
+    NSUInteger _count;
+    BOOL _shutdown;
+
+    NSUInteger _deliveredCount;
+    NSUInteger _rejectedCount;
+    NSUInteger _inlineCount;
+    NSUInteger _blockedCount;
+    NSUInteger _maximumQueueDepth;
+    uint64_t _totalQueueWait;
+    uint64_t _maximumQueueWait;
+}
+@end
+
+@implementation KSCompletionDeliveryQueue
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity {
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_lock, NULL);
+        pthread_cond_init(&_notEmpty, NULL);
+        pthread_cond_init(&_notFull, NULL);
+        _capacity = MAX(capacity, (NSUInteger)1);
+        _entries = calloc(_capacity, sizeof(KSDeliveryEntry));
+    }
+    return self;
+}
+
+- (void)dealloc {
+    for (NSUInteger i = 0; i < _count; i++) {
+        CFRelease(_entries[(_head + i) % _capacity].block);
+    }
+    free(_entries);
+    pthread_cond_destroy(&_notFull);
+    pthread_cond_destroy(&_notEmpty);
+    pthread_mutex_destroy(&_lock);
+}
+
+- (void)run {
+    ks_currentDeliveryQueue = (__bridge void *)self;
+#if defined(__APPLE__)
+    pthread_setname_np("KSCompletionDeliveryPool");
+#elif defined(__linux__)
+    pthread_setname_np(pthread_self(), "KSDeliveryPool");
+#endif
+
+    while (YES) {
+        pthread_mutex_lock(&_lock);
+        while (_count == 0 && !_shutdown) {
+            pthread_cond_wait(&_notEmpty, &_lock);
+        }
+        if (_count == 0) {
+            pthread_mutex_unlock(&_lock);
+            break;
+        }
+        KSDeliveryEntry entry = _entries[_head];
+        _head = (_head + 1) % _capacity;
+        _count--;
+
+        uint64_t wait = KSClockNow() - entry.enqueuedAt;
+        _deliveredCount++;
+        _totalQueueWait += wait;
+        _maximumQueueWait = MAX(_maximumQueueWait, wait);
+        pthread_cond_signal(&_notFull);
+        pthread_mutex_unlock(&_lock);
+
+        @autoreleasepool {
+            void (^block)(void) = (__bridge_transfer void (^)(void))entry.block;
+            block();
+        }
+    }
+    ks_currentDeliveryQueue = NULL;
+}
+
+@end
+
+
+@interface KSCompletionDeliveryPool ()
+@property (strong, nonatomic) KSCompletionDeliveryQueue *queue;
+@end
+
+@implementation KSCompletionDeliveryPool
+
++ (instancetype)sharedPool {
+    static KSCompletionDeliveryPool *sharedPool;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedPool = [[self alloc] initWithThreadCount:2
+                                     maximumQueueDepth:1024
+                                        overflowPolicy:KSCompletionDeliveryOverflowPolicyBlock];
+    });
+    return sharedPool;
+}
+
+- (instancetype)initWithThreadCount:(NSUInteger)threadCount
+                  maximumQueueDepth:(NSUInteger)maximumQueueDepth
+                     overflowPolicy:(KSCompletionDeliveryOverflowPolicy)overflowPolicy {
+    self = [super init];
+    if (self) {
+        _threadCount = MAX(threadCount, (NSUInteger)1);
+        _maximumQueueDepth = MAX(maximumQueueDepth, (NSUInteger)1);
+        _overflowPolicy = overflowPolicy;
+        self.queue = [[KSCompletionDeliveryQueue alloc] initWithCapacity:_maximumQueueDepth];
+
+        for (NSUInteger i = 0; i < _threadCount; i++) {
+            [NSThread detachNewThreadSelector:@selector(run) toTarget:self.queue withObject:nil];
+        }
+    }
+    return self;
+}
+
+- (void)dealloc {
+    KSCompletionDeliveryQueue *queue = self.queue;
+    pthread_mutex_lock(&queue->_lock);
+    queue->_shutdown = YES;
+    pthread_cond_broadcast(&queue->_notEmpty);
+    pthread_cond_broadcast(&queue->_notFull);
+    pthread_mutex_unlock(&queue->_lock);
+}
+
+- (void)execute:(void (^)(void))block {
+    [self tryExecute:block];
+}
+
+- (BOOL)tryExecute:(void (^)(void))block {
+    KSCompletionDeliveryQueue *queue = self.queue;
+    BOOL runInline = NO;
+
+    pthread_mutex_lock(&queue->_lock);
+    if (queue->_count == queue->_capacity) {
+        KSCompletionDeliveryOverflowPolicy policy = self.overflowPolicy;
+        if (policy == KSCompletionDeliveryOverflowPolicyBlock && ks_currentDeliveryQueue == (__bridge void *)queue) {
+            // waiting here could deadlock the pool on itself
+            policy = KSCompletionDeliveryOverflowPolicyRunInline;
+        }
+        switch (policy) {
+            case KSCompletionDeliveryOverflowPolicyBlock:
+                queue->_blockedCount++;
+                while (queue->_count == queue->_capacity && !queue->_shutdown) {
+                    pthread_cond_wait(&queue->_notFull, &queue->_lock);
+                }
+                break;
+            case KSCompletionDeliveryOverflowPolicyReject:
+                queue->_rejectedCount++;
+                pthread_mutex_unlock(&queue->_lock);
+                return NO;
+            case KSCompletionDeliveryOverflowPolicyRunInline:
+                queue->_inlineCount++;
+                runInline = YES;
+                break;
+        }
+    }
+
+    if (!runInline && queue->_count < queue->_capacity) {
+        NSUInteger tail = (queue->_head + queue->_count) % queue->_capacity;
+        queue->_entries[tail].block = (__bridge_retained void *)[block copy];
+        queue->_entries[tail].enqueuedAt = KSClockNow();
+        queue->_count++;
+        queue->_maximumQueueDepth = MAX(queue->_maximumQueueDepth, queue->_count);
+        pthread_cond_signal(&queue->_notEmpty);
+    } else {
+        runInline = YES;
+    }
+    pthread_mutex_unlock(&queue->_lock);
+
+    if (runInline) {
+        block();
+    }
+    return YES;
+}
+
+- (KSCompletionDeliveryPoolMetrics *)metrics {
+    KSCompletionDeliveryQueue *queue = self.queue;
+    KSCompletionDeliveryPoolMetrics *metrics = [[KSCompletionDeliveryPoolMetrics alloc] init];
+
+    pthread_mutex_lock(&queue->_lock);
+    metrics.deliveredCount = queue->_deliveredCount;
+    metrics.rejectedCount = queue->_rejectedCount;
+    metrics.inlineCount = queue->_inlineCount;
+    metrics.blockedCount = queue->_blockedCount;
+    metrics.queueDepth = queue->_count;
+    metrics.maximumQueueDepth = queue->_maximumQueueDepth;
+    metrics.totalQueueWait = KSClockInterval(queue->_totalQueueWait);
+    metrics.maximumQueueWait = KSClockInterval(queue->_maximumQueueWait);
+    pthread_mutex_unlock(&queue->_lock);
+
+    return metrics;
+}
+
+- (void)resetMetrics {
+    KSCompletionDeliveryQueue *queue = self.queue;
+    pthread_mutex_lock(&queue->_lock);
+    queue->_deliveredCount = 0;
+    queue->_rejectedCount = 0;
+    queue->_inlineCount = 0;
+    queue->_blockedCount = 0;
+    queue->_maximumQueueDepth = queue->_count;
+    queue->_totalQueueWait = 0;
+    queue->_maximumQueueWait = 0;
+    pthread_mutex_unlock(&queue->_lock);
+}
+
+@end
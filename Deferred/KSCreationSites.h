@@ -0,0 +1,36 @@
+#import <Foundation/Foundation.h>
+#import <stdatomic.h>
+
+// Sampled capture of the stacks that create promises and register then:
+// callbacks. Stacks are interned into a deduplicated table of return
+// addresses and referred to by a 32-bit id; 0 means "not sampled".
+
+@class KSPromise;
+
+extern atomic_uint KSCreationSiteSampleInterval;
+extern __thread uint32_t KSCreationSiteCountdown;
+
+uint32_t KSCreationSiteCapture(void);
+
+// One thread-local decrement per call unless this call is sampled.
+static inline uint32_t KSCreationSiteSample(void) {
+    uint32_t interval = atomic_load_explicit(&KSCreationSiteSampleInterval, memory_order_relaxed);
+    if (__builtin_expect(interval == 0, 1)) {
+        return 0;
+    }
+    uint32_t countdown = KSCreationSiteCountdown;
+    if (countdown > 1 && countdown <= interval) {
+        KSCreationSiteCountdown = countdown - 1;
+        return 0;
+    }
+    KSCreationSiteCountdown = interval;
+    return KSCreationSiteCapture();
+}
+
+// Copies up to capacity return addresses of a stack, innermost first.
+NSUInteger KSCreationSiteCopyFrames(uint32_t stack, uintptr_t *frames, NSUInteger capacity);
+// nil for 0 or an unknown stack.
+NSArray *KSCreationSiteSymbols(uint32_t stack);
+
+uint32_t KSCreationSiteOfPromise(KSPromise *promise);
+uint32_t KSRegistrationSiteOfPromise(KSPromise *promise);
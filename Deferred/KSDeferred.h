@@ -1,10 +1,31 @@
 #import "KSPromise.h"
+#import "KSPromise+Parallel.h"
+#import "KSPromise+Loops.h"
+#import "KSFuture.h"
+#import "KSPromisePipeline.h"
+#import "KSPromiseGroup.h"
+#import "KSBatchLoader.h"
+#import "KSPromiseCache.h"
+#import "KSAsyncSemaphore.h"
+#import "KSAsyncReadWriteLock.h"
+#import "KSAsyncPool.h"
+#import "KSAsyncChannel.h"
+#import "KSPromiseTracing.h"
+#import "KSPromiseCriticalPath.h"
+#import "KSPromiseMetrics.h"
+#import "KSPromiseCreationSites.h"
+#import "KSSlowCallbackWatchdog.h"
 #import "KSCancellable.h"
+#import "KSExecutor.h"
+#import "KSWorkStealingExecutor.h"
+#import "KSMainThreadScheduler.h"
+#import "KSEventLoopExecutor.h"
 #import "KSNetworkClient.h"
 #if !TARGET_OS_WATCH && !TARGET_OS_TV
 #import "KSURLConnectionClient.h"
 #endif
 #import "KSURLSessionClient.h"
+#import "KSCompletionDeliveryPool.h"
 #import "KSNullabilityCompat.h"
 #import "KSGenericsCompat.h"
 
@@ -16,6 +37,17 @@ NS_ASSUME_NONNULL_BEGIN
 
 + (instancetype)defer;
 
+// Settles every deferred, then dispatches the continuations of their
+// promises: one execute: per executor, then the inline ones and the
+// onSettled: observers in registration order.
+// NSNull in values resolves with nil.
++ (void)resolveDeferreds:(NSArray KS_GENERIC(KSDeferred *) *)deferreds withValues:(NSArray *)values;
++ (void)rejectDeferreds:(NSArray KS_GENERIC(KSDeferred *) *)deferreds withError:(nullable NSError *)error;
+// The same for whatever the block settles. Continuations registered on
+// settled promises inside the block are held back too. Batches don't nest;
+// an inner one joins the outer.
++ (void)performBatchedResolution:(void (^)(void))block;
+
 - (void)resolveWithValue:(nullable KS_GENERIC_TYPE(ObjectType))value;
 - (void)rejectWithError:(nullable NSError *)error;
 - (void)whenCancelled:(void (^)(void))cancelledBlock;
@@ -1,4 +1,5 @@
 #import "KSDeferred.h"
+#import "KSPromiseBatch.h"
 
 @interface KSPromise KS_GENERIC(ObjectType) (Deferred)
 - (void)resolveWithValue:(KS_GENERIC_TYPE(ObjectType))value;
@@ -18,6 +19,33 @@
     return [[self alloc] init];
 }
 
++ (void)resolveDeferreds:(NSArray *)deferreds withValues:(NSArray *)values {
+    NSAssert(deferreds.count == values.count, @"Every deferred needs a value.");
+    [self performBatchedResolution:^{
+        NSUInteger count = MIN(deferreds.count, values.count);
+        for (NSUInteger i = 0; i < count; i++) {
+            id value = values[i];
+            [deferreds[i] resolveWithValue:value == [NSNull null] ? nil : value];
+        }
+    }];
+}
+
++ (void)rejectDeferreds:(NSArray *)deferreds withError:(NSError *)error {
+    [self performBatchedResolution:^{
+        for (KSDeferred *deferred in deferreds) {
+            [deferred rejectWithError:error];
+        }
+    }];
+}
+
++ (void)performBatchedResolution:(void (^)(void))block {
+    BOOL opened = KSPromiseBatchOpen();
+    block();
+    if (opened) {
+        KSPromiseBatchClose();
+    }
+}
+
 - (id)init {
     self = [super init];
     if (self) {
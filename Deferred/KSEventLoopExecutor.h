@@ -0,0 +1,45 @@
+#import <Foundation/Foundation.h>
+#import "KSExecutor.h"
+#import "KSNullabilityCompat.h"
+#import "KSGenericsCompat.h"
+
+#if defined(__linux__)
+
+@class KSPromise KS_GENERIC(ObjectType);
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Runs continuations on the thread driving an epoll loop. execute: may be
+// called from any thread; it queues the block and wakes the loop through an
+// eventfd. Queued blocks run in batches from -processEventsWithTimeout:.
+//
+// To drive it from an existing epoll loop, add fileDescriptor to that loop
+// for EPOLLIN and call -processEventsWithTimeout:0 whenever it is readable.
+@interface KSEventLoopExecutor : NSObject <KSExecutor>
+
+// An epoll descriptor that becomes readable when there is work to do.
+@property (nonatomic, readonly) int fileDescriptor;
+
+- (nullable instancetype)init;
+
+- (void)execute:(void (^)(void))block;
+
+// Resolves with the ready events (EPOLLIN, EPOLLOUT, EPOLLERR, ...) as an
+// NSNumber once fd becomes ready for any of events. Cancelling the promise
+// stops waiting.
+- (KSPromise KS_GENERIC(NSNumber *) *)promiseForFileDescriptor:(int)fd events:(uint32_t)events;
+
+// Waits up to timeout (forever if negative) for readiness or queued work,
+// resolves ready file descriptor promises and runs one batch of queued
+// blocks. Returns the number of blocks run.
+- (NSUInteger)processEventsWithTimeout:(NSTimeInterval)timeout;
+
+// Processes events on the calling thread until -stop is called.
+- (void)run;
+- (void)stop;
+
+@end
+
+NS_ASSUME_NONNULL_END
+
+#endif
@@ -0,0 +1,227 @@
+#import "KSEventLoopExecutor.h"
+
+#if defined(__linux__)
+
+#import "KSDeferred.h"
+#import <errno.h>
+#import <pthread.h>
+#import <sys/epoll.h>
+#import <sys/eventfd.h>
+#import <unistd.h>
+
+
+static const int KSEventLoopMaximumEvents = 256;
+
+
+@interface KSEventLoopWaiter : NSObject
+@property (assign, nonatomic) uint32_t events;
+@property (strong, nonatomic) KSDeferred *deferred;
+@end
+
+@implementation KSEventLoopWaiter
+@end
+
+
+@interface KSEventLoopExecutor () {
+    pthread_mutex_t _lock;
+    int _eventFileDescriptor;
+    struct epoll_event _events[KSEventLoopMaximumEvents];
+}
+
+@property (strong, nonatomic) NSMutableArray *queue;
+@property (assign, nonatomic) BOOL wakePending;
+@property (assign, nonatomic) BOOL stopped;
+@property (strong, nonatomic) NSMutableDictionary *waiters;
+
+@end
+
+@implementation KSEventLoopExecutor
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_lock, NULL);
+        self.queue = [NSMutableArray array];
+        self.waiters = [NSMutableDictionary dictionary];
+
+        _fileDescriptor = epoll_create1(EPOLL_CLOEXEC);
+        _eventFileDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (_fileDescriptor < 0 || _eventFileDescriptor < 0) {
+            return nil;
+        }
+
+        struct epoll_event event = { .events = EPOLLIN, .data.fd = _eventFileDescriptor };
+        if (epoll_ctl(_fileDescriptor, EPOLL_CTL_ADD, _eventFileDescriptor, &event) != 0) {
+            return nil;
+        }
+    }
+    return self;
+}
+
+- (void)dealloc {
+    if (_eventFileDescriptor >= 0) {
+        close(_eventFileDescriptor);
+    }
+    if (_fileDescriptor >= 0) {
+        close(_fileDescriptor);
+    }
+    pthread_mutex_destroy(&_lock);
+}
+
+- (void)execute:(void (^)(void))block {
+    pthread_mutex_lock(&_lock);
+    [self.queue addObject:[block copy]];
+    BOOL wake = !self.wakePending;
+    self.wakePending = YES;
+    pthread_mutex_unlock(&_lock);
+
+    if (wake) {
+        uint64_t one = 1;
+        ssize_t written;
+        do {
+            written = write(_eventFileDescriptor, &one, sizeof(one));
+        } while (written < 0 && errno == EINTR);
+    }
+}
+
+- (KSPromise *)promiseForFileDescriptor:(int)fd events:(uint32_t)events {
+    KSDeferred *deferred = [KSDeferred defer];
+    KSEventLoopWaiter *waiter = [[KSEventLoopWaiter alloc] init];
+    waiter.events = events;
+    waiter.deferred = deferred;
+
+    __weak KSEventLoopExecutor *weakSelf = self;
+    __weak KSEventLoopWaiter *weakWaiter = waiter;
+    [deferred whenCancelled:^{
+        [weakSelf execute:^{
+            [weakSelf removeWaiter:weakWaiter forFileDescriptor:fd];
+        }];
+    }];
+
+    // Registration always happens on the loop thread, which owns the waiters.
+    [self execute:^{
+        [self addWaiter:waiter forFileDescriptor:fd];
+    }];
+    return deferred.promise;
+}
+
+- (NSUInteger)processEventsWithTimeout:(NSTimeInterval)timeout {
+    int timeoutMilliseconds = timeout < 0 ? -1 : (int)(timeout * 1000.0);
+    int count = epoll_wait(_fileDescriptor, _events, KSEventLoopMaximumEvents, timeoutMilliseconds);
+    for (int i = 0; i < count; i++) {
+        int fd = _events[i].data.fd;
+        if (fd == _eventFileDescriptor) {
+            uint64_t value;
+            while (read(_eventFileDescriptor, &value, sizeof(value)) < 0 && errno == EINTR);
+        } else {
+            [self fileDescriptor:fd becameReady:_events[i].events];
+        }
+    }
+    return [self drain];
+}
+
+- (void)run {
+    self.stopped = NO;
+    while (!self.stopped) {
+        @autoreleasepool {
+            [self processEventsWithTimeout:-1];
+        }
+    }
+}
+
+- (void)stop {
+    [self execute:^{
+        self.stopped = YES;
+    }];
+}
+
+#pragma mark - Private methods
+
+- (NSUInteger)drain {
+    pthread_mutex_lock(&_lock);
+    NSArray *batch = self.queue;
+    self.queue = [NSMutableArray array];
+    self.wakePending = NO;
+    pthread_mutex_unlock(&_lock);
+
+    for (void (^block)(void) in batch) {
+        @autoreleasepool {
+            block();
+        }
+    }
+    return batch.count;
+}
+
+- (void)addWaiter:(KSEventLoopWaiter *)waiter forFileDescriptor:(int)fd {
+    if (waiter.deferred.promise.cancelled) {
+        return;
+    }
+
+    NSMutableArray *waiters = self.waiters[@(fd)];
+    int operation = waiters ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (!waiters) {
+        waiters = [NSMutableArray array];
+    }
+    [waiters addObject:waiter];
+
+    if ([self armFileDescriptor:fd waiters:waiters operation:operation]) {
+        self.waiters[@(fd)] = waiters;
+    } else {
+        NSError *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        [waiters removeObject:waiter];
+        [waiter.deferred rejectWithError:error];
+    }
+}
+
+- (void)removeWaiter:(KSEventLoopWaiter *)waiter forFileDescriptor:(int)fd {
+    NSMutableArray *waiters = self.waiters[@(fd)];
+    if (!waiter || ![waiters containsObject:waiter]) {
+        return;
+    }
+    [waiters removeObject:waiter];
+    [self rearmFileDescriptor:fd waiters:waiters];
+}
+
+- (void)fileDescriptor:(int)fd becameReady:(uint32_t)events {
+    NSMutableArray *waiters = self.waiters[@(fd)];
+    NSMutableArray *ready = [NSMutableArray array];
+    for (KSEventLoopWaiter *waiter in waiters) {
+        if (waiter.events & events || events & (EPOLLERR | EPOLLHUP)) {
+            [ready addObject:waiter];
+        }
+    }
+    [waiters removeObjectsInArray:ready];
+    [self rearmFileDescriptor:fd waiters:waiters];
+
+    for (KSEventLoopWaiter *waiter in ready) {
+        [waiter.deferred resolveWithValue:@(events)];
+    }
+}
+
+// Registrations are one-shot, so a file descriptor is re-armed with the
+// events its remaining waiters want, or removed when nobody is waiting.
+- (void)rearmFileDescriptor:(int)fd waiters:(NSMutableArray *)waiters {
+    if (waiters.count > 0 && [self armFileDescriptor:fd waiters:waiters operation:EPOLL_CTL_MOD]) {
+        return;
+    }
+    NSError *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+    epoll_ctl(_fileDescriptor, EPOLL_CTL_DEL, fd, NULL);
+    [self.waiters removeObjectForKey:@(fd)];
+
+    for (KSEventLoopWaiter *waiter in waiters) {
+        [waiter.deferred rejectWithError:error];
+    }
+}
+
+- (BOOL)armFileDescriptor:(int)fd waiters:(NSArray *)waiters operation:(int)operation {
+    uint32_t events = 0;
+    for (KSEventLoopWaiter *waiter in waiters) {
+        events |= waiter.events;
+    }
+    struct epoll_event event = { .events = events | EPOLLONESHOT, .data.fd = fd };
+    return epoll_ctl(_fileDescriptor, operation, fd, &event) == 0;
+}
+
+@end
+
+#endif
@@ -0,0 +1,8 @@
+#import <Foundation/Foundation.h>
+
+
+@protocol KSExecutor<NSObject>
+
+- (void)execute:(void (^)(void))block;
+
+@end
@@ -0,0 +1,49 @@
+#import <Foundation/Foundation.h>
+#import "KSPromise.h"
+#import "KSCancellable.h"
+#import "KSExecutor.h"
+#import "KSNullabilityCompat.h"
+#import "KSGenericsCompat.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+FOUNDATION_EXPORT NSString *const KSFutureErrorDomain;
+
+typedef NS_ENUM(NSInteger, KSFutureErrorCode) {
+    KSFutureErrorContinuationTaken = 1,
+};
+
+// A one-shot result with exactly one consumer. Where KSPromise keeps a
+// callbacks array, a cancellables table and a semaphore, and holds its value
+// for as long as it lives, a future stores its single continuation inline and
+// lets go of the value as soon as the continuation has it. Use it for linear
+// chains; convert to a KSPromise where more than one consumer is needed.
+//
+// Registering a second continuation (then:, error: or -promise) is a
+// programming error; the second one is rejected with
+// KSFutureErrorContinuationTaken and the first is left as it was.
+@interface KSFuture KS_GENERIC(ObjectType) : NSObject<KSCancellable>
+
+#pragma mark - Constructors
++ (KSFuture *)future:(void (^)(resolveType resolve, rejectType reject))futureCallback;
++ (KSFuture *)resolve:(nullable KS_GENERIC_TYPE(ObjectType))value;
++ (KSFuture *)reject:(NSError *)error;
++ (KSFuture *)async:(__nullable id(^)(void))block onExecutor:(id<KSExecutor>)executor;
+
+// Observes the promise without adding a child promise to it.
++ (KSFuture KS_GENERIC(ObjectType) *)futureWithPromise:(KSPromise KS_GENERIC(ObjectType) *)promise;
+
+#pragma mark - Continuation
+// As with KSPromise, a callback may return a value, an NSError, a KSPromise or
+// a KSFuture, and a nil callback passes the result through.
+- (KSFuture *)then:(nullable __nullable id(^)(__nullable KS_GENERIC_TYPE(ObjectType) value))fulfilledCallback error:(nullable promiseErrorCallback)errorCallback;
+- (KSFuture *)then:(nullable __nullable id(^)(__nullable KS_GENERIC_TYPE(ObjectType) value))fulfilledCallback error:(nullable promiseErrorCallback)errorCallback onExecutor:(nullable id<KSExecutor>)executor;
+- (KSFuture *)then:(__nullable id(^)(__nullable KS_GENERIC_TYPE(ObjectType) value))fulfilledCallback;
+- (KSFuture *)error:(promiseErrorCallback)errorCallback;
+
+// Uses up the continuation; cancelling the promise cancels the future.
+- (KSPromise KS_GENERIC(ObjectType) *)promise;
+
+@end
+
+NS_ASSUME_NONNULL_END
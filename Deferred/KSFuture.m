@@ -0,0 +1,299 @@
+#import "KSFuture.h"
+#import "KSDeferred.h"
+#import <pthread.h>
+
+NSString *const KSFutureErrorDomain = @"KSFutureErrorDomain";
+
+static NSError *KSFutureContinuationTakenError(void) {
+    return [NSError errorWithDomain:KSFutureErrorDomain
+                               code:KSFutureErrorContinuationTaken
+                           userInfo:@{NSLocalizedDescriptionKey: @"The future already has a continuation."}];
+}
+
+
+typedef void (^KSFutureSink)(id result, BOOL rejected);
+
+@class KSFuture;
+static void KSFutureRunContinuation(promiseValueCallback fulfilledCallback, promiseErrorCallback errorCallback,
+                                    __strong id *result, BOOL rejected, KSFuture *child);
+
+@interface KSFuture () {
+    pthread_mutex_t _lock;
+    id _result;
+    BOOL _settled;
+    BOOL _rejected;
+    BOOL _cancelled;
+    BOOL _hasContinuation;
+
+    // the continuation: either callbacks feeding a child, or a sink
+    promiseValueCallback _fulfilledCallback;
+    promiseErrorCallback _errorCallback;
+    id<KSExecutor> _executor;
+    KSFuture *_child;
+    KSFutureSink _sink;
+
+    // what cancelling this future cancels
+    __weak id<KSCancellable> _upstream;
+}
+
+- (void)settleWithResult:(id)result rejected:(BOOL)rejected;
+- (void)adoptResult:(id)result;
+
+@end
+
+@implementation KSFuture
+
+- (id)init {
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_lock, NULL);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    pthread_mutex_destroy(&_lock);
+}
+
++ (KSFuture *)future:(void (^)(resolveType resolve, rejectType reject))futureCallback {
+    KSFuture *future = [[KSFuture alloc] init];
+    futureCallback(^(id value) {
+        [future settleWithResult:value rejected:NO];
+    }, ^(NSError *error) {
+        [future settleWithResult:error rejected:YES];
+    });
+    return future;
+}
+
++ (KSFuture *)resolve:(id)value {
+    KSFuture *future = [[KSFuture alloc] init];
+    [future settleWithResult:value rejected:NO];
+    return future;
+}
+
++ (KSFuture *)reject:(NSError *)error {
+    KSFuture *future = [[KSFuture alloc] init];
+    [future settleWithResult:error rejected:YES];
+    return future;
+}
+
++ (KSFuture *)async:(id (^)(void))block onExecutor:(id<KSExecutor>)executor {
+    KSFuture *future = [[KSFuture alloc] init];
+    [executor execute:^{
+        if (![future isCancelled]) {
+            [future adoptResult:block()];
+        }
+    }];
+    return future;
+}
+
++ (KSFuture *)futureWithPromise:(KSPromise *)promise {
+    KSFuture *future = [[KSFuture alloc] init];
+    future->_upstream = promise;
+    [promise onSettled:^(KSPromise *settled) {
+        [future settleWithResult:settled.rejected ? settled.error : settled.value rejected:settled.rejected];
+    }];
+    return future;
+}
+
+#pragma mark - Continuation
+
+- (KSFuture *)then:(promiseValueCallback)fulfilledCallback error:(promiseErrorCallback)errorCallback {
+    return [self then:fulfilledCallback error:errorCallback onExecutor:nil];
+}
+
+- (KSFuture *)then:(promiseValueCallback)fulfilledCallback
+             error:(promiseErrorCallback)errorCallback
+        onExecutor:(id<KSExecutor>)executor {
+    KSFuture *child = [[KSFuture alloc] init];
+    child->_upstream = self;
+
+    pthread_mutex_lock(&_lock);
+    BOOL registered = !_hasContinuation;
+    BOOL deliver = registered && _settled;
+    if (registered) {
+        _hasContinuation = YES;
+        _fulfilledCallback = fulfilledCallback;
+        _errorCallback = errorCallback;
+        _executor = executor;
+        _child = child;
+    }
+    pthread_mutex_unlock(&_lock);
+
+    // the child of a refused continuation doesn't lead back here, so
+    // cancelling it leaves the first consumer alone
+    if (!registered) {
+        child->_upstream = nil;
+        [child settleWithResult:KSFutureContinuationTakenError() rejected:YES];
+        return child;
+    }
+
+    if (deliver) {
+        [self deliver];
+    }
+    return child;
+}
+
+- (KSFuture *)then:(promiseValueCallback)fulfilledCallback {
+    return [self then:fulfilledCallback error:nil];
+}
+
+- (KSFuture *)error:(promiseErrorCallback)errorCallback {
+    return [self then:nil error:errorCallback];
+}
+
+- (KSPromise *)promise {
+    KSDeferred *deferred = [KSDeferred defer];
+    [deferred.promise addCancellable:self];
+    [self setSink:^(id result, BOOL rejected) {
+        if (rejected) {
+            [deferred rejectWithError:result];
+        } else {
+            [deferred resolveWithValue:result];
+        }
+    }];
+    return deferred.promise;
+}
+
+- (void)cancel {
+    pthread_mutex_lock(&_lock);
+    _cancelled = YES;
+    _result = nil;
+    _fulfilledCallback = nil;
+    _errorCallback = nil;
+    _executor = nil;
+    _child = nil;
+    _sink = nil;
+    id<KSCancellable> upstream = _upstream;
+    pthread_mutex_unlock(&_lock);
+
+    [upstream cancel];
+}
+
+#pragma mark - Private methods
+
+- (BOOL)isCancelled {
+    pthread_mutex_lock(&_lock);
+    BOOL cancelled = _cancelled;
+    pthread_mutex_unlock(&_lock);
+    return cancelled;
+}
+
+- (void)setUpstream:(id<KSCancellable>)upstream {
+    pthread_mutex_lock(&_lock);
+    _upstream = upstream;
+    pthread_mutex_unlock(&_lock);
+}
+
+- (void)setSink:(KSFutureSink)sink {
+    pthread_mutex_lock(&_lock);
+    BOOL registered = !_hasContinuation;
+    BOOL deliver = registered && _settled;
+    if (registered) {
+        _hasContinuation = YES;
+        _sink = sink;
+    }
+    pthread_mutex_unlock(&_lock);
+
+    if (!registered) {
+        sink(KSFutureContinuationTakenError(), YES);
+        return;
+    }
+
+    if (deliver) {
+        [self deliver];
+    }
+}
+
+- (void)settleWithResult:(id)result rejected:(BOOL)rejected {
+    pthread_mutex_lock(&_lock);
+    if (_settled || _cancelled) {
+        pthread_mutex_unlock(&_lock);
+        return;
+    }
+    _settled = YES;
+    _result = result;
+    _rejected = rejected;
+    BOOL deliver = _hasContinuation;
+    pthread_mutex_unlock(&_lock);
+
+    if (deliver) {
+        [self deliver];
+    }
+}
+
+// Settles with a value a callback returned, following promises and futures.
+- (void)adoptResult:(id)result {
+    if ([result isKindOfClass:[KSFuture class]]) {
+        KSFuture *future = result;
+        [self setUpstream:future];
+        [future setSink:^(id adopted, BOOL rejected) {
+            [self settleWithResult:adopted rejected:rejected];
+        }];
+    } else if ([result isKindOfClass:[KSPromise class]]) {
+        KSPromise *promise = result;
+        [self setUpstream:promise];
+        [promise onSettled:^(KSPromise *settled) {
+            [self settleWithResult:settled.rejected ? settled.error : settled.value rejected:settled.rejected];
+        }];
+    } else {
+        [self settleWithResult:result rejected:[result isKindOfClass:[NSError class]]];
+    }
+}
+
+// Called once both the result and the continuation are in. Hands both over
+// and forgets them, so the value lives no longer than the callback needs it.
+- (void)deliver {
+    pthread_mutex_lock(&_lock);
+    if (_cancelled) {
+        pthread_mutex_unlock(&_lock);
+        return;
+    }
+    id result = _result;
+    BOOL rejected = _rejected;
+    promiseValueCallback fulfilledCallback = _fulfilledCallback;
+    promiseErrorCallback errorCallback = _errorCallback;
+    id<KSExecutor> executor = _executor;
+    KSFuture *child = _child;
+    KSFutureSink sink = _sink;
+    _result = nil;
+    _fulfilledCallback = nil;
+    _errorCallback = nil;
+    _executor = nil;
+    _child = nil;
+    _sink = nil;
+    pthread_mutex_unlock(&_lock);
+
+    if (sink) {
+        sink(result, rejected);
+    } else if (executor) {
+        __block id pending = result;
+        result = nil;
+        [executor execute:^{
+            KSFutureRunContinuation(fulfilledCallback, errorCallback, &pending, rejected, child);
+        }];
+    } else {
+        KSFutureRunContinuation(fulfilledCallback, errorCallback, &result, rejected, child);
+    }
+}
+
+@end
+
+
+// Drops the result before settling the child, so a long inline chain doesn't
+// keep every stage's value alive until it unwinds.
+static void KSFutureRunContinuation(promiseValueCallback fulfilledCallback, promiseErrorCallback errorCallback,
+                                    __strong id *result, BOOL rejected, KSFuture *child) {
+    id next;
+    if (rejected) {
+        next = errorCallback ? errorCallback(*result) : *result;
+    } else {
+        next = fulfilledCallback ? fulfilledCallback(*result) : *result;
+    }
+    *result = nil;
+    if (rejected && !errorCallback) {
+        [child settleWithResult:next rejected:YES];
+    } else {
+        [child adoptResult:next];
+    }
+}
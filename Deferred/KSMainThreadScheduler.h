@@ -0,0 +1,36 @@
+#import <Foundation/Foundation.h>
+#import "KSExecutor.h"
+#import "KSNullabilityCompat.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface KSMainThreadSchedulerDrainStatistics : NSObject
+
+// Time spent running blocks during one run loop turn.
+@property (nonatomic, readonly) NSTimeInterval duration;
+@property (nonatomic, readonly) NSUInteger executedCount;
+// Blocks left queued for the next turn when the budget ran out.
+@property (nonatomic, readonly) NSUInteger remainingCount;
+
+@end
+
+// Runs blocks on the main thread without monopolizing it. Queued blocks are
+// drained until frameBudget is spent, then the scheduler yields to the run
+// loop and continues on its next turn. At least one block runs per turn.
+@interface KSMainThreadScheduler : NSObject <KSExecutor>
+
+@property (assign, nonatomic) NSTimeInterval frameBudget;
+@property (copy, nonatomic, nullable) void (^drainObserver)(KSMainThreadSchedulerDrainStatistics *statistics);
+@property (strong, nonatomic, readonly, nullable) KSMainThreadSchedulerDrainStatistics *lastDrainStatistics;
+@property (nonatomic, readonly) NSUInteger pendingCount;
+
++ (instancetype)sharedScheduler;
+
+- (instancetype)init;
+- (instancetype)initWithFrameBudget:(NSTimeInterval)frameBudget;
+
+- (void)execute:(void (^)(void))block;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,160 @@
+#import "KSMainThreadScheduler.h"
+#import <pthread.h>
+
+
+static const NSTimeInterval KSMainThreadSchedulerDefaultFrameBudget = 0.004;
+
+
+@interface KSMainThreadSchedulerDrainStatistics ()
+@property (nonatomic, readwrite) NSTimeInterval duration;
+@property (nonatomic, readwrite) NSUInteger executedCount;
+@property (nonatomic, readwrite) NSUInteger remainingCount;
+@end
+
+@implementation KSMainThreadSchedulerDrainStatistics
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %.3fms, %lu executed, %lu remaining>",
+            NSStringFromClass([self class]), self.duration * 1000.0,
+            (unsigned long)self.executedCount, (unsigned long)self.remainingCount];
+}
+
+@end
+
+
+@interface KSMainThreadScheduler () {
+    pthread_mutex_t _lock;
+}
+
+@property (strong, nonatomic) NSMutableArray *queue;
+@property (assign, nonatomic) NSUInteger queueHead;
+@property (assign, nonatomic) BOOL drainScheduled;
+@property (strong, nonatomic, readwrite) KSMainThreadSchedulerDrainStatistics *lastDrainStatistics;
+
+@end
+
+@implementation KSMainThreadScheduler
+
++ (instancetype)sharedScheduler {
+    static KSMainThreadScheduler *sharedScheduler;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedScheduler = [[self alloc] init];
+    });
+    return sharedScheduler;
+}
+
+- (instancetype)init {
+    return [self initWithFrameBudget:KSMainThreadSchedulerDefaultFrameBudget];
+}
+
+- (instancetype)initWithFrameBudget:(NSTimeInterval)frameBudget {
+    self = [super init];
+    if (self) {
+        self.frameBudget = frameBudget;
+        self.queue = [NSMutableArray array];
+        pthread_mutex_init(&_lock, NULL);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    pthread_mutex_destroy(&_lock);
+}
+
+- (void)execute:(void (^)(void))block {
+    pthread_mutex_lock(&_lock);
+    [self.queue addObject:[block copy]];
+    BOOL scheduleDrain = !self.drainScheduled;
+    self.drainScheduled = YES;
+    pthread_mutex_unlock(&_lock);
+
+    if (scheduleDrain) {
+        [self scheduleDrain];
+    }
+}
+
+- (NSUInteger)pendingCount {
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = self.queue.count - self.queueHead;
+    pthread_mutex_unlock(&_lock);
+    return count;
+}
+
+#pragma mark - Private methods
+
+- (void)scheduleDrain {
+    void (^drain)(void) = ^{
+        [self drain];
+    };
+#if defined(__APPLE__)
+    // Unlike the main queue, this waits for the next run loop turn and also
+    // runs while the run loop is tracking (e.g. during scrolling).
+    CFRunLoopPerformBlock(CFRunLoopGetMain(), kCFRunLoopCommonModes, drain);
+    CFRunLoopWakeUp(CFRunLoopGetMain());
+#else
+    dispatch_async(dispatch_get_main_queue(), drain);
+#endif
+}
+
+- (void (^)(void))dequeueWithRemainingCount:(NSUInteger *)remainingCount {
+    void (^block)(void) = nil;
+    pthread_mutex_lock(&_lock);
+    if (self.queueHead < self.queue.count) {
+        block = self.queue[self.queueHead];
+        self.queue[self.queueHead] = [NSNull null];
+        self.queueHead++;
+    }
+    // Drop the consumed prefix once it is half the array, so a queue that
+    // never empties under sustained load doesn't keep growing.
+    if (self.queueHead == self.queue.count) {
+        [self.queue removeAllObjects];
+        self.queueHead = 0;
+    } else if (self.queueHead > self.queue.count / 2) {
+        [self.queue removeObjectsInRange:NSMakeRange(0, self.queueHead)];
+        self.queueHead = 0;
+    }
+    *remainingCount = self.queue.count - self.queueHead;
+    pthread_mutex_unlock(&_lock);
+    return block;
+}
+
+- (void)drain {
+    NSProcessInfo *processInfo = [NSProcessInfo processInfo];
+    NSTimeInterval start = processInfo.systemUptime;
+    NSTimeInterval elapsed = 0;
+    NSUInteger executed = 0;
+    NSUInteger remaining = 0;
+
+    void (^block)(void);
+    while ((block = [self dequeueWithRemainingCount:&remaining])) {
+        @autoreleasepool {
+            block();
+        }
+        executed++;
+        elapsed = processInfo.systemUptime - start;
+        if (elapsed >= self.frameBudget) {
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&_lock);
+    remaining = self.queue.count - self.queueHead;
+    self.drainScheduled = remaining > 0;
+    pthread_mutex_unlock(&_lock);
+
+    KSMainThreadSchedulerDrainStatistics *statistics = [[KSMainThreadSchedulerDrainStatistics alloc] init];
+    statistics.duration = elapsed;
+    statistics.executedCount = executed;
+    statistics.remainingCount = remaining;
+    self.lastDrainStatistics = statistics;
+    if (self.drainObserver) {
+        self.drainObserver(statistics);
+    }
+
+    if (remaining > 0) {
+        [self scheduleDrain];
+    }
+}
+
+@end
@@ -0,0 +1,23 @@
+#import <Foundation/Foundation.h>
+#import <stdatomic.h>
+
+// Hooks KSPromise uses to feed KSPromiseMetrics. A promise created while
+// metrics are started gets a record and reports through it for the rest of
+// its life; promises created while stopped have no record and cost one
+// relaxed load at creation.
+
+typedef struct KSMetricsRecord KSMetricsRecord;
+
+extern atomic_bool KSMetricsEnabled;
+
+#define KS_METRICS_ENABLED() __builtin_expect(atomic_load_explicit(&KSMetricsEnabled, memory_order_relaxed), 0)
+
+// creationSite is a KSCreationSites stack id, or 0.
+KSMetricsRecord *KSMetricsPromiseCreated(void *promise, uint32_t creationSite);
+// The continuation hooks and Settled/Cancelled are called under the promise's lock.
+void KSMetricsContinuationQueued(KSMetricsRecord *record, BOOL pending);
+void KSMetricsPromiseSettled(KSMetricsRecord *record);
+void KSMetricsPromiseCancelled(KSMetricsRecord *record);
+// start is the KSClockNow() at which the callback began running.
+void KSMetricsContinuationRan(KSMetricsRecord *record, uint64_t start);
+void KSMetricsPromiseDeallocated(KSMetricsRecord *record, BOOL pending);
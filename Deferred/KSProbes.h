@@ -0,0 +1,60 @@
+#import <Foundation/Foundation.h>
+#import "KSClock.h"
+
+// USDT probes for perf, bpftrace and SystemTap on Linux. Each probe has a
+// semaphore the tracer raises while it is attached, so probe arguments are
+// only evaluated while someone is listening. Define KS_DISABLE_PROBES to
+// leave them out, e.g.
+//
+//   bpftrace -e 'usdt:./app:ksdeferred:resolve { @ns = hist(arg1); }'
+//
+// Promise probes: create(promise), resolve(promise, ns since create),
+// reject(promise, ns since create), callback_run(promise, child, ns),
+// cancel(promise), wait_begin(promise, timeout ns or 0),
+// wait_end(promise, ns waited, timed out).
+//
+// Network probes: request_start(request, URL), response(request, HTTP status,
+// ns since start), completion_dispatch(request, ns from response to delivery).
+// Times since create or start are 0 for objects created before the probe
+// was attached.
+
+#if defined(__linux__) && !defined(KS_DISABLE_PROBES) && __has_include(<sys/sdt.h>)
+
+#define KS_PROBES 1
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define KS_PROBE_NAMES(X) \
+    X(create) X(resolve) X(reject) X(callback_run) X(cancel) X(wait_begin) X(wait_end) \
+    X(request_start) X(response) X(completion_dispatch)
+
+#define KS_PROBE_SEMAPHORE_DECLARE(name) \
+    __extension__ extern unsigned short ksdeferred_##name##_semaphore __attribute__((unused)) __attribute__((section(".probes")));
+KS_PROBE_NAMES(KS_PROBE_SEMAPHORE_DECLARE)
+
+#define KS_PROBE_ENABLED(name) __builtin_expect(ksdeferred_##name##_semaphore, 0)
+
+#define KS_PROBE1(name, a) do { \
+    if (KS_PROBE_ENABLED(name)) STAP_PROBE1(ksdeferred, name, a); \
+} while (0)
+#define KS_PROBE2(name, a, b) do { \
+    if (KS_PROBE_ENABLED(name)) STAP_PROBE2(ksdeferred, name, a, b); \
+} while (0)
+#define KS_PROBE3(name, a, b, c) do { \
+    if (KS_PROBE_ENABLED(name)) STAP_PROBE3(ksdeferred, name, a, b, c); \
+} while (0)
+
+#else
+
+#define KS_PROBES 0
+#define KS_PROBE_ENABLED(name) 0
+// arguments stay referenced so locals that only feed probes don't warn
+#define KS_PROBE1(name, a) do { if (0) { (void)(a); } } while (0)
+#define KS_PROBE2(name, a, b) do { if (0) { (void)(a); (void)(b); } } while (0)
+#define KS_PROBE3(name, a, b, c) do { if (0) { (void)(a); (void)(b); (void)(c); } } while (0)
+
+#endif
+
+static inline uint64_t KSProbeElapsed(uint64_t start) {
+    return start == 0 ? 0 : KSClockNow() - start;
+}
@@ -0,0 +1,10 @@
+#import "KSProbes.h"
+
+#if KS_PROBES
+
+// Normally generated by `dtrace -G`; the tracer bumps these when it attaches.
+#define KS_PROBE_SEMAPHORE_DEFINE(name) \
+    __extension__ unsigned short ksdeferred_##name##_semaphore __attribute__((unused)) __attribute__((section(".probes")));
+KS_PROBE_NAMES(KS_PROBE_SEMAPHORE_DEFINE)
+
+#endif
@@ -0,0 +1,35 @@
+#import "KSPromise.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Asynchronous loops that run in constant stack and keep no promise alive past
+// its iteration, however many iterations there are. Iterations that finish
+// synchronously are run from a loop rather than by recursion, and each
+// iteration's promise is observed with onSettled: rather than chained with
+// then:. Blocks may return a value, an NSError to stop and reject, or a
+// KSPromise to wait for. Cancelling the returned promise stops the loop from
+// starting further iterations.
+@interface KSPromise KS_GENERIC(ObjectType) (Loops)
+
+// Calls each factory once the previous one's promise has fulfilled and
+// resolves with their values in order, nil values becoming NSNull. Rejects
+// with the first error without calling the remaining factories.
++ (KSPromise KS_GENERIC(NSArray *) *)sequence:(NSArray *)factories;
+
+// Runs body with the current value, starting from initialValue, while
+// condition holds for it; each iteration's result becomes the next value.
+// Resolves with the value for which condition failed.
++ (KSPromise *)repeatWhile:(BOOL (^)(__nullable id value))condition
+              initialValue:(nullable id)initialValue
+                      body:(__nullable id (^)(__nullable id value))body;
+
+// Calls block for every element of array with at most concurrency iterations
+// outstanding (0 means 1), in order of the array. Resolves with nil once all
+// have fulfilled; rejects with the first error and starts no more.
++ (KSPromise *)forEach:(NSArray *)array
+           concurrency:(NSUInteger)concurrency
+                 block:(__nullable id (^)(id object))block;
+
+@end
+
+NS_ASSUME_NONNULL_END
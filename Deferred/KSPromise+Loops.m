@@ -0,0 +1,259 @@
+#import "KSPromise+Loops.h"
+#import "KSDeferred.h"
+#import <pthread.h>
+
+
+// Trampoline shared by the loops. -schedule is called whenever an iteration
+// finishes; if another call is already inside -step on this or any thread it
+// only marks the loop dirty, and that call steps again before returning. So
+// an iteration that settles synchronously never nests a further -step.
+@interface KSPromiseLoop : NSObject {
+@protected
+    pthread_mutex_t _lock;
+    BOOL _finished;
+}
+@property (strong, nonatomic, readonly) KSDeferred *deferred;
+
+- (void)schedule;
+// Starts what iterations it can. Only one thread is ever inside -step.
+- (void)step;
+// Calls completion with the result, directly or once the promise settles.
+- (void)observeResult:(id)result completion:(void (^)(id value, BOOL rejected))completion;
+// Call with the lock held. Returns YES if the loop wasn't already finished.
+- (BOOL)finish;
+- (void)settleWithValue:(id)value rejected:(BOOL)rejected;
+
+@end
+
+@implementation KSPromiseLoop {
+    BOOL _stepping;
+    BOOL _dirty;
+}
+
+- (id)init {
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_lock, NULL);
+        _deferred = [KSDeferred defer];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    pthread_mutex_destroy(&_lock);
+}
+
+- (void)schedule {
+    pthread_mutex_lock(&_lock);
+    if (_stepping) {
+        _dirty = YES;
+        pthread_mutex_unlock(&_lock);
+        return;
+    }
+    _stepping = YES;
+    do {
+        _dirty = NO;
+        pthread_mutex_unlock(&_lock);
+        [self step];
+        pthread_mutex_lock(&_lock);
+    } while (_dirty);
+    _stepping = NO;
+    pthread_mutex_unlock(&_lock);
+}
+
+- (void)step {
+}
+
+- (void)observeResult:(id)result completion:(void (^)(id value, BOOL rejected))completion {
+    if ([result isKindOfClass:[KSPromise class]]) {
+        [(KSPromise *)result onSettled:^(KSPromise *settled) {
+            completion(settled.rejected ? settled.error : settled.value, settled.rejected);
+        }];
+    } else {
+        completion(result, [result isKindOfClass:[NSError class]]);
+    }
+}
+
+- (BOOL)finish {
+    if (_finished) {
+        return NO;
+    }
+    _finished = YES;
+    return YES;
+}
+
+- (void)settleWithValue:(id)value rejected:(BOOL)rejected {
+    if (rejected) {
+        [self.deferred rejectWithError:value];
+    } else {
+        [self.deferred resolveWithValue:value];
+    }
+}
+
+@end
+
+
+@interface KSPromiseForEachLoop : KSPromiseLoop
+- (id)initWithArray:(NSArray *)array concurrency:(NSUInteger)concurrency collectsValues:(BOOL)collectsValues block:(id (^)(id object))block;
+@end
+
+@implementation KSPromiseForEachLoop {
+    NSArray *_array;
+    NSUInteger _concurrency;
+    id (^_block)(id object);
+    NSMutableArray *_values;
+    NSUInteger _nextIndex;
+    NSUInteger _running;
+    NSUInteger _completed;
+    id _error;
+    BOOL _failed;
+}
+
+- (id)initWithArray:(NSArray *)array concurrency:(NSUInteger)concurrency collectsValues:(BOOL)collectsValues block:(id (^)(id object))block {
+    self = [super init];
+    if (self) {
+        _array = [array copy];
+        _concurrency = MAX(concurrency, (NSUInteger)1);
+        _block = [block copy];
+        if (collectsValues) {
+            _values = [NSMutableArray arrayWithCapacity:_array.count];
+            for (NSUInteger i = 0; i < _array.count; i++) {
+                [_values addObject:[NSNull null]];
+            }
+        }
+    }
+    return self;
+}
+
+- (void)step {
+    NSUInteger count = _array.count;
+    pthread_mutex_lock(&_lock);
+    if (_finished) {
+        pthread_mutex_unlock(&_lock);
+        return;
+    }
+    BOOL stopped = self.deferred.promise.cancelled;
+    if (_failed || stopped || _completed == count) {
+        [self finish];
+        pthread_mutex_unlock(&_lock);
+        if (!stopped) {
+            // iterations still running after a failure no longer matter
+            [self settleWithValue:_failed ? _error : [_values copy] rejected:_failed];
+        }
+        return;
+    }
+    NSUInteger start = _nextIndex;
+    NSUInteger end = MIN(count, start + (_concurrency - _running));
+    _running += end - start;
+    _nextIndex = end;
+    pthread_mutex_unlock(&_lock);
+
+    for (NSUInteger i = start; i < end; i++) {
+        [self observeResult:_block(_array[i]) completion:^(id value, BOOL rejected) {
+            [self iteration:i finishedWithValue:value rejected:rejected];
+        }];
+    }
+}
+
+- (void)iteration:(NSUInteger)index finishedWithValue:(id)value rejected:(BOOL)rejected {
+    pthread_mutex_lock(&_lock);
+    _running--;
+    _completed++;
+    if (rejected && !_failed) {
+        _failed = YES;
+        _error = value;
+    } else if (!rejected && value) {
+        _values[index] = value;
+    }
+    pthread_mutex_unlock(&_lock);
+    [self schedule];
+}
+
+@end
+
+
+@interface KSPromiseRepeatLoop : KSPromiseLoop
+- (id)initWithCondition:(BOOL (^)(id value))condition initialValue:(id)initialValue body:(id (^)(id value))body;
+@end
+
+@implementation KSPromiseRepeatLoop {
+    BOOL (^_condition)(id value);
+    id (^_body)(id value);
+    id _value;
+    BOOL _rejected;
+    BOOL _running;
+}
+
+- (id)initWithCondition:(BOOL (^)(id value))condition initialValue:(id)initialValue body:(id (^)(id value))body {
+    self = [super init];
+    if (self) {
+        _condition = [condition copy];
+        _body = [body copy];
+        _value = initialValue;
+    }
+    return self;
+}
+
+- (void)step {
+    pthread_mutex_lock(&_lock);
+    if (_running || _finished) {
+        pthread_mutex_unlock(&_lock);
+        return;
+    }
+    id value = _value;
+    BOOL rejected = _rejected;
+    pthread_mutex_unlock(&_lock);
+
+    // no iteration is running, so nothing else touches the state until this step starts one
+    BOOL stopped = self.deferred.promise.cancelled;
+    BOOL done = rejected || stopped || !_condition(value);
+    pthread_mutex_lock(&_lock);
+    if (done) {
+        [self finish];
+    } else {
+        _running = YES;
+        // the loop holds the value only between iterations
+        _value = nil;
+    }
+    pthread_mutex_unlock(&_lock);
+
+    if (!done) {
+        [self observeResult:_body(value) completion:^(id next, BOOL nextRejected) {
+            pthread_mutex_lock(&self->_lock);
+            self->_value = next;
+            self->_rejected = nextRejected;
+            self->_running = NO;
+            pthread_mutex_unlock(&self->_lock);
+            [self schedule];
+        }];
+    } else if (!stopped) {
+        [self settleWithValue:value rejected:rejected];
+    }
+}
+
+@end
+
+
+@implementation KSPromise (Loops)
+
++ (KSPromise *)sequence:(NSArray *)factories {
+    KSPromiseForEachLoop *loop = [[KSPromiseForEachLoop alloc] initWithArray:factories concurrency:1 collectsValues:YES block:^id(id factory) {
+        return ((KSPromise *(^)(void))factory)();
+    }];
+    [loop schedule];
+    return loop.deferred.promise;
+}
+
++ (KSPromise *)repeatWhile:(BOOL (^)(id value))condition initialValue:(id)initialValue body:(id (^)(id value))body {
+    KSPromiseRepeatLoop *loop = [[KSPromiseRepeatLoop alloc] initWithCondition:condition initialValue:initialValue body:body];
+    [loop schedule];
+    return loop.deferred.promise;
+}
+
++ (KSPromise *)forEach:(NSArray *)array concurrency:(NSUInteger)concurrency block:(id (^)(id object))block {
+    KSPromiseForEachLoop *loop = [[KSPromiseForEachLoop alloc] initWithArray:array concurrency:concurrency collectsValues:NO block:block];
+    [loop schedule];
+    return loop.deferred.promise;
+}
+
+@end
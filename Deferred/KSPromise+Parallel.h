@@ -0,0 +1,26 @@
+#import "KSPromise.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface KSPromise KS_GENERIC(ObjectType) (Parallel)
+
+// Applies block to every element of array on the global concurrent queue,
+// chunkSize elements per task, and resolves with the results in order. A
+// chunkSize of 0 picks one based on the number of cores. nil results become
+// NSNull; returning an NSError rejects the promise and skips remaining chunks.
++ (KSPromise KS_GENERIC(NSArray *) *)parallelMap:(NSArray *)array
+                                       chunkSize:(NSUInteger)chunkSize
+                                           block:(__nullable id(^)(id object))block;
+
+// Folds each chunk with block starting from initialValue, then folds the
+// chunk results in order with combine. initialValue must be an identity for
+// combine (e.g. @0 for a sum). Returning an NSError from either block rejects.
++ (KSPromise *)parallelReduce:(NSArray *)array
+                    chunkSize:(NSUInteger)chunkSize
+                 initialValue:(nullable id)initialValue
+                        block:(__nullable id(^)(__nullable id accumulator, id object))block
+                      combine:(__nullable id(^)(__nullable id left, __nullable id right))combine;
+
+@end
+
+NS_ASSUME_NONNULL_END
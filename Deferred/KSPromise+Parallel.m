@@ -0,0 +1,141 @@
+#import "KSPromise+Parallel.h"
+#import "KSDeferred.h"
+#import <pthread.h>
+
+
+static NSUInteger KSParallelChunkSize(NSUInteger count, NSUInteger chunkSize) {
+    if (chunkSize > 0) {
+        return chunkSize;
+    }
+    NSUInteger tasks = [[NSProcessInfo processInfo] activeProcessorCount] * 4;
+    return MAX((count + tasks - 1) / tasks, (NSUInteger)1);
+}
+
+// Runs body once per chunk on the global queue and settles the returned
+// deferred with whatever finish returns. The first NSError returned by body
+// stops the remaining chunks and rejects. finish is always called so it can
+// release per-chunk state; completed is NO after an error or cancellation.
+static KSPromise *KSParallelChunks(NSArray *array,
+                                   NSUInteger chunkSize,
+                                   id (^body)(NSUInteger chunk, __unsafe_unretained id *objects, NSUInteger length),
+                                   id (^finish)(NSUInteger chunks, BOOL completed)) {
+    KSDeferred *deferred = [KSDeferred defer];
+    NSArray *objects = [array copy];
+    NSUInteger count = objects.count;
+    NSUInteger size = KSParallelChunkSize(count, chunkSize);
+    NSUInteger chunks = (count + size - 1) / size;
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        KSPromise *promise = deferred.promise;
+        __block BOOL failed = NO;
+        __block NSError *firstError = nil;
+        __block pthread_mutex_t errorLock = PTHREAD_MUTEX_INITIALIZER;
+
+        dispatch_apply(chunks, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t chunk) {
+            if (failed || promise.cancelled) {
+                return;
+            }
+            @autoreleasepool {
+                NSRange range = NSMakeRange(chunk * size, MIN(size, count - chunk * size));
+                __unsafe_unretained id *buffer = (__unsafe_unretained id *)malloc(range.length * sizeof(id));
+                [objects getObjects:buffer range:range];
+                id result = body(chunk, buffer, range.length);
+                free(buffer);
+                if ([result isKindOfClass:[NSError class]]) {
+                    pthread_mutex_lock(&errorLock);
+                    if (!firstError) {
+                        firstError = result;
+                    }
+                    failed = YES;
+                    pthread_mutex_unlock(&errorLock);
+                }
+            }
+        });
+
+        BOOL completed = !firstError && !promise.cancelled;
+        id value = finish(chunks, completed);
+        if (!completed) {
+            value = firstError;
+        }
+        if (promise.cancelled) {
+            return;
+        }
+        if ([value isKindOfClass:[NSError class]]) {
+            [deferred rejectWithError:value];
+        } else {
+            [deferred resolveWithValue:value];
+        }
+    });
+
+    return deferred.promise;
+}
+
+
+@implementation KSPromise (Parallel)
+
++ (KSPromise *)parallelMap:(NSArray *)array
+                 chunkSize:(NSUInteger)chunkSize
+                     block:(id (^)(id object))block {
+    NSUInteger count = array.count;
+    NSUInteger size = KSParallelChunkSize(count, chunkSize);
+    void **results = calloc(MAX(count, (NSUInteger)1), sizeof(void *));
+
+    return KSParallelChunks(array, size, ^id(NSUInteger chunk, __unsafe_unretained id *objects, NSUInteger length) {
+        void **chunkResults = results + chunk * size;
+        for (NSUInteger i = 0; i < length; i++) {
+            id result = block(objects[i]);
+            if ([result isKindOfClass:[NSError class]]) {
+                return result;
+            }
+            chunkResults[i] = (__bridge_retained void *)(result ? result : [NSNull null]);
+        }
+        return nil;
+    }, ^id(NSUInteger chunks, BOOL completed) {
+        NSArray *values = nil;
+        if (completed) {
+            values = [[NSArray alloc] initWithObjects:(__unsafe_unretained id *)results count:count];
+        }
+        for (NSUInteger i = 0; i < count; i++) {
+            if (results[i]) {
+                CFRelease(results[i]);
+            }
+        }
+        free(results);
+        return values;
+    });
+}
+
++ (KSPromise *)parallelReduce:(NSArray *)array
+                    chunkSize:(NSUInteger)chunkSize
+                 initialValue:(id)initialValue
+                        block:(id (^)(id accumulator, id object))block
+                      combine:(id (^)(id left, id right))combine {
+    NSUInteger count = array.count;
+    NSUInteger size = KSParallelChunkSize(count, chunkSize);
+    NSUInteger maximumChunks = (count + size - 1) / size;
+    void **accumulators = calloc(MAX(maximumChunks, (NSUInteger)1), sizeof(void *));
+
+    return KSParallelChunks(array, size, ^id(NSUInteger chunk, __unsafe_unretained id *objects, NSUInteger length) {
+        id accumulator = initialValue;
+        for (NSUInteger i = 0; i < length; i++) {
+            accumulator = block(accumulator, objects[i]);
+            if ([accumulator isKindOfClass:[NSError class]]) {
+                return accumulator;
+            }
+        }
+        accumulators[chunk] = (__bridge_retained void *)accumulator;
+        return nil;
+    }, ^id(NSUInteger chunks, BOOL completed) {
+        id result = initialValue;
+        for (NSUInteger i = 0; i < chunks; i++) {
+            id accumulator = (__bridge_transfer id)accumulators[i];
+            if (completed && ![result isKindOfClass:[NSError class]]) {
+                result = combine(result, accumulator);
+            }
+        }
+        free(accumulators);
+        return result;
+    });
+}
+
+@end
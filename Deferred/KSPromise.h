@@ -1,5 +1,6 @@
 #import <Foundation/Foundation.h>
 #import "KSCancellable.h"
+#import "KSExecutor.h"
 #import "KSNullabilityCompat.h"
 #import "KSGenericsCompat.h"
 
@@ -27,14 +28,20 @@ typedef void(^rejectType)(NSError * __nullable error);
 + (KSPromise *)promise:(void (^)(resolveType resolve, rejectType reject))promiseCallback;
 + (KSPromise *)resolve:(nullable KS_GENERIC_TYPE(ObjectType))value;
 + (KSPromise *)reject:(NSError *)error;
++ (KSPromise *)async:(__nullable id(^)(void))block onExecutor:(id<KSExecutor>)executor;
 
 + (KSPromise *)when:(NSArray *)promises;
 + (KSPromise *)all:(NSArray *)promises;
 
 - (KSPromise *)then:(nullable __nullable id(^)(__nullable KS_GENERIC_TYPE(ObjectType) value))fulfilledCallback error:(nullable promiseErrorCallback)errorCallback;
+- (KSPromise *)then:(nullable __nullable id(^)(__nullable KS_GENERIC_TYPE(ObjectType) value))fulfilledCallback error:(nullable promiseErrorCallback)errorCallback onExecutor:(nullable id<KSExecutor>)executor;
 - (KSPromise *)then:(__nullable id(^)(__nullable KS_GENERIC_TYPE(ObjectType) value))fulfilledCallback;
 - (KSPromise *)error:(promiseErrorCallback)errorCallback;
 - (KSPromise *)finally:(void(^)(void))callback;
+// Runs observer on the settling thread once the promise is fulfilled or
+// rejected, or immediately if it already is. Unlike finally: it allocates no
+// child promise; observers of a cancelled promise are never called.
+- (void)onSettled:(void(^)(KSPromise KS_GENERIC(ObjectType) *promise))observer;
 
 - (id)waitForValue;
 - (nullable id)waitForValueWithTimeout:(NSTimeInterval)timeout;
@@ -1,4 +1,13 @@
 #import "KSPromise.h"
+#import "KSTrace.h"
+#import "KSProbes.h"
+#import "KSMetrics.h"
+#import "KSClock.h"
+#import "KSCreationSites.h"
+#import "KSSlowCallbacks.h"
+#import "KSPromiseBatch.h"
+#import "KSPromiseEnd.h"
+#import <pthread.h>
 
 
 #if OS_OBJECT_USE_OBJC_RETAIN_RELEASE == 0
@@ -18,10 +27,29 @@
 @property (copy, nonatomic) deferredCallback deprecatedCompleteCallback;
 
 @property (strong, nonatomic) KSPromise *childPromise;
+@property (strong, nonatomic) id<KSExecutor> executor;
 
 @end
 
 
+typedef void (^KSPromiseObserver)(KSPromise *promise);
+
+
+// Continuations queued while a batch is open, as alternating promise and
+// KSPromiseCallbacks entries per executor, in the order the executors appeared.
+// Inline entries may also be observer blocks.
+@interface KSPromiseBatch : NSObject
+@property (strong, nonatomic) NSMutableArray *executors;
+@property (strong, nonatomic) NSMapTable *executorEntries;
+@property (strong, nonatomic) NSMutableArray *inlineEntries;
+@end
+
+@implementation KSPromiseBatch
+@end
+
+static __thread void *ks_batch;
+
+
 NSString *const KSPromiseWhenErrorDomain = @"KSPromiseJoinError";
 NSString *const KSPromiseWhenErrorErrorsKey = @"KSPromiseWhenErrorErrorsKey";
 NSString *const KSPromiseWhenErrorValuesKey = @"KSPromiseWhenErrorValuesKey";
@@ -46,6 +74,12 @@ NSString *const KSPromiseWhenErrorValuesKey = @"KSPromiseWhenErrorValuesKey";
 
 @interface KSPromise () <KSCancellable> {
     dispatch_semaphore_t _sem;
+    pthread_mutex_t _lock;
+    uint64_t _traceIdentifier;
+    uint64_t _probeCreatedAt;
+    KSMetricsRecord *_metrics;
+    uint32_t _creationSite;
+    uint32_t _registrationSite;
 }
 
 @property (strong, nonatomic) NSMutableArray *callbacks;
@@ -60,22 +94,58 @@ NSString *const KSPromiseWhenErrorValuesKey = @"KSPromiseWhenErrorValuesKey";
 
 @property (strong, nonatomic) NSHashTable *cancellables;
 
+- (void)runCallbacks:(KSPromiseCallbacks *)callbacks;
+
 @end
 
 @implementation KSPromise
 
+// Deprecated callbacks have no child promise.
+static inline uint64_t KSPromiseTraceIdentifier(KSPromise *promise) {
+    return promise ? promise->_traceIdentifier : 0;
+}
+
+uint64_t KSTraceIdentifierForPromise(KSPromise *promise) {
+    return KSPromiseTraceIdentifier(promise);
+}
+
+uint32_t KSCreationSiteOfPromise(KSPromise *promise) {
+    return promise ? promise->_creationSite : 0;
+}
+
+uint32_t KSRegistrationSiteOfPromise(KSPromise *promise) {
+    return promise ? promise->_registrationSite : 0;
+}
+
 - (id)init {
     self = [super init];
     if (self) {
         self.callbacks = [NSMutableArray array];
         self.cancellables = [NSHashTable weakObjectsHashTable];
         _sem = dispatch_semaphore_create(0);
+        pthread_mutex_init(&_lock, NULL);
+        _creationSite = KSCreationSiteSample();
+        if (KS_TRACE_ENABLED()) {
+            _traceIdentifier = KSTraceNextIdentifier();
+            KS_TRACE_STACK(KSTraceEventCreate, _traceIdentifier, 0, _creationSite);
+        }
+        if (KS_PROBE_ENABLED(resolve) || KS_PROBE_ENABLED(reject)) {
+            _probeCreatedAt = KSClockNow();
+        }
+        KS_PROBE1(create, (__bridge void *)self);
+        if (KS_METRICS_ENABLED()) {
+            _metrics = KSMetricsPromiseCreated((__bridge void *)self, _creationSite);
+        }
     }
     return self;
 }
 
 - (void)dealloc {
+    if (_metrics) {
+        KSMetricsPromiseDeallocated(_metrics, ![self completed]);
+    }
     KS_DISPATCH_RELEASE(_sem);
+    pthread_mutex_destroy(&_lock);
 }
 
 + (KSPromise *)promise:(void (^)(resolveType resolve, rejectType reject))promiseCallback {
@@ -104,6 +174,16 @@ NSString *const KSPromiseWhenErrorValuesKey = @"KSPromiseWhenErrorValuesKey";
     return promise;
 }
 
++ (KSPromise *)async:(id (^)(void))block onExecutor:(id<KSExecutor>)executor {
+    KSPromise *promise = [[KSPromise alloc] init];
+    [executor execute:^{
+        if (!promise.cancelled) {
+            [promise resolvePromise:promise withValue:block()];
+        }
+    }];
+    return promise;
+}
+
 + (KSPromise *)when:(NSArray *)promises {
     KSPromise *promise = [[KSPromise alloc] init];
     promise.parentPromises = promises;
@@ -113,11 +193,12 @@ NSString *const KSPromiseWhenErrorValuesKey = @"KSPromiseWhenErrorValuesKey";
     }
     else {
         for (KSPromise *joinedPromise in promises) {
-            for (id<KSCancellable> cancellable in joinedPromise.cancellables) {
+            for (id<KSCancellable> cancellable in [joinedPromise allCancellables]) {
                 [promise addCancellable:cancellable];
             }
-            [joinedPromise finally:^ {
-                [promise joinedPromiseFulfilled:joinedPromise];
+            KS_TRACE(KSTraceEventWhenParent, promise->_traceIdentifier, KSPromiseTraceIdentifier(joinedPromise));
+            [joinedPromise onSettled:^(KSPromise *settled) {
+                [promise joinedPromiseFulfilled:settled];
             }];
         }
     }
@@ -134,30 +215,34 @@ NSString *const KSPromiseWhenErrorValuesKey = @"KSPromiseWhenErrorValuesKey";
 
 - (KSPromise *)then:(promiseValueCallback)fulfilledCallback
               error:(promiseErrorCallback)errorCallback {
-    if (![self completed]) {
-        KSPromiseCallbacks *callbacks = [[KSPromiseCallbacks alloc] initWithFulfilledCallback:fulfilledCallback
-                                                                                errorCallback:errorCallback
-                                                                                  cancellable:self];
+    return [self then:fulfilledCallback error:errorCallback onExecutor:nil];
+}
+
+- (KSPromise *)then:(promiseValueCallback)fulfilledCallback
+              error:(promiseErrorCallback)errorCallback
+         onExecutor:(id<KSExecutor>)executor {
+    uint32_t registrationSite = KSCreationSiteSample();
+    KSPromiseCallbacks *callbacks = [[KSPromiseCallbacks alloc] initWithFulfilledCallback:fulfilledCallback
+                                                                            errorCallback:errorCallback
+                                                                              cancellable:self];
+    callbacks.executor = executor;
+    callbacks.childPromise->_registrationSite = registrationSite;
+    KS_TRACE_STACK(KSTraceEventThen, _traceIdentifier, KSPromiseTraceIdentifier(callbacks.childPromise), registrationSite);
+
+    pthread_mutex_lock(&_lock);
+    BOOL completed = [self completed];
+    if (!completed) {
         [self.callbacks addObject:callbacks];
-        return callbacks.childPromise;
     }
+    if (_metrics) {
+        KSMetricsContinuationQueued(_metrics, !completed);
+    }
+    pthread_mutex_unlock(&_lock);
 
-    id nextValue;
-    if (self.fulfilled) {
-        nextValue = self.value;
-        if (fulfilledCallback) {
-           nextValue = fulfilledCallback(self.value);
-        }
-    } else if (self.rejected) {
-        nextValue = self.error;
-        if (errorCallback) {
-            nextValue = errorCallback(self.error);
-        }
+    if (completed) {
+        [self dispatchCallbacks:callbacks];
     }
-    KSPromise *promise = [[KSPromise alloc] init];
-    [promise addCancellable:self];
-    [self resolvePromise:promise withValue:nextValue];
-    return promise;
+    return callbacks.childPromise;
 }
 
 - (KSPromise *)then:(promiseValueCallback)fulfilledCallback {
@@ -178,21 +263,50 @@ NSString *const KSPromiseWhenErrorValuesKey = @"KSPromiseWhenErrorValuesKey";
     }];
 }
 
+// Observers share the callbacks array so they run in registration order,
+// but have no KSPromiseCallbacks or child promise of their own.
+- (void)onSettled:(void (^)(KSPromise *promise))observer {
+    pthread_mutex_lock(&_lock);
+    BOOL completed = [self completed];
+    if (!completed) {
+        [self.callbacks addObject:[observer copy]];
+    }
+    pthread_mutex_unlock(&_lock);
+
+    if (completed) {
+        [self notifyObserver:observer];
+    }
+}
+
 - (void)addCancellable:(id<KSCancellable>)cancellable
 {
-    if (self.cancelled) {
-        [cancellable cancel];
-    } else {
+    pthread_mutex_lock(&_lock);
+    BOOL cancelled = self.cancelled;
+    if (!cancelled) {
         [self.cancellables addObject:cancellable];
     }
+    pthread_mutex_unlock(&_lock);
+
+    if (cancelled) {
+        [cancellable cancel];
+    }
 }
 
 - (void)cancel {
+    pthread_mutex_lock(&_lock);
     self.cancelled = YES;
-    for (id<KSCancellable> cancellable in self.cancellables) {
+    NSArray *cancellables = [self.cancellables allObjects];
+    [self.callbacks removeAllObjects];
+    if (_metrics) {
+        KSMetricsPromiseCancelled(_metrics);
+    }
+    pthread_mutex_unlock(&_lock);
+    KS_TRACE(KSTraceEventCancel, _traceIdentifier, 0);
+    KS_PROBE1(cancel, (__bridge void *)self);
+
+    for (id<KSCancellable> cancellable in cancellables) {
         [cancellable cancel];
     }
-    [self.callbacks removeAllObjects];
 }
 
 - (id)waitForValue {
@@ -201,8 +315,15 @@ NSString *const KSPromiseWhenErrorValuesKey = @"KSPromiseWhenErrorValuesKey";
 
 - (id)waitForValueWithTimeout:(NSTimeInterval)timeout {
     if (![self completed]) {
+        uint64_t waitStart = KS_PROBE_ENABLED(wait_end) ? KSClockNow() : 0;
+        KS_PROBE2(wait_begin, (__bridge void *)self, (uint64_t)(timeout * NSEC_PER_SEC));
         dispatch_time_t time = timeout == 0 ? DISPATCH_TIME_FOREVER : dispatch_time(DISPATCH_TIME_NOW, timeout * NSEC_PER_SEC);
-        dispatch_semaphore_wait(_sem, time);
+        BOOL timedOut = dispatch_semaphore_wait(_sem, time) != 0;
+        if (!timedOut) {
+            // pass the signal on to any other thread waiting on this promise
+            dispatch_semaphore_signal(_sem);
+        }
+        KS_PROBE3(wait_end, (__bridge void *)self, KSProbeElapsed(waitStart), (int)timedOut);
     }
     if (self.fulfilled) {
         return self.value;
@@ -215,49 +336,139 @@ NSString *const KSPromiseWhenErrorValuesKey = @"KSPromiseWhenErrorValuesKey";
 #pragma mark - Resolving and Rejecting
 
 - (void)resolveWithValue:(id)value {
-    NSAssert(!self.completed, @"A fulfilled promise can not be resolved again.");
-    if (self.completed || self.cancelled) return;
-    self.value = value;
-    self.fulfilled = YES;
-    for (__strong KSPromiseCallbacks *callbacks in self.callbacks) {
-        id nextValue = self.value;
-        if (callbacks.fulfilledCallback) {
-            nextValue = callbacks.fulfilledCallback(value);
-        } else if (callbacks.deprecatedFulfilledCallback) {
-            callbacks.deprecatedFulfilledCallback(self);
+    BOOL wasCompleted = [self settleWithValue:value error:nil rejected:NO];
+    NSAssert(!wasCompleted, @"A fulfilled promise can not be resolved again.");
+}
+
+- (void)rejectWithError:(NSError *)error {
+    BOOL wasCompleted = [self settleWithValue:nil error:error rejected:YES];
+    NSAssert(!wasCompleted, @"A fulfilled promise can not be rejected again.");
+}
+
+// Returns YES if the promise had already been fulfilled or rejected.
+- (BOOL)settleWithValue:(id)value error:(NSError *)error rejected:(BOOL)rejected {
+    pthread_mutex_lock(&_lock);
+    BOOL wasCompleted = [self completed];
+    if (wasCompleted || self.cancelled) {
+        pthread_mutex_unlock(&_lock);
+        return wasCompleted;
+    }
+    if (rejected) {
+        self.error = error;
+        self.rejected = YES;
+    } else {
+        self.value = value;
+        self.fulfilled = YES;
+    }
+    NSArray *callbacks = self.callbacks;
+    self.callbacks = nil;
+    if (_metrics) {
+        KSMetricsPromiseSettled(_metrics);
+    }
+    pthread_mutex_unlock(&_lock);
+    KS_TRACE(rejected ? KSTraceEventReject : KSTraceEventResolve, _traceIdentifier, 0);
+    if (rejected) {
+        KS_PROBE2(reject, (__bridge void *)self, KSProbeElapsed(_probeCreatedAt));
+    } else {
+        KS_PROBE2(resolve, (__bridge void *)self, KSProbeElapsed(_probeCreatedAt));
+    }
+
+    for (__strong KSPromiseCallbacks *callbacks in callbacks) {
+        if (![callbacks isKindOfClass:[KSPromiseCallbacks class]]) {
+            [self notifyObserver:(KSPromiseObserver)callbacks];
+            continue;
+        }
+        if (rejected) {
+            if (!callbacks.errorCallback && callbacks.deprecatedErrorCallback) {
+                [self notifyObserver:(KSPromiseObserver)callbacks.deprecatedErrorCallback];
+                continue;
+            }
+        } else if (!callbacks.fulfilledCallback && callbacks.deprecatedFulfilledCallback) {
+            [self notifyObserver:(KSPromiseObserver)callbacks.deprecatedFulfilledCallback];
             continue;
         }
-        [self resolvePromise:callbacks.childPromise withValue:nextValue];
+        [self dispatchCallbacks:callbacks];
     }
-    [self finish];
+    [self finish:callbacks];
+    return NO;
 }
 
-- (void)rejectWithError:(NSError *)error {
-    NSAssert(!self.completed, @"A fulfilled promise can not be rejected again.");
-    if (self.completed || self.cancelled) return;
-    self.error = error;
-    self.rejected = YES;
-    for (__strong KSPromiseCallbacks *callbacks in self.callbacks) {
-        id nextValue = self.error;
+// Observers and deprecated callbacks are queued with the inline continuations
+// while a batch is open, so they keep their place in registration order.
+- (void)notifyObserver:(KSPromiseObserver)observer {
+    if (ks_batch) {
+        KSPromiseBatch *batch = (__bridge KSPromiseBatch *)ks_batch;
+        [batch.inlineEntries addObject:self];
+        [batch.inlineEntries addObject:observer];
+        return;
+    }
+    observer(self);
+}
+
+- (void)dispatchCallbacks:(KSPromiseCallbacks *)callbacks {
+    if (ks_batch) {
+        KSPromiseBatch *batch = (__bridge KSPromiseBatch *)ks_batch;
+        NSMutableArray *entries = batch.inlineEntries;
+        if (callbacks.executor) {
+            entries = [batch.executorEntries objectForKey:callbacks.executor];
+            if (!entries) {
+                entries = [NSMutableArray array];
+                [batch.executorEntries setObject:entries forKey:callbacks.executor];
+                [batch.executors addObject:callbacks.executor];
+            }
+        }
+        [entries addObject:self];
+        [entries addObject:callbacks];
+        return;
+    }
+    if (callbacks.executor) {
+        [callbacks.executor execute:^{
+            [self runCallbacks:callbacks];
+        }];
+    } else {
+        [self runCallbacks:callbacks];
+    }
+}
+
+- (void)runCallbacks:(KSPromiseCallbacks *)callbacks {
+    KS_TRACE(KSTraceEventCallbackBegin, _traceIdentifier, KSPromiseTraceIdentifier(callbacks.childPromise));
+    uint64_t callbackStart = KS_PROBE_ENABLED(callback_run) || (_metrics && callbacks.childPromise) ? KSClockNow() : 0;
+    KSSlowCallbackFrame slowCallback = {0};
+    if (KS_SLOW_CALLBACKS_ENABLED()) {
+        KSSlowCallbackBegin(&slowCallback, self.fulfilled ? callbacks.fulfilledCallback : callbacks.errorCallback);
+    }
+    id nextValue;
+    if (self.fulfilled) {
+        nextValue = self.value;
+        if (callbacks.fulfilledCallback) {
+            nextValue = callbacks.fulfilledCallback(nextValue);
+        }
+    } else {
+        nextValue = self.error;
         if (callbacks.errorCallback) {
-            nextValue = callbacks.errorCallback(error);
-        } else if (callbacks.deprecatedErrorCallback) {
-            callbacks.deprecatedErrorCallback(self);
-            continue;
+            nextValue = callbacks.errorCallback(nextValue);
         }
-        [self resolvePromise:callbacks.childPromise withValue:nextValue];
     }
-    [self finish];
+    if (slowCallback.start) {
+        KSSlowCallbackEnd(&slowCallback);
+    }
+    KS_TRACE(KSTraceEventCallbackEnd, _traceIdentifier, KSPromiseTraceIdentifier(callbacks.childPromise));
+    if (_metrics && callbacks.childPromise) {
+        KSMetricsContinuationRan(_metrics, callbackStart);
+    }
+    KS_PROBE3(callback_run, (__bridge void *)self, (__bridge void *)callbacks.childPromise, KSProbeElapsed(callbackStart));
+    [self resolvePromise:callbacks.childPromise withValue:nextValue];
 }
 
 - (void)resolvePromise:(KSPromise *)promise withValue:(id)value {
     if ([value isKindOfClass:[KSPromise class]]) {
-        [value then:^id(id value) {
-            [promise resolveWithValue:value];
-            return value;
-        } error:^id(NSError *error) {
-            [promise rejectWithError:error];
-            return error;
+        KS_TRACE(KSTraceEventAdopt, KSPromiseTraceIdentifier(promise), KSPromiseTraceIdentifier(value));
+        [value onSettled:^(KSPromise *settled) {
+            id value;
+            NSError *error;
+            BOOL rejected;
+            [settled getValue:&value error:&error rejected:&rejected];
+            [promise settleWithValue:value error:error rejected:rejected];
         }];
     } else if ([value isKindOfClass:[NSError class]]) {
         [promise rejectWithError:value];
@@ -266,13 +477,12 @@ NSString *const KSPromiseWhenErrorValuesKey = @"KSPromiseWhenErrorValuesKey";
     }
 }
 
-- (void)finish {
-    for (__strong KSPromiseCallbacks *callbacks in self.callbacks) {
-        if (callbacks.deprecatedCompleteCallback) {
-            callbacks.deprecatedCompleteCallback(self);
+- (void)finish:(NSArray *)callbacks {
+    for (__strong KSPromiseCallbacks *callbacks in callbacks) {
+        if ([callbacks isKindOfClass:[KSPromiseCallbacks class]] && callbacks.deprecatedCompleteCallback) {
+            [self notifyObserver:(KSPromiseObserver)callbacks.deprecatedCompleteCallback];
         }
     }
-    [self.callbacks removeAllObjects];
     dispatch_semaphore_signal(_sem);
 }
 
@@ -282,52 +492,77 @@ NSString *const KSPromiseWhenErrorValuesKey = @"KSPromiseWhenErrorValuesKey";
 
 #pragma mark - Deprecated methods
 - (void)whenResolved:(deferredCallback)callback {
-    if (self.fulfilled) {
+    KSPromiseCallbacks *callbacks = [[KSPromiseCallbacks alloc] init];
+    callbacks.deprecatedFulfilledCallback = callback;
+    if (![self addDeprecatedCallbacks:callbacks] && self.fulfilled) {
         callback(self);
-    } else if (!self.cancelled) {
-        KSPromiseCallbacks *callbacks = [[KSPromiseCallbacks alloc] init];
-        callbacks.deprecatedFulfilledCallback = callback;
-        [self.callbacks addObject:callbacks];
     }
 }
 
 - (void)whenRejected:(deferredCallback)callback {
-    if (self.rejected) {
+    KSPromiseCallbacks *callbacks = [[KSPromiseCallbacks alloc] init];
+    callbacks.deprecatedErrorCallback = callback;
+    if (![self addDeprecatedCallbacks:callbacks] && self.rejected) {
         callback(self);
-    } else if (!self.cancelled) {
-        KSPromiseCallbacks *callbacks = [[KSPromiseCallbacks alloc] init];
-        callbacks.deprecatedErrorCallback = callback;
-        [self.callbacks addObject:callbacks];
     }
 }
 
 - (void)whenFulfilled:(deferredCallback)callback {
-    if ([self completed]) {
+    KSPromiseCallbacks *callbacks = [[KSPromiseCallbacks alloc] init];
+    callbacks.deprecatedCompleteCallback = callback;
+    if (![self addDeprecatedCallbacks:callbacks] && [self completed]) {
         callback(self);
-    } else if (!self.cancelled) {
-        KSPromiseCallbacks *callbacks = [[KSPromiseCallbacks alloc] init];
-        callbacks.deprecatedCompleteCallback = callback;
-        [self.callbacks addObject:callbacks];
     }
 }
 
 #pragma mark - Private methods
+// Returns NO if the promise has already been fulfilled, rejected or cancelled.
+- (BOOL)addDeprecatedCallbacks:(KSPromiseCallbacks *)callbacks {
+    pthread_mutex_lock(&_lock);
+    BOOL pending = ![self completed] && !self.cancelled;
+    if (pending) {
+        [self.callbacks addObject:callbacks];
+    }
+    pthread_mutex_unlock(&_lock);
+    return pending;
+}
+
+- (NSArray *)allCancellables {
+    pthread_mutex_lock(&_lock);
+    NSArray *cancellables = [self.cancellables allObjects];
+    pthread_mutex_unlock(&_lock);
+    return cancellables;
+}
+
+// Returns NO while the promise is still pending.
+- (BOOL)getValue:(id *)value error:(NSError **)error rejected:(BOOL *)rejected {
+    pthread_mutex_lock(&_lock);
+    BOOL completed = [self completed];
+    *value = self.value;
+    *error = self.error;
+    *rejected = self.rejected;
+    pthread_mutex_unlock(&_lock);
+    return completed;
+}
+
 - (void)joinedPromiseFulfilled:(KSPromise *)promise {
     if ([self completed]) {
         return;
     }
-    
+
     BOOL fulfilled = YES;
     NSMutableArray *errors = [NSMutableArray array];
     NSMutableArray *values = [NSMutableArray array];
     for (KSPromise *joinedPromise in self.parentPromises) {
-        fulfilled = fulfilled && joinedPromise.completed;
-        if (joinedPromise.rejected) {
-            id error = joinedPromise.error ? joinedPromise.error : [NSNull null];
-            [errors addObject:error];
-        } else if (joinedPromise.fulfilled) {
-            id value = joinedPromise.value ? joinedPromise.value : [NSNull null];
-            [values addObject:value];
+        id value;
+        NSError *error;
+        BOOL rejected;
+        if (![joinedPromise getValue:&value error:&error rejected:&rejected]) {
+            fulfilled = NO;
+        } else if (rejected) {
+            [errors addObject:error ? error : [NSNull null]];
+        } else {
+            [values addObject:value ? value : [NSNull null]];
         }
     }
     if (fulfilled) {
@@ -337,11 +572,89 @@ NSString *const KSPromiseWhenErrorValuesKey = @"KSPromiseWhenErrorValuesKey";
             NSError *whenError = [NSError errorWithDomain:KSPromiseWhenErrorDomain
                                                      code:1
                                                  userInfo:userInfo];
-            [self rejectWithError:whenError];
+            [self settleWithValue:nil error:whenError rejected:YES];
         } else {
-            [self resolveWithValue:values];
+            [self settleWithValue:values error:nil rejected:NO];
         }
     }
 }
 
 @end
+
+
+BOOL KSPromiseBatchOpen(void) {
+    if (ks_batch) {
+        return NO;
+    }
+    KSPromiseBatch *batch = [[KSPromiseBatch alloc] init];
+    batch.executors = [NSMutableArray array];
+    batch.executorEntries = [NSMapTable strongToStrongObjectsMapTable];
+    batch.inlineEntries = [NSMutableArray array];
+    ks_batch = (__bridge_retained void *)batch;
+    return YES;
+}
+
+// Continuations that settle further promises while the batch is flushed run
+// as they would outside a batch.
+void KSPromiseBatchClose(void) {
+    KSPromiseBatch *batch = (__bridge_transfer KSPromiseBatch *)ks_batch;
+    ks_batch = NULL;
+
+    for (id<KSExecutor> executor in batch.executors) {
+        NSArray *entries = [batch.executorEntries objectForKey:executor];
+        [executor execute:^{
+            for (NSUInteger i = 0; i < entries.count; i += 2) {
+                [entries[i] runCallbacks:entries[i + 1]];
+            }
+        }];
+    }
+    NSArray *entries = batch.inlineEntries;
+    for (NSUInteger i = 0; i < entries.count; i += 2) {
+        id entry = entries[i + 1];
+        if ([entry isKindOfClass:[KSPromiseCallbacks class]]) {
+            [entries[i] runCallbacks:entry];
+        } else {
+            ((KSPromiseObserver)entry)(entries[i]);
+        }
+    }
+}
+
+
+// Added to the promise's cancellables, which are weak; the onSettled:
+// observer keeps it alive until the promise settles, and cancel takes its
+// own strong copy of the cancellables before dropping the observers.
+@interface KSPromiseEndObserver : NSObject<KSCancellable> {
+    atomic_flag _called;
+}
+@property (weak, nonatomic) KSPromise *promise;
+@property (copy, nonatomic) KSPromiseObserver observer;
+@end
+
+@implementation KSPromiseEndObserver
+
+- (void)promiseEnded:(KSPromise *)promise {
+    if (!atomic_flag_test_and_set(&_called)) {
+        KSPromiseObserver observer = self.observer;
+        self.observer = nil;
+        observer(promise);
+    }
+}
+
+- (void)cancel {
+    KSPromise *promise = self.promise;
+    if (promise) {
+        [self promiseEnded:promise];
+    }
+}
+
+@end
+
+void KSPromiseOnEnd(KSPromise *promise, void (^observer)(KSPromise *promise)) {
+    KSPromiseEndObserver *endObserver = [[KSPromiseEndObserver alloc] init];
+    endObserver.promise = promise;
+    endObserver.observer = observer;
+    [promise onSettled:^(KSPromise *settled) {
+        [endObserver promiseEnded:settled];
+    }];
+    [promise addCancellable:endObserver];
+}
@@ -0,0 +1,10 @@
+#import <Foundation/Foundation.h>
+
+// Lets KSDeferred batch the continuations of promises it settles. While a
+// batch is open on a thread, continuations that would run or be dispatched
+// are queued instead; closing the batch hands each executor its queued
+// continuations in one execute: and then runs the inline ones in order.
+
+// Returns NO, and opens nothing, if a batch is already open on this thread.
+BOOL KSPromiseBatchOpen(void);
+void KSPromiseBatchClose(void);
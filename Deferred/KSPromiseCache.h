@@ -0,0 +1,52 @@
+#import <Foundation/Foundation.h>
+#import "KSPromise.h"
+#import "KSNullabilityCompat.h"
+#import "KSGenericsCompat.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Caches the promises a loader returns by key. Lookups for a key that is
+// still loading share its load, so a key is loaded once however many callers
+// ask for it at the same time. Each lookup returns its own promise: cancelling
+// one leaves the other callers waiting, and the load is cancelled and dropped
+// once every caller waiting on it has cancelled.
+//
+// Keys are spread over stripes that each have their own lock and least
+// recently used list, so lookups on different keys rarely contend. byteBudget
+// applies to the whole cache: going over it evicts the least recently used
+// values across all stripes until the total fits again. Pending
+// promises are never evicted. Settled ones are all dropped when the process
+// gets a memory pressure warning.
+//
+// Set the properties before the first lookup.
+@interface KSPromiseCache : NSObject
+
+// How long a fulfilled promise stays cached after it settles. 0, the default,
+// keeps it until it is evicted.
+@property (nonatomic) NSTimeInterval timeToLive;
+// How long a rejected promise stays cached after it settles. 0, the default,
+// drops it straight away so the next lookup loads again.
+@property (nonatomic) NSTimeInterval failureTimeToLive;
+// The total cost of fulfilled promises the cache may hold. 0, the default,
+// means no limit.
+@property (nonatomic) NSUInteger byteBudget;
+// The cost of a value towards byteBudget. Without it NSData values cost their
+// length and everything else costs nothing.
+@property (copy, nonatomic, nullable) NSUInteger (^costBlock)(id value);
+
+@property (nonatomic, readonly) NSUInteger count;
+@property (nonatomic, readonly) NSUInteger totalCost;
+
+// The cached promise for key, or the one loader returns, which is cached.
+- (KSPromise *)promiseForKey:(id<NSCopying>)key loader:(KSPromise *(^)(void))loader;
+// The cached promise for key, without loading it.
+- (nullable KSPromise *)cachedPromiseForKey:(id<NSCopying>)key;
+
+- (void)removePromiseForKey:(id<NSCopying>)key;
+- (void)removeAllPromises;
+// Drops every settled promise, as a memory pressure warning does.
+- (void)evictSettledPromises;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,407 @@
+#import "KSPromiseCache.h"
+#import "KSDeferred.h"
+#import "KSClock.h"
+#import <pthread.h>
+#import <stdatomic.h>
+
+#define KS_PROMISE_CACHE_STRIPES 16
+
+
+@interface KSPromiseCacheEntry : NSObject {
+@public
+    id<NSCopying> _key;
+    // shared by every caller; each gets its own promise that follows it
+    KSPromise *_promise;
+    // the callers still waiting on a pending entry, by their deferreds
+    NSHashTable *_callers;
+    // in nanoseconds; 0 if the entry is pending or doesn't expire
+    uint64_t _expiry;
+    NSUInteger _cost;
+    // the cache's access tick when the entry was last used
+    uint64_t _lastUsed;
+    BOOL _settled;
+    // the stripe's list of settled entries; the dictionary owns them
+    __unsafe_unretained KSPromiseCacheEntry *_previous;
+    __unsafe_unretained KSPromiseCacheEntry *_next;
+}
+@end
+
+@implementation KSPromiseCacheEntry
+@end
+
+
+@interface KSPromiseCacheStripe : NSObject {
+@public
+    pthread_mutex_t _lock;
+    NSMutableDictionary *_entries;
+    // settled entries, most recently used first
+    __unsafe_unretained KSPromiseCacheEntry *_head;
+    __unsafe_unretained KSPromiseCacheEntry *_tail;
+    NSUInteger _cost;
+    // the cache's total cost, which the budget applies to, and its access
+    // tick, which orders uses across stripes
+    _Atomic(NSUInteger) *_totalCost;
+    _Atomic(uint64_t) *_tick;
+}
+@end
+
+@implementation KSPromiseCacheStripe
+
+- (id)init {
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_lock, NULL);
+        _entries = [NSMutableDictionary dictionary];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    pthread_mutex_destroy(&_lock);
+}
+
+@end
+
+
+// The functions below are called with the stripe's lock held.
+
+static void KSPromiseCacheUnlink(KSPromiseCacheStripe *stripe, KSPromiseCacheEntry *entry) {
+    if (entry->_previous) {
+        entry->_previous->_next = entry->_next;
+    } else {
+        stripe->_head = entry->_next;
+    }
+    if (entry->_next) {
+        entry->_next->_previous = entry->_previous;
+    } else {
+        stripe->_tail = entry->_previous;
+    }
+    entry->_previous = nil;
+    entry->_next = nil;
+}
+
+static void KSPromiseCachePushFront(KSPromiseCacheStripe *stripe, KSPromiseCacheEntry *entry) {
+    entry->_next = stripe->_head;
+    if (stripe->_head) {
+        stripe->_head->_previous = entry;
+    } else {
+        stripe->_tail = entry;
+    }
+    stripe->_head = entry;
+}
+
+static void KSPromiseCacheRemove(KSPromiseCacheStripe *stripe, KSPromiseCacheEntry *entry) {
+    if (entry->_settled) {
+        KSPromiseCacheUnlink(stripe, entry);
+        stripe->_cost -= entry->_cost;
+        atomic_fetch_sub(stripe->_totalCost, entry->_cost);
+    }
+    [stripe->_entries removeObjectForKey:entry->_key];
+}
+
+// Marks a settled entry as the most recently used in the whole cache.
+static void KSPromiseCacheTouch(KSPromiseCacheStripe *stripe, KSPromiseCacheEntry *entry) {
+    entry->_lastUsed = atomic_fetch_add_explicit(stripe->_tick, 1, memory_order_relaxed) + 1;
+    if (stripe->_head != entry) {
+        KSPromiseCacheUnlink(stripe, entry);
+        KSPromiseCachePushFront(stripe, entry);
+    }
+}
+
+// Drops the entry for key if it has expired or its promise was cancelled, and
+// marks a settled one as most recently used.
+static KSPromiseCacheEntry *KSPromiseCacheLookup(KSPromiseCacheStripe *stripe, id<NSCopying> key) {
+    KSPromiseCacheEntry *entry = stripe->_entries[key];
+    if (!entry) {
+        return nil;
+    }
+    if (entry->_promise.cancelled || (entry->_expiry && KSClockNow() >= entry->_expiry)) {
+        KSPromiseCacheRemove(stripe, entry);
+        return nil;
+    }
+    if (entry->_settled) {
+        KSPromiseCacheTouch(stripe, entry);
+    }
+    return entry;
+}
+
+
+@interface KSPromiseCache () {
+    KSPromiseCacheStripe *_stripes[KS_PROMISE_CACHE_STRIPES];
+    _Atomic(NSUInteger) _totalCost;
+    _Atomic(uint64_t) _tick;
+}
+@property (strong, nonatomic) dispatch_source_t memoryPressureSource;
+@end
+
+@implementation KSPromiseCache
+
+- (id)init {
+    self = [super init];
+    if (self) {
+        for (NSUInteger i = 0; i < KS_PROMISE_CACHE_STRIPES; i++) {
+            _stripes[i] = [[KSPromiseCacheStripe alloc] init];
+            _stripes[i]->_totalCost = &_totalCost;
+            _stripes[i]->_tick = &_tick;
+        }
+#if defined(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE)
+        self.memoryPressureSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+                                                           DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL,
+                                                           dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+        __weak KSPromiseCache *weakSelf = self;
+        dispatch_source_set_event_handler(self.memoryPressureSource, ^{
+            [weakSelf evictSettledPromises];
+        });
+        dispatch_resume(self.memoryPressureSource);
+#endif
+    }
+    return self;
+}
+
+- (void)dealloc {
+    if (_memoryPressureSource) {
+        dispatch_source_cancel(_memoryPressureSource);
+    }
+}
+
+- (KSPromise *)promiseForKey:(id<NSCopying>)key loader:(KSPromise *(^)(void))loader {
+    KSPromiseCacheStripe *stripe = [self stripeForKey:key];
+    KSDeferred *deferred = nil;
+    KSDeferred *caller = nil;
+
+    pthread_mutex_lock(&stripe->_lock);
+    KSPromiseCacheEntry *entry = KSPromiseCacheLookup(stripe, key);
+    if (!entry) {
+        deferred = [KSDeferred defer];
+        entry = [[KSPromiseCacheEntry alloc] init];
+        entry->_key = key;
+        entry->_promise = deferred.promise;
+        entry->_callers = [NSHashTable weakObjectsHashTable];
+        stripe->_entries[key] = entry;
+    }
+    if (!entry->_settled) {
+        caller = [KSDeferred defer];
+        [entry->_callers addObject:caller];
+    }
+    pthread_mutex_unlock(&stripe->_lock);
+
+    if (deferred) {
+        [self loadEntry:entry inStripe:stripe deferred:deferred loader:loader];
+    }
+    return [self promiseForEntry:entry inStripe:stripe caller:caller];
+}
+
+- (KSPromise *)cachedPromiseForKey:(id<NSCopying>)key {
+    KSPromiseCacheStripe *stripe = [self stripeForKey:key];
+    KSDeferred *caller = nil;
+
+    pthread_mutex_lock(&stripe->_lock);
+    KSPromiseCacheEntry *entry = KSPromiseCacheLookup(stripe, key);
+    if (entry && !entry->_settled) {
+        caller = [KSDeferred defer];
+        [entry->_callers addObject:caller];
+    }
+    pthread_mutex_unlock(&stripe->_lock);
+
+    return entry ? [self promiseForEntry:entry inStripe:stripe caller:caller] : nil;
+}
+
+- (void)removePromiseForKey:(id<NSCopying>)key {
+    KSPromiseCacheStripe *stripe = [self stripeForKey:key];
+    pthread_mutex_lock(&stripe->_lock);
+    KSPromiseCacheEntry *entry = stripe->_entries[key];
+    if (entry) {
+        KSPromiseCacheRemove(stripe, entry);
+    }
+    pthread_mutex_unlock(&stripe->_lock);
+}
+
+- (void)removeAllPromises {
+    for (NSUInteger i = 0; i < KS_PROMISE_CACHE_STRIPES; i++) {
+        KSPromiseCacheStripe *stripe = _stripes[i];
+        pthread_mutex_lock(&stripe->_lock);
+        [stripe->_entries removeAllObjects];
+        stripe->_head = nil;
+        stripe->_tail = nil;
+        atomic_fetch_sub(&_totalCost, stripe->_cost);
+        stripe->_cost = 0;
+        pthread_mutex_unlock(&stripe->_lock);
+    }
+}
+
+- (void)evictSettledPromises {
+    for (NSUInteger i = 0; i < KS_PROMISE_CACHE_STRIPES; i++) {
+        KSPromiseCacheStripe *stripe = _stripes[i];
+        pthread_mutex_lock(&stripe->_lock);
+        while (stripe->_tail) {
+            KSPromiseCacheRemove(stripe, stripe->_tail);
+        }
+        pthread_mutex_unlock(&stripe->_lock);
+    }
+}
+
+- (NSUInteger)count {
+    NSUInteger count = 0;
+    for (NSUInteger i = 0; i < KS_PROMISE_CACHE_STRIPES; i++) {
+        KSPromiseCacheStripe *stripe = _stripes[i];
+        pthread_mutex_lock(&stripe->_lock);
+        count += stripe->_entries.count;
+        pthread_mutex_unlock(&stripe->_lock);
+    }
+    return count;
+}
+
+- (NSUInteger)totalCost {
+    return atomic_load(&_totalCost);
+}
+
+#pragma mark - Private methods
+
+- (KSPromiseCacheStripe *)stripeForKey:(id<NSCopying>)key {
+    NSUInteger hash = [(id)key hash];
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3b;
+    hash ^= hash >> 16;
+    return _stripes[hash % KS_PROMISE_CACHE_STRIPES];
+}
+
+// Evicts the least recently used value in the whole cache until the total is
+// back within budget. Each stripe's tail is its least recently used value, so
+// the oldest of the tails, by access tick, is the cache's. Stripes are locked
+// one at a time; a tail used meanwhile is passed over and the tails read again.
+- (void)evictToBudget {
+    NSUInteger budget = self.byteBudget;
+    while (atomic_load(&_totalCost) > budget) {
+        KSPromiseCacheStripe *oldest = nil;
+        uint64_t oldestUse = UINT64_MAX;
+        for (NSUInteger i = 0; i < KS_PROMISE_CACHE_STRIPES; i++) {
+            KSPromiseCacheStripe *stripe = _stripes[i];
+            pthread_mutex_lock(&stripe->_lock);
+            if (stripe->_tail && stripe->_tail->_lastUsed < oldestUse) {
+                oldest = stripe;
+                oldestUse = stripe->_tail->_lastUsed;
+            }
+            pthread_mutex_unlock(&stripe->_lock);
+        }
+        if (!oldest) {
+            return;
+        }
+        pthread_mutex_lock(&oldest->_lock);
+        if (oldest->_tail && oldest->_tail->_lastUsed == oldestUse) {
+            KSPromiseCacheRemove(oldest, oldest->_tail);
+        }
+        pthread_mutex_unlock(&oldest->_lock);
+    }
+}
+
+- (NSUInteger)costOfValue:(id)value {
+    if (self.costBlock) {
+        return value ? self.costBlock(value) : 0;
+    }
+    return [value isKindOfClass:[NSData class]] ? [(NSData *)value length] : 0;
+}
+
+// Each caller gets its own promise, so one caller cancelling leaves the others
+// waiting; the load is cancelled once every caller waiting on it has been.
+// caller is the deferred counted for a pending entry, or nil if the entry had
+// settled by the lookup.
+- (KSPromise *)promiseForEntry:(KSPromiseCacheEntry *)entry
+                      inStripe:(KSPromiseCacheStripe *)stripe
+                        caller:(KSDeferred *)caller {
+    KSPromise *shared = entry->_promise;
+    if (shared.fulfilled) {
+        return [KSPromise resolve:shared.value];
+    }
+    if (shared.rejected) {
+        return [KSPromise reject:shared.error];
+    }
+    // the entry settles before its shared promise does
+    if (!caller) {
+        caller = [KSDeferred defer];
+    }
+
+    __weak KSPromiseCache *weakSelf = self;
+    __weak KSDeferred *weakCaller = caller;
+    [caller whenCancelled:^{
+        [weakSelf caller:weakCaller cancelledEntry:entry inStripe:stripe];
+    }];
+    [shared onSettled:^(KSPromise *settled) {
+        if (settled.fulfilled) {
+            [caller resolveWithValue:settled.value];
+        } else {
+            [caller rejectWithError:settled.error];
+        }
+    }];
+    return caller.promise;
+}
+
+- (void)caller:(KSDeferred *)caller cancelledEntry:(KSPromiseCacheEntry *)entry inStripe:(KSPromiseCacheStripe *)stripe {
+    BOOL lastCaller = NO;
+    pthread_mutex_lock(&stripe->_lock);
+    if (caller && [entry->_callers containsObject:caller]) {
+        [entry->_callers removeObject:caller];
+        lastCaller = !entry->_settled && entry->_callers.count == 0;
+        if (lastCaller && stripe->_entries[entry->_key] == entry) {
+            KSPromiseCacheRemove(stripe, entry);
+        }
+    }
+    pthread_mutex_unlock(&stripe->_lock);
+
+    if (lastCaller) {
+        [entry->_promise cancel];
+    }
+}
+
+// The entry is updated before the waiters run, so their continuations see
+// the settled entry in the cache.
+- (void)loadEntry:(KSPromiseCacheEntry *)entry
+         inStripe:(KSPromiseCacheStripe *)stripe
+         deferred:(KSDeferred *)deferred
+           loader:(KSPromise *(^)(void))loader {
+    KSPromise *loaded = loader();
+    __weak KSPromiseCache *weakSelf = self;
+    __weak KSPromiseCacheEntry *weakEntry = entry;
+    [deferred whenCancelled:^{
+        KSPromiseCacheEntry *cancelledEntry = weakEntry;
+        if (cancelledEntry) {
+            [weakSelf entry:cancelledEntry settled:nil inStripe:stripe];
+        }
+        [loaded cancel];
+    }];
+    [loaded onSettled:^(KSPromise *settled) {
+        [weakSelf entry:entry settled:settled inStripe:stripe];
+        if (settled.fulfilled) {
+            [deferred resolveWithValue:settled.value];
+        } else {
+            [deferred rejectWithError:settled.error];
+        }
+    }];
+}
+
+// settled is nil if the entry's promise was cancelled.
+- (void)entry:(KSPromiseCacheEntry *)entry settled:(KSPromise *)settled inStripe:(KSPromiseCacheStripe *)stripe {
+    NSUInteger cost = settled.fulfilled ? [self costOfValue:settled.value] : 0;
+    NSTimeInterval timeToLive = settled.fulfilled ? self.timeToLive : self.failureTimeToLive;
+
+    pthread_mutex_lock(&stripe->_lock);
+    if (stripe->_entries[entry->_key] == entry && !entry->_settled) {
+        if (!settled || (settled.rejected && timeToLive <= 0)) {
+            KSPromiseCacheRemove(stripe, entry);
+        } else {
+            entry->_settled = YES;
+            entry->_cost = cost;
+            entry->_expiry = timeToLive > 0 ? KSClockNow() + (uint64_t)(timeToLive * NSEC_PER_SEC) : 0;
+            stripe->_cost += cost;
+            atomic_fetch_add(&_totalCost, cost);
+            KSPromiseCachePushFront(stripe, entry);
+            KSPromiseCacheTouch(stripe, entry);
+        }
+    }
+    pthread_mutex_unlock(&stripe->_lock);
+
+    if (self.byteBudget && atomic_load(&_totalCost) > self.byteBudget) {
+        [self evictToBudget];
+    }
+}
+
+@end
@@ -0,0 +1,35 @@
+#import <Foundation/Foundation.h>
+#import "KSNullabilityCompat.h"
+#import "KSGenericsCompat.h"
+
+@class KSPromise;
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Sampled creation and then: registration stacks for promises. One promise
+// in sampleInterval records where it was created, and one then: in
+// sampleInterval records where it was called; promises that aren't sampled
+// pay a thread-local decrement. Stacks are kept once each in a deduplicated
+// table of return addresses, so a handful of hot call sites costs a handful
+// of entries however many promises they create.
+//
+// Sampled stacks appear in KSPromiseMetrics stall reports and as stack frames
+// on the create and then events of KSPromiseTracing exports.
+@interface KSPromiseCreationSites : NSObject
+
+// 0 (the default) turns sampling off; 1 samples every promise.
++ (NSUInteger)sampleInterval;
++ (void)setSampleInterval:(NSUInteger)sampleInterval;
+
+// Distinct stacks and return addresses held in the table.
++ (NSUInteger)stackCount;
++ (NSUInteger)frameCount;
+
+// Symbolicated, innermost frame first; nil when the promise wasn't sampled.
++ (nullable NSArray KS_GENERIC(NSString *) *)creationSiteOfPromise:(KSPromise *)promise;
+// Where the then: that returned this promise was called.
++ (nullable NSArray KS_GENERIC(NSString *) *)registrationSiteOfPromise:(KSPromise *)promise;
+
+@end
+
+NS_ASSUME_NONNULL_END
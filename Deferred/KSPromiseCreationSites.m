@@ -0,0 +1,190 @@
+#import "KSPromiseCreationSites.h"
+#import "KSCreationSites.h"
+#import <execinfo.h>
+#import <pthread.h>
+
+
+#define KS_CREATION_SITE_FRAMES 24
+// KSCreationSiteCapture itself
+#define KS_CREATION_SITE_SKIPPED_FRAMES 1
+#define KS_CREATION_SITE_MAX_STACKS 65536
+#define KS_CREATION_SITE_MAX_FRAMES (1 << 22)
+
+typedef struct {
+    uint64_t hash;
+    uint32_t offset;
+    uint32_t count;
+} KSStackEntry;
+
+atomic_uint KSCreationSiteSampleInterval;
+__thread uint32_t KSCreationSiteCountdown;
+
+// All guarded by ks_stackLock. Stack ids are indexes into ks_stacks plus one;
+// ks_buckets is an open-addressed index of them by hash.
+static pthread_mutex_t ks_stackLock = PTHREAD_MUTEX_INITIALIZER;
+static KSStackEntry *ks_stacks;
+static uint32_t ks_stackCount;
+static uint32_t ks_stackCapacity;
+static uint32_t *ks_buckets;
+static uint32_t ks_bucketCapacity;
+static uintptr_t *ks_frames;
+static uint32_t ks_frameCount;
+static uint32_t ks_frameCapacity;
+
+
+static uint64_t KSStackHash(void **frames, int count) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < count; i++) {
+        hash ^= (uint64_t)(uintptr_t)frames[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static BOOL KSStackTableGrowBuckets(void) {
+    uint32_t capacity = ks_bucketCapacity ? ks_bucketCapacity * 2 : 1024;
+    uint32_t *buckets = calloc(capacity, sizeof(uint32_t));
+    if (!buckets) {
+        return NO;
+    }
+    for (uint32_t id = 1; id <= ks_stackCount; id++) {
+        uint32_t index = (uint32_t)ks_stacks[id - 1].hash & (capacity - 1);
+        while (buckets[index]) {
+            index = (index + 1) & (capacity - 1);
+        }
+        buckets[index] = id;
+    }
+    free(ks_buckets);
+    ks_buckets = buckets;
+    ks_bucketCapacity = capacity;
+    return YES;
+}
+
+static uint32_t KSStackTableIntern(void **frames, int count, uint64_t hash) {
+    if (ks_bucketCapacity == 0 && !KSStackTableGrowBuckets()) {
+        return 0;
+    }
+    uint32_t index = (uint32_t)hash & (ks_bucketCapacity - 1);
+    for (uint32_t id = ks_buckets[index]; id; id = ks_buckets[index]) {
+        KSStackEntry *entry = &ks_stacks[id - 1];
+        if (entry->hash == hash && entry->count == (uint32_t)count &&
+            memcmp(&ks_frames[entry->offset], frames, count * sizeof(uintptr_t)) == 0) {
+            return id;
+        }
+        index = (index + 1) & (ks_bucketCapacity - 1);
+    }
+
+    if (ks_stackCount >= KS_CREATION_SITE_MAX_STACKS || ks_frameCount + count > KS_CREATION_SITE_MAX_FRAMES) {
+        return 0;
+    }
+    if (ks_stackCount == ks_stackCapacity) {
+        uint32_t capacity = ks_stackCapacity ? ks_stackCapacity * 2 : 256;
+        KSStackEntry *stacks = realloc(ks_stacks, capacity * sizeof(KSStackEntry));
+        if (!stacks) {
+            return 0;
+        }
+        ks_stacks = stacks;
+        ks_stackCapacity = capacity;
+    }
+    if (ks_frameCount + count > ks_frameCapacity) {
+        uint32_t capacity = MAX(ks_frameCapacity * 2, (uint32_t)4096);
+        uintptr_t *arena = realloc(ks_frames, capacity * sizeof(uintptr_t));
+        if (!arena) {
+            return 0;
+        }
+        ks_frames = arena;
+        ks_frameCapacity = capacity;
+    }
+
+    KSStackEntry *entry = &ks_stacks[ks_stackCount];
+    entry->hash = hash;
+    entry->offset = ks_frameCount;
+    entry->count = (uint32_t)count;
+    memcpy(&ks_frames[ks_frameCount], frames, count * sizeof(uintptr_t));
+    ks_frameCount += count;
+    uint32_t id = ++ks_stackCount;
+
+    // rehashing places the new id as well
+    if (ks_stackCount * 2 <= ks_bucketCapacity || !KSStackTableGrowBuckets()) {
+        ks_buckets[index] = id;
+    }
+    return id;
+}
+
+uint32_t KSCreationSiteCapture(void) {
+    void *frames[KS_CREATION_SITE_FRAMES + KS_CREATION_SITE_SKIPPED_FRAMES];
+    int count = backtrace(frames, KS_CREATION_SITE_FRAMES + KS_CREATION_SITE_SKIPPED_FRAMES);
+    if (count <= KS_CREATION_SITE_SKIPPED_FRAMES) {
+        return 0;
+    }
+    void **stack = frames + KS_CREATION_SITE_SKIPPED_FRAMES;
+    count -= KS_CREATION_SITE_SKIPPED_FRAMES;
+    uint64_t hash = KSStackHash(stack, count);
+
+    pthread_mutex_lock(&ks_stackLock);
+    uint32_t id = KSStackTableIntern(stack, count, hash);
+    pthread_mutex_unlock(&ks_stackLock);
+    return id;
+}
+
+NSUInteger KSCreationSiteCopyFrames(uint32_t stack, uintptr_t *frames, NSUInteger capacity) {
+    NSUInteger count = 0;
+    pthread_mutex_lock(&ks_stackLock);
+    if (stack > 0 && stack <= ks_stackCount) {
+        KSStackEntry *entry = &ks_stacks[stack - 1];
+        count = MIN((NSUInteger)entry->count, capacity);
+        memcpy(frames, &ks_frames[entry->offset], count * sizeof(uintptr_t));
+    }
+    pthread_mutex_unlock(&ks_stackLock);
+    return count;
+}
+
+NSArray *KSCreationSiteSymbols(uint32_t stack) {
+    uintptr_t frames[KS_CREATION_SITE_FRAMES];
+    NSUInteger count = KSCreationSiteCopyFrames(stack, frames, KS_CREATION_SITE_FRAMES);
+    if (count == 0) {
+        return nil;
+    }
+    NSMutableArray *symbols = [NSMutableArray arrayWithCapacity:count];
+    char **names = backtrace_symbols((void **)frames, (int)count);
+    for (NSUInteger i = 0; i < count; i++) {
+        [symbols addObject:names ? @(names[i]) : [NSString stringWithFormat:@"0x%lx", (unsigned long)frames[i]]];
+    }
+    free(names);
+    return symbols;
+}
+
+
+@implementation KSPromiseCreationSites
+
++ (NSUInteger)sampleInterval {
+    return atomic_load(&KSCreationSiteSampleInterval);
+}
+
++ (void)setSampleInterval:(NSUInteger)sampleInterval {
+    atomic_store(&KSCreationSiteSampleInterval, (unsigned int)MIN(sampleInterval, (NSUInteger)UINT32_MAX));
+}
+
++ (NSUInteger)stackCount {
+    pthread_mutex_lock(&ks_stackLock);
+    NSUInteger count = ks_stackCount;
+    pthread_mutex_unlock(&ks_stackLock);
+    return count;
+}
+
++ (NSUInteger)frameCount {
+    pthread_mutex_lock(&ks_stackLock);
+    NSUInteger count = ks_frameCount;
+    pthread_mutex_unlock(&ks_stackLock);
+    return count;
+}
+
++ (NSArray *)creationSiteOfPromise:(KSPromise *)promise {
+    return KSCreationSiteSymbols(KSCreationSiteOfPromise(promise));
+}
+
++ (NSArray *)registrationSiteOfPromise:(KSPromise *)promise {
+    return KSCreationSiteSymbols(KSRegistrationSiteOfPromise(promise));
+}
+
+@end
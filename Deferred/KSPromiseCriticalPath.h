@@ -0,0 +1,58 @@
+#import <Foundation/Foundation.h>
+#import "KSNullabilityCompat.h"
+#import "KSGenericsCompat.h"
+
+@class KSPromise;
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(NSInteger, KSPromiseCriticalPathStageKind) {
+    // Between a promise settling and the callback chained off it starting.
+    KSPromiseCriticalPathStageQueueWait,
+    KSPromiseCriticalPathStageCallback,
+    // A promise settled by work outside any traced callback, such as a
+    // deferred resolved from a delegate method.
+    KSPromiseCriticalPathStageExternal,
+    // A promise waiting on a KSURLSessionClient request.
+    KSPromiseCriticalPathStageNetwork,
+};
+
+@interface KSPromiseCriticalPathStage : NSObject
+
+@property (nonatomic, readonly) KSPromiseCriticalPathStageKind kind;
+// The trace id of the promise the stage settles, as in the Chrome export.
+@property (copy, nonatomic, readonly) NSString *promiseIdentifier;
+// Relative to the start of the path.
+@property (nonatomic, readonly) NSTimeInterval startTime;
+@property (nonatomic, readonly) NSTimeInterval endTime;
+@property (nonatomic, readonly) NSTimeInterval duration;
+
+@end
+
+// The chain of promises, callbacks and waits that decided when a promise
+// settled, reconstructed from KSPromiseTracing events. then: children are
+// followed back to their parent's callback, promises returned from callbacks
+// to the promise they settled, and +when: to its last parent to settle.
+@interface KSPromiseCriticalPath : NSObject
+
+// From the events KSPromiseTracing currently holds. nil if the promise was not
+// traced or has not settled.
++ (nullable instancetype)criticalPathToPromise:(KSPromise *)promise;
+// From a trace written by +[KSPromiseTracing chromeTraceData].
++ (nullable instancetype)criticalPathInChromeTrace:(NSData *)trace toPromiseIdentifier:(NSString *)promiseIdentifier;
+
+// In the order they happened.
+@property (strong, nonatomic, readonly) NSArray KS_GENERIC(KSPromiseCriticalPathStage *) *stages;
+@property (nonatomic, readonly) NSTimeInterval duration;
+@property (nonatomic, readonly) NSTimeInterval queueWaitTime;
+@property (nonatomic, readonly) NSTimeInterval callbackTime;
+@property (nonatomic, readonly) NSTimeInterval externalTime;
+@property (nonatomic, readonly) NSTimeInterval networkTime;
+
+// The longest stage, which is the first thing to parallelize or cache.
+@property (strong, nonatomic, readonly, nullable) KSPromiseCriticalPathStage *dominantStage;
+- (NSString *)recommendation;
+
+@end
+
+NS_ASSUME_NONNULL_END
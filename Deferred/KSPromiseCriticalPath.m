@@ -0,0 +1,359 @@
+#import "KSPromiseCriticalPath.h"
+#import "KSTrace.h"
+#import "KSClock.h"
+
+
+static uint64_t KSCriticalPathParseIdentifier(id identifier) {
+    return [identifier isKindOfClass:[NSString class]] ? strtoull([identifier UTF8String], NULL, 16) : 0;
+}
+
+static NSString *KSCriticalPathIdentifierString(uint64_t identifier) {
+    return [NSString stringWithFormat:@"0x%llx", (unsigned long long)identifier];
+}
+
+
+@interface KSCriticalPathNode : NSObject {
+@public
+    uint64_t identifier;
+    uint64_t created;
+    uint64_t settled;
+    BOOL hasCreated;
+    BOOL hasSettled;
+    BOOL network;
+    uint64_t thenParent;
+    uint64_t callbackBegin;
+    uint64_t callbackEnd;
+    BOOL hasCallback;
+    uint64_t adopted;
+    NSMutableArray *whenParents;
+}
+@end
+
+@implementation KSCriticalPathNode
+@end
+
+
+@interface KSPromiseCriticalPathStage ()
+@property (nonatomic, readwrite) KSPromiseCriticalPathStageKind kind;
+@property (copy, nonatomic, readwrite) NSString *promiseIdentifier;
+@property (nonatomic, readwrite) NSTimeInterval startTime;
+@property (nonatomic, readwrite) NSTimeInterval endTime;
+@property (nonatomic) uint64_t start;
+@property (nonatomic) uint64_t end;
+@end
+
+@implementation KSPromiseCriticalPathStage
+
+- (NSTimeInterval)duration {
+    return self.endTime - self.startTime;
+}
+
+- (NSString *)description {
+    NSArray *kinds = @[@"queue wait", @"callback", @"external", @"network"];
+    return [NSString stringWithFormat:@"<%@: %@ for %@, %.3fms at %.3fms>",
+            NSStringFromClass([self class]), kinds[self.kind], self.promiseIdentifier,
+            self.duration * 1000.0, self.startTime * 1000.0];
+}
+
+@end
+
+
+@interface KSPromiseCriticalPath ()
+@property (strong, nonatomic, readwrite) NSArray *stages;
+@property (nonatomic, readwrite) NSTimeInterval duration;
+@end
+
+@implementation KSPromiseCriticalPath
+
++ (instancetype)criticalPathToPromise:(KSPromise *)promise {
+    uint64_t identifier = KSTraceIdentifierForPromise(promise);
+    if (identifier == 0) {
+        return nil;
+    }
+    size_t count;
+    KSTraceEventRecord *events = KSTraceCopyEvents(&count);
+    NSDictionary *nodes = [self nodesFromEvents:events count:count];
+    free(events);
+    return [[self alloc] initWithNodes:nodes target:identifier];
+}
+
++ (instancetype)criticalPathInChromeTrace:(NSData *)trace toPromiseIdentifier:(NSString *)promiseIdentifier {
+    NSDictionary *json = [NSJSONSerialization JSONObjectWithData:trace options:0 error:NULL];
+    if (![json isKindOfClass:[NSDictionary class]]) {
+        return nil;
+    }
+    NSArray *traceEvents = json[@"traceEvents"];
+    KSTraceEventRecord *events = calloc(MAX(traceEvents.count, (NSUInteger)1), sizeof(KSTraceEventRecord));
+    size_t count = 0;
+    for (NSDictionary *event in traceEvents) {
+        if ([self parseChromeEvent:event into:&events[count]]) {
+            count++;
+        }
+    }
+    NSDictionary *nodes = [self nodesFromEvents:events count:count];
+    free(events);
+    return [[self alloc] initWithNodes:nodes target:KSCriticalPathParseIdentifier(promiseIdentifier)];
+}
+
+// The inverse of the mapping in KSPromiseTracing's Chrome export.
++ (BOOL)parseChromeEvent:(NSDictionary *)event into:(KSTraceEventRecord *)record {
+    NSString *phase = event[@"ph"];
+    NSString *name = event[@"name"];
+    NSDictionary *args = event[@"args"];
+    record->timestamp = (uint64_t)([event[@"ts"] doubleValue] * 1000.0);
+    record->identifier = KSCriticalPathParseIdentifier(event[@"id"]);
+    record->related = 0;
+
+    if ([name isEqualToString:@"promise"] && [phase isEqualToString:@"b"]) {
+        record->type = KSTraceEventCreate;
+    } else if ([name isEqualToString:@"promise"] && [phase isEqualToString:@"e"]) {
+        record->type = [args[@"state"] isEqualToString:@"rejected"] ? KSTraceEventReject : KSTraceEventResolve;
+    } else if ([name isEqualToString:@"callback"] && ([phase isEqualToString:@"B"] || [phase isEqualToString:@"E"])) {
+        record->type = [phase isEqualToString:@"B"] ? KSTraceEventCallbackBegin : KSTraceEventCallbackEnd;
+        record->identifier = KSCriticalPathParseIdentifier(args[@"promise"]);
+        record->related = KSCriticalPathParseIdentifier(args[@"child"]);
+    } else if ([phase isEqualToString:@"n"]) {
+        NSDictionary *types = @{@"then": @(KSTraceEventThen), @"cancel": @(KSTraceEventCancel),
+                                @"when": @(KSTraceEventWhenParent), @"adopt": @(KSTraceEventAdopt),
+                                @"network": @(KSTraceEventNetwork)};
+        NSDictionary *relatedKeys = @{@"then": @"child", @"when": @"parent", @"adopt": @"promise"};
+        if (!types[name]) {
+            return NO;
+        }
+        record->type = [types[name] unsignedIntValue];
+        if (relatedKeys[name]) {
+            record->related = KSCriticalPathParseIdentifier(args[relatedKeys[name]]);
+        }
+    } else {
+        return NO;
+    }
+    return YES;
+}
+
++ (NSDictionary *)nodesFromEvents:(KSTraceEventRecord *)events count:(size_t)count {
+    NSMutableDictionary *nodes = [NSMutableDictionary dictionary];
+    KSCriticalPathNode *(^node)(uint64_t) = ^KSCriticalPathNode *(uint64_t identifier) {
+        KSCriticalPathNode *node = nodes[@(identifier)];
+        if (!node) {
+            node = [[KSCriticalPathNode alloc] init];
+            node->identifier = identifier;
+            node->whenParents = [NSMutableArray array];
+            nodes[@(identifier)] = node;
+        }
+        return node;
+    };
+
+    for (size_t i = 0; i < count; i++) {
+        KSTraceEventRecord *event = &events[i];
+        if (event->identifier == 0) {
+            continue;
+        }
+        switch (event->type) {
+            case KSTraceEventCreate: {
+                KSCriticalPathNode *created = node(event->identifier);
+                created->created = event->timestamp;
+                created->hasCreated = YES;
+                break;
+            }
+            case KSTraceEventResolve:
+            case KSTraceEventReject: {
+                KSCriticalPathNode *settled = node(event->identifier);
+                settled->settled = event->timestamp;
+                settled->hasSettled = YES;
+                break;
+            }
+            case KSTraceEventThen:
+                if (event->related != 0) {
+                    node(event->related)->thenParent = event->identifier;
+                }
+                break;
+            case KSTraceEventCallbackBegin:
+                if (event->related != 0) {
+                    KSCriticalPathNode *child = node(event->related);
+                    child->callbackBegin = event->timestamp;
+                    child->hasCallback = YES;
+                }
+                break;
+            case KSTraceEventCallbackEnd:
+                if (event->related != 0) {
+                    node(event->related)->callbackEnd = event->timestamp;
+                }
+                break;
+            case KSTraceEventWhenParent:
+                if (event->related != 0) {
+                    [node(event->identifier)->whenParents addObject:@(event->related)];
+                }
+                break;
+            case KSTraceEventAdopt:
+                node(event->identifier)->adopted = event->related;
+                break;
+            case KSTraceEventNetwork:
+                node(event->identifier)->network = YES;
+                break;
+            case KSTraceEventCancel:
+                break;
+        }
+    }
+    return nodes;
+}
+
+- (instancetype)initWithNodes:(NSDictionary *)nodes target:(uint64_t)target {
+    KSCriticalPathNode *node = nodes[@(target)];
+    if (!node || !node->hasSettled) {
+        return nil;
+    }
+    self = [super init];
+    if (self) {
+        uint64_t end = node->settled;
+        NSMutableArray *stages = [NSMutableArray array];
+        void (^addStage)(KSPromiseCriticalPathStageKind, uint64_t, uint64_t, uint64_t) =
+        ^(KSPromiseCriticalPathStageKind kind, uint64_t start, uint64_t finish, uint64_t identifier) {
+            if (finish <= start) {
+                return;
+            }
+            KSPromiseCriticalPathStage *stage = [[KSPromiseCriticalPathStage alloc] init];
+            stage.kind = kind;
+            stage.start = start;
+            stage.end = finish;
+            stage.promiseIdentifier = KSCriticalPathIdentifierString(identifier);
+            [stages insertObject:stage atIndex:0];
+        };
+
+        // Callbacks that returned a promise; the promises they created are
+        // traced back into them once their own chain runs out.
+        NSMutableArray *creators = [NSMutableArray array];
+        NSMutableSet *visited = [NSMutableSet set];
+        while (node && node->hasSettled && ![visited containsObject:@(node->identifier)]) {
+            [visited addObject:@(node->identifier)];
+
+            KSCriticalPathNode *adopted = node->adopted ? nodes[@(node->adopted)] : nil;
+            if (adopted && adopted->hasSettled) {
+                addStage(KSPromiseCriticalPathStageQueueWait, adopted->settled, node->settled, node->identifier);
+                if (node->hasCallback && node->thenParent) {
+                    [creators addObject:node];
+                }
+                node = adopted;
+                continue;
+            }
+
+            KSCriticalPathNode *parent = node->thenParent ? nodes[@(node->thenParent)] : nil;
+            if (parent && node->hasCallback) {
+                addStage(KSPromiseCriticalPathStageCallback, node->callbackBegin, MAX(node->callbackEnd, node->callbackBegin), node->identifier);
+                if (parent->hasSettled) {
+                    addStage(KSPromiseCriticalPathStageQueueWait, parent->settled, node->callbackBegin, node->identifier);
+                }
+                node = parent;
+                continue;
+            }
+
+            if (node->whenParents.count > 0) {
+                KSCriticalPathNode *latest = nil;
+                for (NSNumber *identifier in node->whenParents) {
+                    KSCriticalPathNode *candidate = nodes[identifier];
+                    if (candidate && candidate->hasSettled && (!latest || candidate->settled > latest->settled)) {
+                        latest = candidate;
+                    }
+                }
+                if (latest) {
+                    addStage(KSPromiseCriticalPathStageQueueWait, latest->settled, node->settled, node->identifier);
+                    node = latest;
+                    continue;
+                }
+            }
+
+            uint64_t start = node->hasCreated ? node->created : node->settled;
+            addStage(node->network ? KSPromiseCriticalPathStageNetwork : KSPromiseCriticalPathStageExternal,
+                     start, node->settled, node->identifier);
+
+            KSCriticalPathNode *creator = creators.lastObject;
+            if (creator && node->hasCreated && node->created >= creator->callbackBegin) {
+                [creators removeLastObject];
+                addStage(KSPromiseCriticalPathStageCallback, creator->callbackBegin, node->created, creator->identifier);
+                KSCriticalPathNode *creatorParent = nodes[@(creator->thenParent)];
+                if (creatorParent && creatorParent->hasSettled) {
+                    addStage(KSPromiseCriticalPathStageQueueWait, creatorParent->settled, creator->callbackBegin, creator->identifier);
+                }
+                node = creatorParent;
+                continue;
+            }
+            break;
+        }
+
+        uint64_t begin = stages.count > 0 ? [stages.firstObject start] : end;
+        for (KSPromiseCriticalPathStage *stage in stages) {
+            stage.startTime = KSClockInterval(stage.start - begin);
+            stage.endTime = KSClockInterval(stage.end - begin);
+        }
+        self.stages = stages;
+        self.duration = KSClockInterval(end - begin);
+    }
+    return self;
+}
+
+- (NSTimeInterval)timeForKind:(KSPromiseCriticalPathStageKind)kind {
+    NSTimeInterval total = 0;
+    for (KSPromiseCriticalPathStage *stage in self.stages) {
+        if (stage.kind == kind) {
+            total += stage.duration;
+        }
+    }
+    return total;
+}
+
+- (NSTimeInterval)queueWaitTime {
+    return [self timeForKind:KSPromiseCriticalPathStageQueueWait];
+}
+
+- (NSTimeInterval)callbackTime {
+    return [self timeForKind:KSPromiseCriticalPathStageCallback];
+}
+
+- (NSTimeInterval)externalTime {
+    return [self timeForKind:KSPromiseCriticalPathStageExternal];
+}
+
+- (NSTimeInterval)networkTime {
+    return [self timeForKind:KSPromiseCriticalPathStageNetwork];
+}
+
+- (KSPromiseCriticalPathStage *)dominantStage {
+    KSPromiseCriticalPathStage *dominant = nil;
+    for (KSPromiseCriticalPathStage *stage in self.stages) {
+        if (!dominant || stage.duration > dominant.duration) {
+            dominant = stage;
+        }
+    }
+    return dominant;
+}
+
+- (NSString *)recommendation {
+    KSPromiseCriticalPathStage *stage = self.dominantStage;
+    if (!stage) {
+        return @"Nothing on the critical path was traced.";
+    }
+    double share = self.duration > 0 ? stage.duration / self.duration * 100.0 : 100.0;
+    switch (stage.kind) {
+        case KSPromiseCriticalPathStageNetwork:
+            return [NSString stringWithFormat:@"The request behind %@ is %.0f%% of the critical path; cache or prefetch it first.",
+                    stage.promiseIdentifier, share];
+        case KSPromiseCriticalPathStageExternal:
+            return [NSString stringWithFormat:@"%@ waited %.0f%% of the critical path on work outside any traced callback; start that work earlier or cache its result.",
+                    stage.promiseIdentifier, share];
+        case KSPromiseCriticalPathStageCallback:
+            return [NSString stringWithFormat:@"The callback settling %@ ran for %.0f%% of the critical path; split it so its work can run in parallel, or move it off the path.",
+                    stage.promiseIdentifier, share];
+        case KSPromiseCriticalPathStageQueueWait:
+            return [NSString stringWithFormat:@"%@ waited %.0f%% of the critical path for its callback to be scheduled; the executor running it is saturated.",
+                    stage.promiseIdentifier, share];
+    }
+    return @"";
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %.3fms over %lu stages (queue %.3fms, callbacks %.3fms, external %.3fms, network %.3fms)>",
+            NSStringFromClass([self class]), self.duration * 1000.0, (unsigned long)self.stages.count,
+            self.queueWaitTime * 1000.0, self.callbackTime * 1000.0,
+            self.externalTime * 1000.0, self.networkTime * 1000.0];
+}
+
+@end
@@ -0,0 +1,8 @@
+#import <Foundation/Foundation.h>
+
+@class KSPromise;
+
+// Calls observer once, when promise is fulfilled, rejected or cancelled,
+// whichever comes first. For releasing resources held for a promise, which
+// onSettled: alone would leak when the promise is cancelled.
+void KSPromiseOnEnd(KSPromise *promise, void (^observer)(KSPromise *promise));
@@ -0,0 +1,33 @@
+#import <Foundation/Foundation.h>
+#import "KSPromise.h"
+#import "KSCancellable.h"
+#import "KSNullabilityCompat.h"
+#import "KSGenericsCompat.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Owns the tasks spawned into it. The group's promise resolves with their
+// values in spawn order once it is closed and every task has fulfilled. The
+// first task to reject cancels the rest and rejects the group, and a task
+// cancelled from outside cancels the rest and the group; cancelling the
+// group, or its promise, cancels every task still running. Each task is
+// counted off once as it settles, so resolving a group of n tasks is O(n).
+@interface KSPromiseGroup : NSObject<KSCancellable>
+
+// Runs scope with a new group and closes the group when scope returns.
++ (KSPromise KS_GENERIC(NSArray *) *)group:(void (^)(KSPromiseGroup *group))scope;
+
+@property (strong, nonatomic, readonly) KSPromise KS_GENERIC(NSArray *) *promise;
+
+// Calls task and adds the promise it returns. Once the group has failed or
+// been cancelled, task isn't called and a cancelled promise is returned.
+- (KSPromise *)spawn:(KSPromise *(^)(void))task;
+// Adds a promise started elsewhere, which the group may then cancel.
+- (void)addPromise:(KSPromise *)promise;
+
+// No more tasks will be added.
+- (void)close;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,175 @@
+#import "KSPromiseGroup.h"
+#import "KSDeferred.h"
+#import "KSPromiseEnd.h"
+#import <pthread.h>
+
+
+// Settled tasks are left alone: cancelling one would still reach the
+// cancellables, such as the KSDeferred, behind it.
+static void KSPromiseGroupCancelPending(NSArray *tasks) {
+    for (KSPromise *task in tasks) {
+        if (!task.fulfilled && !task.rejected) {
+            [task cancel];
+        }
+    }
+}
+
+
+@interface KSPromiseGroup () {
+    pthread_mutex_t _lock;
+    // tasks in spawn order; nil once the group has settled
+    NSMutableArray *_tasks;
+    NSMutableArray *_values;
+    NSUInteger _pending;
+    BOOL _closed;
+    BOOL _finished;
+}
+@property (strong, nonatomic) KSDeferred *deferred;
+@end
+
+@implementation KSPromiseGroup
+
++ (KSPromise *)group:(void (^)(KSPromiseGroup *group))scope {
+    KSPromiseGroup *group = [[KSPromiseGroup alloc] init];
+    scope(group);
+    [group close];
+    return group.promise;
+}
+
+- (id)init {
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_lock, NULL);
+        _tasks = [NSMutableArray array];
+        _values = [NSMutableArray array];
+        self.deferred = [KSDeferred defer];
+        __weak KSPromiseGroup *weakSelf = self;
+        [self.deferred whenCancelled:^{
+            [weakSelf cancel];
+        }];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    pthread_mutex_destroy(&_lock);
+}
+
+- (KSPromise *)promise {
+    return self.deferred.promise;
+}
+
+- (KSPromise *)spawn:(KSPromise *(^)(void))task {
+    pthread_mutex_lock(&_lock);
+    BOOL finished = _finished;
+    pthread_mutex_unlock(&_lock);
+    if (finished) {
+        KSPromise *promise = [KSDeferred defer].promise;
+        [promise cancel];
+        return promise;
+    }
+
+    KSPromise *promise = task();
+    [self addPromise:promise];
+    return promise;
+}
+
+- (void)addPromise:(KSPromise *)promise {
+    pthread_mutex_lock(&_lock);
+    NSAssert(!_closed, @"A closed group can not take more tasks.");
+    BOOL finished = _finished;
+    NSUInteger index = _tasks.count;
+    if (!finished) {
+        [_tasks addObject:promise];
+        [_values addObject:[NSNull null]];
+        _pending++;
+    }
+    pthread_mutex_unlock(&_lock);
+
+    if (finished) {
+        [promise cancel];
+        return;
+    }
+    KSPromiseOnEnd(promise, ^(KSPromise *ended) {
+        [self task:index ended:ended];
+    });
+}
+
+- (void)close {
+    pthread_mutex_lock(&_lock);
+    _closed = YES;
+    BOOL fulfilled = !_finished && _pending == 0;
+    NSArray *values = fulfilled ? [self finish] : nil;
+    pthread_mutex_unlock(&_lock);
+
+    if (fulfilled) {
+        [self.deferred resolveWithValue:values];
+    }
+}
+
+- (void)cancel {
+    pthread_mutex_lock(&_lock);
+    NSArray *tasks = _finished ? nil : _tasks;
+    if (!_finished) {
+        [self finish];
+    }
+    pthread_mutex_unlock(&_lock);
+
+    if (tasks) {
+        KSPromiseGroupCancelPending(tasks);
+        [self.deferred.promise cancel];
+    }
+}
+
+#pragma mark - Private methods
+
+// Call with the lock held. Returns the values and lets go of the tasks.
+- (NSArray *)finish {
+    NSArray *values = _values;
+    _finished = YES;
+    _tasks = nil;
+    _values = nil;
+    return values;
+}
+
+- (void)task:(NSUInteger)index ended:(KSPromise *)task {
+    pthread_mutex_lock(&_lock);
+    if (_finished) {
+        pthread_mutex_unlock(&_lock);
+        return;
+    }
+    // a task cancelled from outside will never settle, so it fails the
+    // group; having no error to pass on, the group is cancelled
+    if (!task.fulfilled && !task.rejected) {
+        NSArray *tasks = _tasks;
+        [self finish];
+        pthread_mutex_unlock(&_lock);
+
+        KSPromiseGroupCancelPending(tasks);
+        [self.deferred.promise cancel];
+        return;
+    }
+    if (task.rejected) {
+        NSArray *tasks = _tasks;
+        [self finish];
+        pthread_mutex_unlock(&_lock);
+
+        KSPromiseGroupCancelPending(tasks);
+        [self.deferred rejectWithError:task.error];
+        return;
+    }
+
+    if (task.value) {
+        _values[index] = task.value;
+    }
+    _pending--;
+    BOOL fulfilled = _closed && _pending == 0;
+    NSArray *values = fulfilled ? [self finish] : nil;
+    pthread_mutex_unlock(&_lock);
+
+    if (fulfilled) {
+        [self.deferred resolveWithValue:values];
+    }
+}
+
+@end
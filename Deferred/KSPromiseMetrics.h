@@ -0,0 +1,80 @@
+#import <Foundation/Foundation.h>
+#import "KSNullabilityCompat.h"
+#import "KSGenericsCompat.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Log-linear histogram of durations, eight buckets per power of two, so any
+// reported percentile is within 12.5% of the recorded value.
+@interface KSPromiseMetricsHistogram : NSObject
+
+@property (nonatomic, readonly) uint64_t count;
+@property (nonatomic, readonly) NSTimeInterval minimum;
+@property (nonatomic, readonly) NSTimeInterval maximum;
+@property (nonatomic, readonly) NSTimeInterval mean;
+
+// percentile is in [0, 100].
+- (NSTimeInterval)valueAtPercentile:(double)percentile;
+- (NSDictionary *)dictionaryRepresentation;
+
+@end
+
+// A promise that was still pending after KSPromiseMetrics.stallThreshold.
+@interface KSPromiseStallReport : NSObject
+
+// Only for matching against other diagnostics; the promise is not retained.
+@property (nonatomic, readonly) uintptr_t promiseAddress;
+@property (nonatomic, readonly) NSTimeInterval pendingDuration;
+// Symbolicated creation stack, innermost frame first. Empty unless
+// KSPromiseCreationSites sampled the promise.
+@property (nonatomic, readonly) NSArray KS_GENERIC(NSString *) *creationSite;
+
+@end
+
+@interface KSPromiseMetricsSnapshot : NSObject
+
+@property (nonatomic, readonly) uint64_t createdCount;
+@property (nonatomic, readonly) uint64_t liveCount;
+@property (nonatomic, readonly) uint64_t pendingCount;
+// Continuations registered on pending promises or handed to an executor
+// that have not run yet.
+@property (nonatomic, readonly) uint64_t continuationQueueDepth;
+
+// From settlement to the start of each callback.
+@property (strong, nonatomic, readonly) KSPromiseMetricsHistogram *resolveToCallbackTime;
+@property (strong, nonatomic, readonly) KSPromiseMetricsHistogram *callbackExecutionTime;
+// From creation to settlement.
+@property (strong, nonatomic, readonly) KSPromiseMetricsHistogram *pendingTime;
+
+// Promises pending longer than the stall threshold when the snapshot was taken.
+@property (strong, nonatomic, readonly) NSArray KS_GENERIC(KSPromiseStallReport *) *stalledPromises;
+
+- (NSDictionary *)dictionaryRepresentation;
+
+@end
+
+// Process-wide promise metrics. Counters and histograms are sharded by CPU
+// (by thread where the CPU number isn't available), so recording never
+// contends on a shared cache line. Only promises created after +start are
+// counted.
+@interface KSPromiseMetrics : NSObject
+
++ (void)start;
++ (void)stop;
++ (BOOL)isEnabled;
++ (void)reset;
+
++ (KSPromiseMetricsSnapshot *)snapshot;
+
+// Promises pending longer than this are reported. 0, the default, turns the
+// watchdog off; only promises created while it is on and metrics are started
+// are watched.
++ (NSTimeInterval)stallThreshold;
++ (void)setStallThreshold:(NSTimeInterval)stallThreshold;
+
+// Called on a private queue once for each promise that crosses the threshold.
++ (void)setStallHandler:(nullable void (^)(KSPromiseStallReport *report))stallHandler;
+
+@end
+
+NS_ASSUME_NONNULL_END
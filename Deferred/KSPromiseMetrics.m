@@ -0,0 +1,534 @@
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+#import "KSPromiseMetrics.h"
+#import "KSMetrics.h"
+#import "KSClock.h"
+#import "KSCreationSites.h"
+#import <pthread.h>
+#if defined(__linux__)
+#import <sched.h>
+#endif
+
+
+#define KS_METRICS_SHARDS 16
+#define KS_HISTOGRAM_SUB_BUCKET_BITS 3
+#define KS_HISTOGRAM_SUB_BUCKETS (1 << KS_HISTOGRAM_SUB_BUCKET_BITS)
+// durations of 2^42ns (about 73 minutes) and up share the last bucket
+#define KS_HISTOGRAM_MAX_MAGNITUDE 42
+#define KS_HISTOGRAM_BUCKETS ((KS_HISTOGRAM_MAX_MAGNITUDE - KS_HISTOGRAM_SUB_BUCKET_BITS + 1) * KS_HISTOGRAM_SUB_BUCKETS)
+
+typedef NS_ENUM(NSUInteger, KSMetricsCounter) {
+    KSMetricsCounterCreated,
+    KSMetricsCounterSettled,
+    KSMetricsCounterDeallocated,
+    KSMetricsCounterDeallocatedPending,
+    KSMetricsCounterContinuationsQueued,
+    KSMetricsCounterContinuationsRun,
+    KSMetricsCounterContinuationsDropped,
+    KSMetricsCounterCount
+};
+
+typedef NS_ENUM(NSUInteger, KSMetricsHistogramKind) {
+    KSMetricsHistogramResolveToCallback,
+    KSMetricsHistogramCallbackExecution,
+    KSMetricsHistogramPending,
+    KSMetricsHistogramCount
+};
+
+typedef struct {
+    atomic_uint_fast64_t buckets[KS_HISTOGRAM_BUCKETS];
+    atomic_uint_fast64_t sum;
+} KSMetricsHistogramShard;
+
+typedef struct {
+    _Alignas(64) atomic_uint_fast64_t counters[KSMetricsCounterCount];
+    KSMetricsHistogramShard histograms[KSMetricsHistogramCount];
+} KSMetricsShard;
+
+struct KSMetricsRecord {
+    uint64_t createdAt;
+    uint64_t settledAt;
+    // continuations registered while pending, guarded by the promise's lock
+    NSUInteger waiting;
+    uintptr_t promise;
+
+    // watchdog list membership, guarded by the list's lock
+    struct KSMetricsRecord *previous;
+    struct KSMetricsRecord *next;
+    int watchList;
+    BOOL reported;
+
+    uint32_t creationSite;
+};
+
+typedef struct {
+    pthread_mutex_t lock;
+    KSMetricsRecord *head;
+} KSMetricsWatchList;
+
+
+atomic_bool KSMetricsEnabled;
+
+static KSMetricsShard ks_shards[KS_METRICS_SHARDS];
+static KSMetricsWatchList ks_watchLists[KS_METRICS_SHARDS];
+static atomic_uint ks_nextThreadShard;
+static __thread unsigned ks_threadShard = UINT_MAX;
+
+static atomic_uint_fast64_t ks_stallThreshold;
+static pthread_mutex_t ks_settingsLock = PTHREAD_MUTEX_INITIALIZER;
+static dispatch_source_t ks_watchdogTimer;
+static void (^ks_stallHandler)(KSPromiseStallReport *report);
+
+
+static void KSMetricsInitialize(void) {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        for (NSUInteger i = 0; i < KS_METRICS_SHARDS; i++) {
+            pthread_mutex_init(&ks_watchLists[i].lock, NULL);
+        }
+    });
+}
+
+static inline unsigned KSMetricsCurrentShard(void) {
+#if defined(__linux__)
+    int cpu = sched_getcpu();
+    if (cpu >= 0) {
+        return (unsigned)cpu % KS_METRICS_SHARDS;
+    }
+#endif
+    if (ks_threadShard == UINT_MAX) {
+        ks_threadShard = atomic_fetch_add(&ks_nextThreadShard, 1) % KS_METRICS_SHARDS;
+    }
+    return ks_threadShard;
+}
+
+static inline void KSMetricsAdd(KSMetricsCounter counter, uint64_t amount) {
+    atomic_fetch_add_explicit(&ks_shards[KSMetricsCurrentShard()].counters[counter], amount, memory_order_relaxed);
+}
+
+static inline NSUInteger KSHistogramBucket(uint64_t value) {
+    if (value < KS_HISTOGRAM_SUB_BUCKETS) {
+        return (NSUInteger)value;
+    }
+    unsigned magnitude = 63 - __builtin_clzll(value);
+    if (magnitude >= KS_HISTOGRAM_MAX_MAGNITUDE) {
+        return KS_HISTOGRAM_BUCKETS - 1;
+    }
+    NSUInteger subBucket = (value >> (magnitude - KS_HISTOGRAM_SUB_BUCKET_BITS)) & (KS_HISTOGRAM_SUB_BUCKETS - 1);
+    return (magnitude - KS_HISTOGRAM_SUB_BUCKET_BITS + 1) * KS_HISTOGRAM_SUB_BUCKETS + subBucket;
+}
+
+static inline uint64_t KSHistogramBucketStart(NSUInteger bucket) {
+    if (bucket < KS_HISTOGRAM_SUB_BUCKETS) {
+        return bucket;
+    }
+    NSUInteger magnitude = bucket / KS_HISTOGRAM_SUB_BUCKETS + KS_HISTOGRAM_SUB_BUCKET_BITS - 1;
+    uint64_t subBucket = bucket % KS_HISTOGRAM_SUB_BUCKETS;
+    return (KS_HISTOGRAM_SUB_BUCKETS + subBucket) << (magnitude - KS_HISTOGRAM_SUB_BUCKET_BITS);
+}
+
+static inline void KSHistogramRecord(KSMetricsHistogramKind kind, uint64_t value) {
+    KSMetricsHistogramShard *histogram = &ks_shards[KSMetricsCurrentShard()].histograms[kind];
+    atomic_fetch_add_explicit(&histogram->buckets[KSHistogramBucket(value)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->sum, value, memory_order_relaxed);
+}
+
+
+#pragma mark - Watchdog
+
+static void KSMetricsWatch(KSMetricsRecord *record) {
+    int index = (int)KSMetricsCurrentShard();
+    KSMetricsWatchList *list = &ks_watchLists[index];
+    pthread_mutex_lock(&list->lock);
+    record->watchList = index;
+    record->previous = NULL;
+    record->next = list->head;
+    if (list->head) {
+        list->head->previous = record;
+    }
+    list->head = record;
+    pthread_mutex_unlock(&list->lock);
+}
+
+static void KSMetricsUnwatch(KSMetricsRecord *record) {
+    if (record->watchList < 0) {
+        return;
+    }
+    KSMetricsWatchList *list = &ks_watchLists[record->watchList];
+    pthread_mutex_lock(&list->lock);
+    if (record->previous) {
+        record->previous->next = record->next;
+    } else {
+        list->head = record->next;
+    }
+    if (record->next) {
+        record->next->previous = record->previous;
+    }
+    record->watchList = -1;
+    pthread_mutex_unlock(&list->lock);
+}
+
+
+@interface KSPromiseStallReport ()
+@property (nonatomic, readwrite) uintptr_t promiseAddress;
+@property (nonatomic, readwrite) NSTimeInterval pendingDuration;
+@property (nonatomic, readwrite) NSArray *creationSite;
+@end
+
+@implementation KSPromiseStallReport
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: promise 0x%lx pending for %.3fs%@%@>",
+            NSStringFromClass([self class]), (unsigned long)self.promiseAddress, self.pendingDuration,
+            self.creationSite.count > 0 ? @", created at\n" : @"",
+            [self.creationSite componentsJoinedByString:@"\n"]];
+}
+
+@end
+
+
+typedef struct {
+    uintptr_t promise;
+    uint64_t pending;
+    uint32_t site;
+} KSStallCapture;
+
+static NSArray *KSStallReports(KSStallCapture *captures, NSUInteger count) {
+    NSMutableArray *reports = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        KSPromiseStallReport *report = [[KSPromiseStallReport alloc] init];
+        report.promiseAddress = captures[i].promise;
+        report.pendingDuration = KSClockInterval(captures[i].pending);
+        report.creationSite = KSCreationSiteSymbols(captures[i].site) ?: @[];
+        [reports addObject:report];
+    }
+    return reports;
+}
+
+// Copies out records pending longer than the threshold. With markReported,
+// only records not reported before are returned.
+static NSArray *KSMetricsCollectStalls(uint64_t threshold, BOOL markReported) {
+    if (threshold == 0) {
+        return @[];
+    }
+    KSMetricsInitialize();
+    uint64_t now = KSClockNow();
+    NSUInteger capacity = 16;
+    NSUInteger count = 0;
+    KSStallCapture *captures = malloc(capacity * sizeof(KSStallCapture));
+
+    for (NSUInteger i = 0; i < KS_METRICS_SHARDS; i++) {
+        KSMetricsWatchList *list = &ks_watchLists[i];
+        pthread_mutex_lock(&list->lock);
+        for (KSMetricsRecord *record = list->head; record; record = record->next) {
+            if (now - record->createdAt < threshold || (markReported && record->reported)) {
+                continue;
+            }
+            if (markReported) {
+                record->reported = YES;
+            }
+            if (count == capacity) {
+                capacity *= 2;
+                captures = realloc(captures, capacity * sizeof(KSStallCapture));
+            }
+            KSStallCapture *capture = &captures[count++];
+            capture->promise = record->promise;
+            capture->pending = now - record->createdAt;
+            capture->site = record->creationSite;
+        }
+        pthread_mutex_unlock(&list->lock);
+    }
+
+    NSArray *reports = KSStallReports(captures, count);
+    free(captures);
+    return reports;
+}
+
+static void KSMetricsWatchdogFire(void) {
+    pthread_mutex_lock(&ks_settingsLock);
+    void (^handler)(KSPromiseStallReport *) = ks_stallHandler;
+    pthread_mutex_unlock(&ks_settingsLock);
+
+    NSArray *reports = KSMetricsCollectStalls(atomic_load(&ks_stallThreshold), YES);
+    if (handler) {
+        for (KSPromiseStallReport *report in reports) {
+            handler(report);
+        }
+    }
+}
+
+
+#pragma mark - Hooks
+
+KSMetricsRecord *KSMetricsPromiseCreated(void *promise, uint32_t creationSite) {
+    KSMetricsRecord *record = calloc(1, sizeof(KSMetricsRecord));
+    if (!record) {
+        return NULL;
+    }
+    record->createdAt = KSClockNow();
+    record->promise = (uintptr_t)promise;
+    record->watchList = -1;
+    record->creationSite = creationSite;
+    KSMetricsAdd(KSMetricsCounterCreated, 1);
+
+    if (atomic_load_explicit(&ks_stallThreshold, memory_order_relaxed) > 0) {
+        KSMetricsWatch(record);
+    }
+    return record;
+}
+
+void KSMetricsContinuationQueued(KSMetricsRecord *record, BOOL pending) {
+    KSMetricsAdd(KSMetricsCounterContinuationsQueued, 1);
+    if (pending) {
+        record->waiting++;
+    }
+}
+
+void KSMetricsPromiseSettled(KSMetricsRecord *record) {
+    record->settledAt = KSClockNow();
+    // continuations registered so far are about to run rather than be dropped
+    record->waiting = 0;
+    KSMetricsAdd(KSMetricsCounterSettled, 1);
+    KSHistogramRecord(KSMetricsHistogramPending, record->settledAt - record->createdAt);
+    KSMetricsUnwatch(record);
+}
+
+void KSMetricsPromiseCancelled(KSMetricsRecord *record) {
+    KSMetricsAdd(KSMetricsCounterContinuationsDropped, record->waiting);
+    record->waiting = 0;
+}
+
+void KSMetricsContinuationRan(KSMetricsRecord *record, uint64_t start) {
+    uint64_t end = KSClockNow();
+    KSMetricsAdd(KSMetricsCounterContinuationsRun, 1);
+    if (record->settledAt != 0 && start >= record->settledAt) {
+        KSHistogramRecord(KSMetricsHistogramResolveToCallback, start - record->settledAt);
+    }
+    KSHistogramRecord(KSMetricsHistogramCallbackExecution, end - start);
+}
+
+void KSMetricsPromiseDeallocated(KSMetricsRecord *record, BOOL pending) {
+    KSMetricsAdd(KSMetricsCounterDeallocated, 1);
+    if (pending) {
+        KSMetricsAdd(KSMetricsCounterDeallocatedPending, 1);
+        KSMetricsAdd(KSMetricsCounterContinuationsDropped, record->waiting);
+    }
+    KSMetricsUnwatch(record);
+    free(record);
+}
+
+
+#pragma mark - Snapshots
+
+@interface KSPromiseMetricsHistogram () {
+    uint64_t _buckets[KS_HISTOGRAM_BUCKETS];
+    uint64_t _sum;
+}
+@end
+
+@implementation KSPromiseMetricsHistogram
+
+- (instancetype)initWithKind:(KSMetricsHistogramKind)kind {
+    self = [super init];
+    if (self) {
+        for (NSUInteger shard = 0; shard < KS_METRICS_SHARDS; shard++) {
+            KSMetricsHistogramShard *histogram = &ks_shards[shard].histograms[kind];
+            for (NSUInteger i = 0; i < KS_HISTOGRAM_BUCKETS; i++) {
+                uint64_t count = atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+                _buckets[i] += count;
+                _count += count;
+            }
+            _sum += atomic_load_explicit(&histogram->sum, memory_order_relaxed);
+        }
+    }
+    return self;
+}
+
+// Highest value that lands in the bucket.
+- (NSTimeInterval)bucketEnd:(NSUInteger)bucket {
+    uint64_t end = bucket + 1 < KS_HISTOGRAM_BUCKETS ? KSHistogramBucketStart(bucket + 1) - 1 : KSHistogramBucketStart(bucket) * 2;
+    return KSClockInterval(end);
+}
+
+- (NSTimeInterval)minimum {
+    for (NSUInteger i = 0; i < KS_HISTOGRAM_BUCKETS; i++) {
+        if (_buckets[i] > 0) {
+            return KSClockInterval(KSHistogramBucketStart(i));
+        }
+    }
+    return 0;
+}
+
+- (NSTimeInterval)maximum {
+    for (NSUInteger i = KS_HISTOGRAM_BUCKETS; i > 0; i--) {
+        if (_buckets[i - 1] > 0) {
+            return [self bucketEnd:i - 1];
+        }
+    }
+    return 0;
+}
+
+- (NSTimeInterval)mean {
+    return _count > 0 ? KSClockInterval(_sum) / _count : 0;
+}
+
+- (NSTimeInterval)valueAtPercentile:(double)percentile {
+    if (_count == 0) {
+        return 0;
+    }
+    uint64_t target = (uint64_t)ceil(MIN(MAX(percentile, 0.0), 100.0) / 100.0 * _count);
+    target = MAX(target, (uint64_t)1);
+    uint64_t seen = 0;
+    for (NSUInteger i = 0; i < KS_HISTOGRAM_BUCKETS; i++) {
+        seen += _buckets[i];
+        if (seen >= target) {
+            return [self bucketEnd:i];
+        }
+    }
+    return self.maximum;
+}
+
+- (NSDictionary *)dictionaryRepresentation {
+    return @{@"count": @(self.count),
+             @"min": @(self.minimum),
+             @"mean": @(self.mean),
+             @"p50": @([self valueAtPercentile:50]),
+             @"p90": @([self valueAtPercentile:90]),
+             @"p99": @([self valueAtPercentile:99]),
+             @"p999": @([self valueAtPercentile:99.9]),
+             @"max": @(self.maximum)};
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %llu samples, p50 %.3fms, p99 %.3fms, max %.3fms>",
+            NSStringFromClass([self class]), (unsigned long long)self.count,
+            [self valueAtPercentile:50] * 1000.0, [self valueAtPercentile:99] * 1000.0, self.maximum * 1000.0];
+}
+
+@end
+
+
+@interface KSPromiseMetricsSnapshot ()
+@property (nonatomic, readwrite) uint64_t createdCount;
+@property (nonatomic, readwrite) uint64_t liveCount;
+@property (nonatomic, readwrite) uint64_t pendingCount;
+@property (nonatomic, readwrite) uint64_t continuationQueueDepth;
+@property (strong, nonatomic, readwrite) KSPromiseMetricsHistogram *resolveToCallbackTime;
+@property (strong, nonatomic, readwrite) KSPromiseMetricsHistogram *callbackExecutionTime;
+@property (strong, nonatomic, readwrite) KSPromiseMetricsHistogram *pendingTime;
+@property (strong, nonatomic, readwrite) NSArray *stalledPromises;
+@end
+
+@implementation KSPromiseMetricsSnapshot
+
+- (NSDictionary *)dictionaryRepresentation {
+    return @{@"created": @(self.createdCount),
+             @"live": @(self.liveCount),
+             @"pending": @(self.pendingCount),
+             @"continuationQueueDepth": @(self.continuationQueueDepth),
+             @"resolveToCallbackTime": [self.resolveToCallbackTime dictionaryRepresentation],
+             @"callbackExecutionTime": [self.callbackExecutionTime dictionaryRepresentation],
+             @"pendingTime": [self.pendingTime dictionaryRepresentation],
+             @"stalled": @(self.stalledPromises.count)};
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %llu live, %llu pending, %llu queued continuations, %lu stalled>",
+            NSStringFromClass([self class]), (unsigned long long)self.liveCount,
+            (unsigned long long)self.pendingCount, (unsigned long long)self.continuationQueueDepth,
+            (unsigned long)self.stalledPromises.count];
+}
+
+@end
+
+
+static inline uint64_t KSMetricsDifference(uint64_t minuend, uint64_t subtrahend) {
+    // shards are read one after another, so a gauge can briefly look negative
+    return minuend > subtrahend ? minuend - subtrahend : 0;
+}
+
+@implementation KSPromiseMetrics
+
++ (void)start {
+    KSMetricsInitialize();
+    atomic_store(&KSMetricsEnabled, true);
+}
+
++ (void)stop {
+    atomic_store(&KSMetricsEnabled, false);
+}
+
++ (BOOL)isEnabled {
+    return atomic_load(&KSMetricsEnabled);
+}
+
+// Live, pending and queue depth are gauges and survive a reset.
++ (void)reset {
+    for (NSUInteger shard = 0; shard < KS_METRICS_SHARDS; shard++) {
+        for (NSUInteger kind = 0; kind < KSMetricsHistogramCount; kind++) {
+            KSMetricsHistogramShard *histogram = &ks_shards[shard].histograms[kind];
+            for (NSUInteger i = 0; i < KS_HISTOGRAM_BUCKETS; i++) {
+                atomic_store_explicit(&histogram->buckets[i], 0, memory_order_relaxed);
+            }
+            atomic_store_explicit(&histogram->sum, 0, memory_order_relaxed);
+        }
+    }
+}
+
++ (KSPromiseMetricsSnapshot *)snapshot {
+    uint64_t counters[KSMetricsCounterCount] = {0};
+    for (NSUInteger shard = 0; shard < KS_METRICS_SHARDS; shard++) {
+        for (NSUInteger counter = 0; counter < KSMetricsCounterCount; counter++) {
+            counters[counter] += atomic_load_explicit(&ks_shards[shard].counters[counter], memory_order_relaxed);
+        }
+    }
+
+    KSPromiseMetricsSnapshot *snapshot = [[KSPromiseMetricsSnapshot alloc] init];
+    snapshot.createdCount = counters[KSMetricsCounterCreated];
+    snapshot.liveCount = KSMetricsDifference(counters[KSMetricsCounterCreated], counters[KSMetricsCounterDeallocated]);
+    snapshot.pendingCount = KSMetricsDifference(counters[KSMetricsCounterCreated],
+                                                counters[KSMetricsCounterSettled] + counters[KSMetricsCounterDeallocatedPending]);
+    snapshot.continuationQueueDepth = KSMetricsDifference(counters[KSMetricsCounterContinuationsQueued],
+                                                          counters[KSMetricsCounterContinuationsRun] + counters[KSMetricsCounterContinuationsDropped]);
+    snapshot.resolveToCallbackTime = [[KSPromiseMetricsHistogram alloc] initWithKind:KSMetricsHistogramResolveToCallback];
+    snapshot.callbackExecutionTime = [[KSPromiseMetricsHistogram alloc] initWithKind:KSMetricsHistogramCallbackExecution];
+    snapshot.pendingTime = [[KSPromiseMetricsHistogram alloc] initWithKind:KSMetricsHistogramPending];
+    snapshot.stalledPromises = KSMetricsCollectStalls(atomic_load(&ks_stallThreshold), NO);
+    return snapshot;
+}
+
++ (NSTimeInterval)stallThreshold {
+    return KSClockInterval(atomic_load(&ks_stallThreshold));
+}
+
++ (void)setStallThreshold:(NSTimeInterval)stallThreshold {
+    KSMetricsInitialize();
+    uint64_t threshold = stallThreshold > 0 ? (uint64_t)(stallThreshold * NSEC_PER_SEC) : 0;
+
+    pthread_mutex_lock(&ks_settingsLock);
+    atomic_store(&ks_stallThreshold, threshold);
+    if (ks_watchdogTimer) {
+        dispatch_source_cancel(ks_watchdogTimer);
+        ks_watchdogTimer = nil;
+    }
+    if (threshold > 0) {
+        uint64_t interval = MAX(threshold / 2, 10 * NSEC_PER_MSEC);
+        dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0);
+        ks_watchdogTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, queue);
+        dispatch_source_set_timer(ks_watchdogTimer, dispatch_time(DISPATCH_TIME_NOW, interval), interval, interval / 10);
+        dispatch_source_set_event_handler(ks_watchdogTimer, ^{
+            KSMetricsWatchdogFire();
+        });
+        dispatch_resume(ks_watchdogTimer);
+    }
+    pthread_mutex_unlock(&ks_settingsLock);
+}
+
++ (void)setStallHandler:(void (^)(KSPromiseStallReport *))stallHandler {
+    pthread_mutex_lock(&ks_settingsLock);
+    ks_stallHandler = [stallHandler copy];
+    pthread_mutex_unlock(&ks_settingsLock);
+}
+
+@end
@@ -0,0 +1,35 @@
+#import <Foundation/Foundation.h>
+#import "KSPromise.h"
+#import "KSExecutor.h"
+#import "KSNullabilityCompat.h"
+#import "KSGenericsCompat.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// A chain of then:error: stages built once and applied to any number of
+// promises. Applying it adds a single child promise to the source and runs
+// the stages back to back in its callback, where a chain of then: calls adds
+// a child promise and a continuation per stage.
+//
+// Stages route values and errors exactly as then:error: does: a nil callback
+// passes the result through, returning an NSError rejects, and returning a
+// promise waits for it before the remaining stages run.
+//
+// Pipelines are immutable; each builder method returns a new one.
+@interface KSPromisePipeline : NSObject
+
++ (instancetype)pipeline;
+
+- (KSPromisePipeline *)then:(nullable promiseValueCallback)fulfilledCallback error:(nullable promiseErrorCallback)errorCallback;
+- (KSPromisePipeline *)then:(promiseValueCallback)fulfilledCallback;
+- (KSPromisePipeline *)error:(promiseErrorCallback)errorCallback;
+
+@property (nonatomic, readonly) NSUInteger stageCount;
+
+- (KSPromise *)applyToPromise:(KSPromise *)promise;
+// The stages run on executor, as with then:error:onExecutor:.
+- (KSPromise *)applyToPromise:(KSPromise *)promise onExecutor:(nullable id<KSExecutor>)executor;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,94 @@
+#import "KSPromisePipeline.h"
+
+
+@interface KSPromisePipelineStage : NSObject
+@property (copy, nonatomic) promiseValueCallback fulfilledCallback;
+@property (copy, nonatomic) promiseErrorCallback errorCallback;
+@end
+
+@implementation KSPromisePipelineStage
+@end
+
+
+// Runs stages from index on, settling between stages the way a child promise
+// would: a promise is waited on and an NSError rejects, even when passed
+// through. The result goes back through then:error:, which rejects on an
+// NSError, so a rejected result is returned as the error itself.
+static id KSPromisePipelineRun(NSArray *stages, NSUInteger index, id result, BOOL rejected) {
+    NSUInteger count = stages.count;
+    for (; index < count; index++) {
+        KSPromisePipelineStage *stage = stages[index];
+        if (rejected) {
+            if (stage.errorCallback) {
+                result = stage.errorCallback(result);
+            }
+        } else if (stage.fulfilledCallback) {
+            result = stage.fulfilledCallback(result);
+        }
+
+        if ([result isKindOfClass:[KSPromise class]]) {
+            if (index + 1 == count) {
+                return result;
+            }
+            // the rest of the stages wait for the returned promise
+            NSUInteger next = index + 1;
+            return [(KSPromise *)result then:^id(id value) {
+                return KSPromisePipelineRun(stages, next, value, NO);
+            } error:^id(NSError *error) {
+                return KSPromisePipelineRun(stages, next, error, YES);
+            }];
+        }
+        rejected = [result isKindOfClass:[NSError class]];
+    }
+    return result;
+}
+
+
+@interface KSPromisePipeline ()
+@property (copy, nonatomic) NSArray *stages;
+@end
+
+@implementation KSPromisePipeline
+
++ (instancetype)pipeline {
+    KSPromisePipeline *pipeline = [[self alloc] init];
+    pipeline.stages = @[];
+    return pipeline;
+}
+
+- (KSPromisePipeline *)then:(promiseValueCallback)fulfilledCallback error:(promiseErrorCallback)errorCallback {
+    KSPromisePipelineStage *stage = [[KSPromisePipelineStage alloc] init];
+    stage.fulfilledCallback = fulfilledCallback;
+    stage.errorCallback = errorCallback;
+
+    KSPromisePipeline *pipeline = [[[self class] alloc] init];
+    pipeline.stages = [self.stages arrayByAddingObject:stage];
+    return pipeline;
+}
+
+- (KSPromisePipeline *)then:(promiseValueCallback)fulfilledCallback {
+    return [self then:fulfilledCallback error:nil];
+}
+
+- (KSPromisePipeline *)error:(promiseErrorCallback)errorCallback {
+    return [self then:nil error:errorCallback];
+}
+
+- (NSUInteger)stageCount {
+    return self.stages.count;
+}
+
+- (KSPromise *)applyToPromise:(KSPromise *)promise {
+    return [self applyToPromise:promise onExecutor:nil];
+}
+
+- (KSPromise *)applyToPromise:(KSPromise *)promise onExecutor:(id<KSExecutor>)executor {
+    NSArray *stages = self.stages;
+    return [promise then:^id(id value) {
+        return KSPromisePipelineRun(stages, 0, value, NO);
+    } error:^id(NSError *error) {
+        return KSPromisePipelineRun(stages, 0, error, YES);
+    } onExecutor:executor];
+}
+
+@end
@@ -0,0 +1,34 @@
+#import <Foundation/Foundation.h>
+#import "KSNullabilityCompat.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Opt-in recording of promise lifecycles: creation, then: registration,
+// resolve/reject, callback start/end, cancel and +when: parents. Each thread
+// records into its own fixed-size ring, so the oldest events are overwritten
+// once a thread has recorded ringCapacity of them.
+//
+// Only promises created after +start are traced. The export is Chrome trace
+// event JSON (chrome://tracing, Perfetto): every promise is an async span from
+// creation to settlement, callbacks are slices on the thread that ran them,
+// and parent/child links are carried in the event args and as flow events.
+@interface KSPromiseTracing : NSObject
+
+// Events each thread keeps.
++ (NSUInteger)ringCapacity;
+
++ (void)start;
++ (void)stop;
++ (BOOL)isEnabled;
+
+// Drops everything recorded so far.
++ (void)reset;
+
+// Best taken after +stop; events a thread overwrites during the export are
+// left out.
++ (NSData *)chromeTraceData;
++ (BOOL)writeChromeTraceToURL:(NSURL *)url error:(NSError **)error;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,336 @@
+#import "KSPromiseTracing.h"
+#import "KSTrace.h"
+#import "KSClock.h"
+#import "KSCreationSites.h"
+#import <execinfo.h>
+#import <pthread.h>
+
+#if defined(__linux__)
+#import <sys/syscall.h>
+#import <unistd.h>
+#endif
+
+
+#define KS_TRACE_RING_CAPACITY 4096
+
+// Written only by the thread that owns it. The exporter reads events below
+// head and treats anything older than head - capacity as overwritten. Rings
+// are never freed; when a thread exits its ring is handed to the next thread
+// that starts recording.
+typedef struct KSTraceRing {
+    struct KSTraceRing *next;
+    atomic_bool owned;
+    atomic_uint_fast64_t head;
+    atomic_uint_fast64_t tail;
+    KSTraceEventRecord events[KS_TRACE_RING_CAPACITY];
+} KSTraceRing;
+
+#if KS_PROMISE_TRACING
+
+atomic_bool KSTraceEnabled;
+
+static atomic_uint_fast64_t ks_nextIdentifier = 1;
+static _Atomic(KSTraceRing *) ks_rings;
+static __thread KSTraceRing *ks_threadRing;
+static __thread uint32_t ks_threadIdentifier;
+static pthread_key_t ks_ringKey;
+
+static void KSTraceRingRelease(void *ring) {
+    atomic_store(&((KSTraceRing *)ring)->owned, false);
+}
+
+static uint32_t KSTraceCurrentThread(void) {
+#if defined(__APPLE__)
+    uint64_t thread;
+    pthread_threadid_np(NULL, &thread);
+    return (uint32_t)thread;
+#elif defined(__linux__)
+    return (uint32_t)syscall(SYS_gettid);
+#else
+    return (uint32_t)(uintptr_t)pthread_self();
+#endif
+}
+
+static KSTraceRing *KSTraceRingClaim(void) {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pthread_key_create(&ks_ringKey, KSTraceRingRelease);
+    });
+
+    KSTraceRing *ring = NULL;
+    for (KSTraceRing *candidate = atomic_load(&ks_rings); candidate; candidate = candidate->next) {
+        bool owned = false;
+        if (atomic_compare_exchange_strong(&candidate->owned, &owned, true)) {
+            ring = candidate;
+            break;
+        }
+    }
+    if (!ring) {
+        ring = calloc(1, sizeof(KSTraceRing));
+        if (!ring) {
+            return NULL;
+        }
+        atomic_store(&ring->owned, true);
+        KSTraceRing *head = atomic_load(&ks_rings);
+        do {
+            ring->next = head;
+        } while (!atomic_compare_exchange_weak(&ks_rings, &head, ring));
+    }
+    pthread_setspecific(ks_ringKey, ring);
+    ks_threadIdentifier = KSTraceCurrentThread();
+    return ring;
+}
+
+uint64_t KSTraceNextIdentifier(void) {
+    return atomic_fetch_add_explicit(&ks_nextIdentifier, 1, memory_order_relaxed);
+}
+
+void KSTraceRecord(KSTraceEventType type, uint64_t identifier, uint64_t related, uint32_t stack) {
+    KSTraceRing *ring = ks_threadRing;
+    if (!ring) {
+        ring = ks_threadRing = KSTraceRingClaim();
+        if (!ring) {
+            return;
+        }
+    }
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    KSTraceEventRecord *event = &ring->events[head % KS_TRACE_RING_CAPACITY];
+    event->timestamp = KSClockNow();
+    event->identifier = identifier;
+    event->related = related;
+    event->thread = ks_threadIdentifier;
+    event->type = type;
+    event->stack = stack;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+KSTraceEventRecord *KSTraceCopyEvents(size_t *count) {
+    size_t capacity = KS_TRACE_RING_CAPACITY;
+    size_t allocated = capacity;
+    size_t used = 0;
+    KSTraceEventRecord *events = malloc(allocated * sizeof(KSTraceEventRecord));
+    for (KSTraceRing *ring = atomic_load(&ks_rings); ring && events; ring = ring->next) {
+        if (allocated - used < capacity) {
+            KSTraceEventRecord *grown = realloc(events, allocated * 2 * sizeof(KSTraceEventRecord));
+            if (!grown) {
+                break;
+            }
+            events = grown;
+            allocated *= 2;
+        }
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        uint64_t start = MAX(atomic_load(&ring->tail), head > capacity ? head - capacity : 0);
+        for (uint64_t i = start; i < head; i++) {
+            events[used + (i - start)] = ring->events[i % capacity];
+        }
+        // anything the owner wrote over while we copied is unreliable
+        uint64_t after = atomic_load_explicit(&ring->head, memory_order_acquire);
+        uint64_t valid = after > capacity ? MAX(start, after - capacity) : start;
+        if (valid > start && valid < head) {
+            memmove(&events[used], &events[used + (valid - start)], (head - valid) * sizeof(KSTraceEventRecord));
+        }
+        used += valid < head ? head - valid : 0;
+    }
+    *count = events ? used : 0;
+    return events;
+}
+
+#else
+
+uint64_t KSTraceNextIdentifier(void) {
+    return 0;
+}
+
+void KSTraceRecord(KSTraceEventType type, uint64_t identifier, uint64_t related, uint32_t stack) {
+}
+
+KSTraceEventRecord *KSTraceCopyEvents(size_t *count) {
+    *count = 0;
+    return NULL;
+}
+
+#endif
+
+
+static NSString *KSTraceIdentifierString(uint64_t identifier) {
+    return [NSString stringWithFormat:@"0x%llx", (unsigned long long)identifier];
+}
+
+static NSDictionary *KSTraceEventJSON(KSTraceEventRecord *event) {
+    NSMutableDictionary *json = [NSMutableDictionary dictionary];
+    json[@"pid"] = @([[NSProcessInfo processInfo] processIdentifier]);
+    json[@"tid"] = @(event->thread);
+    json[@"ts"] = @((double)event->timestamp / 1000.0);
+    json[@"cat"] = @"promise";
+
+    NSString *identifier = KSTraceIdentifierString(event->identifier);
+    NSString *related = KSTraceIdentifierString(event->related);
+    switch (event->type) {
+        case KSTraceEventCreate:
+            json[@"ph"] = @"b";
+            json[@"name"] = @"promise";
+            json[@"id"] = identifier;
+            break;
+        case KSTraceEventThen:
+            json[@"ph"] = @"n";
+            json[@"name"] = @"then";
+            json[@"id"] = identifier;
+            json[@"args"] = @{@"child": related};
+            break;
+        case KSTraceEventResolve:
+        case KSTraceEventReject:
+            json[@"ph"] = @"e";
+            json[@"name"] = @"promise";
+            json[@"id"] = identifier;
+            json[@"args"] = @{@"state": event->type == KSTraceEventResolve ? @"fulfilled" : @"rejected"};
+            break;
+        case KSTraceEventCallbackBegin:
+        case KSTraceEventCallbackEnd:
+            json[@"ph"] = event->type == KSTraceEventCallbackBegin ? @"B" : @"E";
+            json[@"name"] = @"callback";
+            json[@"args"] = @{@"promise": identifier, @"child": related};
+            break;
+        case KSTraceEventCancel:
+            json[@"ph"] = @"n";
+            json[@"name"] = @"cancel";
+            json[@"id"] = identifier;
+            break;
+        case KSTraceEventWhenParent:
+            json[@"ph"] = @"n";
+            json[@"name"] = @"when";
+            json[@"id"] = identifier;
+            json[@"args"] = @{@"parent": related};
+            break;
+        case KSTraceEventAdopt:
+            json[@"ph"] = @"n";
+            json[@"name"] = @"adopt";
+            json[@"id"] = identifier;
+            json[@"args"] = @{@"promise": related};
+            break;
+        case KSTraceEventNetwork:
+            json[@"ph"] = @"n";
+            json[@"name"] = @"network";
+            json[@"id"] = identifier;
+            break;
+    }
+    return json;
+}
+
+// Flow arrow from the then: registration to the callback that settles the child.
+static NSDictionary *KSTraceFlowJSON(KSTraceEventRecord *event) {
+    BOOL start = event->type == KSTraceEventThen;
+    NSMutableDictionary *json = [NSMutableDictionary dictionary];
+    json[@"pid"] = @([[NSProcessInfo processInfo] processIdentifier]);
+    json[@"tid"] = @(event->thread);
+    json[@"ts"] = @((double)event->timestamp / 1000.0);
+    json[@"cat"] = @"promise";
+    json[@"name"] = @"then";
+    json[@"ph"] = start ? @"s" : @"f";
+    json[@"id"] = KSTraceIdentifierString(event->related);
+    if (!start) {
+        json[@"bp"] = @"e";
+    }
+    return json;
+}
+
+#define KS_TRACE_STACK_FRAMES 64
+
+// Adds the stack to the stackFrames trie, outermost frame first, so stacks
+// sharing callers share nodes. Returns the node of the innermost frame.
+static NSString *KSTraceStackFrameNode(uint32_t stack, NSMutableDictionary *leaves, NSMutableDictionary *nodes, NSMutableDictionary *stackFrames) {
+    NSString *leaf = leaves[@(stack)];
+    if (leaf) {
+        return leaf;
+    }
+    uintptr_t frames[KS_TRACE_STACK_FRAMES];
+    NSUInteger count = KSCreationSiteCopyFrames(stack, frames, KS_TRACE_STACK_FRAMES);
+    if (count == 0) {
+        return nil;
+    }
+    char **symbols = backtrace_symbols((void **)frames, (int)count);
+    NSString *parent = nil;
+    for (NSUInteger i = count; i-- > 0;) {
+        NSString *key = [NSString stringWithFormat:@"%@:%lx", parent ?: @"", (unsigned long)frames[i]];
+        NSString *node = nodes[key];
+        if (!node) {
+            node = [NSString stringWithFormat:@"%lu", (unsigned long)nodes.count + 1];
+            NSString *name = symbols ? @(symbols[i]) : [NSString stringWithFormat:@"0x%lx", (unsigned long)frames[i]];
+            stackFrames[node] = parent ? @{@"name": name, @"parent": parent} : @{@"name": name};
+            nodes[key] = node;
+        }
+        parent = node;
+    }
+    free(symbols);
+    leaves[@(stack)] = parent;
+    return parent;
+}
+
+
+@implementation KSPromiseTracing
+
++ (NSUInteger)ringCapacity {
+    return KS_TRACE_RING_CAPACITY;
+}
+
++ (void)start {
+#if KS_PROMISE_TRACING
+    atomic_store(&KSTraceEnabled, true);
+#endif
+}
+
++ (void)stop {
+#if KS_PROMISE_TRACING
+    atomic_store(&KSTraceEnabled, false);
+#endif
+}
+
++ (BOOL)isEnabled {
+#if KS_PROMISE_TRACING
+    return atomic_load(&KSTraceEnabled);
+#else
+    return NO;
+#endif
+}
+
++ (void)reset {
+#if KS_PROMISE_TRACING
+    for (KSTraceRing *ring = atomic_load(&ks_rings); ring; ring = ring->next) {
+        atomic_store(&ring->tail, atomic_load_explicit(&ring->head, memory_order_acquire));
+    }
+#endif
+}
+
++ (NSData *)chromeTraceData {
+    NSMutableArray *events = [NSMutableArray array];
+    NSMutableDictionary *leaves = [NSMutableDictionary dictionary];
+    NSMutableDictionary *nodes = [NSMutableDictionary dictionary];
+    NSMutableDictionary *stackFrames = [NSMutableDictionary dictionary];
+    size_t count;
+    KSTraceEventRecord *records = KSTraceCopyEvents(&count);
+    for (size_t i = 0; i < count; i++) {
+        KSTraceEventRecord *event = &records[i];
+        NSDictionary *json = KSTraceEventJSON(event);
+        NSString *frame = event->stack ? KSTraceStackFrameNode(event->stack, leaves, nodes, stackFrames) : nil;
+        if (frame) {
+            NSMutableDictionary *framed = [json mutableCopy];
+            framed[@"sf"] = frame;
+            json = framed;
+        }
+        [events addObject:json];
+        if (event->type == KSTraceEventThen || event->type == KSTraceEventCallbackBegin) {
+            [events addObject:KSTraceFlowJSON(event)];
+        }
+    }
+    free(records);
+    [events sortWithOptions:NSSortStable usingComparator:^NSComparisonResult(NSDictionary *a, NSDictionary *b) {
+        return [a[@"ts"] compare:b[@"ts"]];
+    }];
+    NSDictionary *trace = @{@"traceEvents": events, @"stackFrames": stackFrames, @"displayTimeUnit": @"ms"};
+    return [NSJSONSerialization dataWithJSONObject:trace options:0 error:NULL];
+}
+
++ (BOOL)writeChromeTraceToURL:(NSURL *)url error:(NSError **)error {
+    return [[self chromeTraceData] writeToURL:url options:NSDataWritingAtomic error:error];
+}
+
+@end
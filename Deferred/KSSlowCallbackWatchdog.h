@@ -0,0 +1,51 @@
+#import <Foundation/Foundation.h>
+#import "KSNullabilityCompat.h"
+#import "KSGenericsCompat.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// A then: or error: block that ran for longer than KSSlowCallbackWatchdog.threshold.
+@interface KSSlowCallbackReport : NSObject
+
+// NO while the callback is still running.
+@property (nonatomic, readonly) BOOL completed;
+// How long it ran, or had been running when the report was made.
+@property (nonatomic, readonly) NSTimeInterval duration;
+// The block's invoke function, which identifies the block literal.
+@property (nonatomic, readonly) uintptr_t callbackAddress;
+@property (copy, nonatomic, readonly) NSString *callbackSymbol;
+// Symbolicated stack of the callback's thread sampled while it was over the
+// threshold, innermost frame first. Empty unless a stackSampleSignal is set.
+@property (nonatomic, readonly) NSArray KS_GENERIC(NSString *) *runningStack;
+
+@end
+
+// Times every promise callback and reports the ones that block their thread.
+// Continuations run inline from resolveWithValue:, so one slow callback holds
+// up every other promise settling on the same thread.
+//
+// A callback still running past the threshold is reported once while it runs
+// and again when it finishes.
+@interface KSSlowCallbackWatchdog : NSObject
+
+// 0, the default, turns the watchdog off.
++ (NSTimeInterval)threshold;
++ (void)setThreshold:(NSTimeInterval)threshold;
+
+// Called on a private queue.
++ (void)setHandler:(nullable void (^)(KSSlowCallbackReport *report))handler;
+
+// A signal the watchdog sends to a thread stuck in a slow callback to sample
+// its stack by walking frame pointers. The handler is installed with
+// sigaction, so pick one the app doesn't otherwise use, e.g. SIGUSR2. 0, the
+// default, samples nothing.
++ (int)stackSampleSignal;
++ (void)setStackSampleSignal:(int)stackSampleSignal;
+
+// The most recent completed reports, oldest first.
++ (NSArray KS_GENERIC(KSSlowCallbackReport *) *)recentReports;
++ (void)reset;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,423 @@
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+#import "KSSlowCallbackWatchdog.h"
+#import "KSSlowCallbacks.h"
+#import "KSClock.h"
+#import <dlfcn.h>
+#import <execinfo.h>
+#import <pthread.h>
+#import <sched.h>
+#import <signal.h>
+#import <sys/ucontext.h>
+
+
+#define KS_SLOW_CALLBACK_FRAMES 32
+#define KS_SLOW_CALLBACK_RECENT_REPORTS 32
+// How long the watchdog waits for a signalled thread to take its sample.
+#define KS_SLOW_CALLBACK_SIGNAL_WAIT (10 * NSEC_PER_MSEC)
+
+// The start of the block ABI's Block_layout.
+typedef struct {
+    void *isa;
+    int flags;
+    int reserved;
+    const void *invoke;
+} KSBlockLayout;
+
+// One per thread that has run a callback while the watchdog was on. Like the
+// trace rings, slots are never freed and are handed on when their thread exits.
+typedef struct KSSlowCallbackSlot {
+    struct KSSlowCallbackSlot *next;
+    atomic_bool owned;
+    pthread_t thread;
+    // the thread's stack, which bounds the walk in the signal handler
+    uintptr_t stackLow;
+    uintptr_t stackHigh;
+    // the innermost running callback, 0 when idle
+    atomic_uint_fast64_t start;
+    _Atomic(const void *) invoke;
+    // the callbacks the watchdog last sampled and reported
+    atomic_uint_fast64_t noticedStart;
+    atomic_uint_fast64_t reportedStart;
+    // set while the watchdog may signal the thread, which must not leave the
+    // callback until it is clear
+    atomic_bool signalling;
+    // -1 while a sample is pending
+    atomic_int stackFrames;
+    void *stack[KS_SLOW_CALLBACK_FRAMES];
+} KSSlowCallbackSlot;
+
+
+atomic_bool KSSlowCallbacksEnabled;
+
+static atomic_uint_fast64_t ks_threshold;
+static atomic_int ks_sampleSignal;
+static struct sigaction ks_previousAction;
+static _Atomic(KSSlowCallbackSlot *) ks_slots;
+static __thread KSSlowCallbackSlot *ks_threadSlot;
+static pthread_key_t ks_slotKey;
+
+static pthread_mutex_t ks_settingsLock = PTHREAD_MUTEX_INITIALIZER;
+static dispatch_source_t ks_watchdogTimer;
+static void (^ks_handler)(KSSlowCallbackReport *report);
+static NSMutableArray *ks_recentReports;
+
+
+static void KSSlowCallbackSlotRelease(void *slot) {
+    atomic_store(&((KSSlowCallbackSlot *)slot)->owned, false);
+}
+
+static KSSlowCallbackSlot *KSSlowCallbackSlotClaim(void) {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pthread_key_create(&ks_slotKey, KSSlowCallbackSlotRelease);
+    });
+
+    KSSlowCallbackSlot *slot = NULL;
+    for (KSSlowCallbackSlot *candidate = atomic_load(&ks_slots); candidate; candidate = candidate->next) {
+        bool owned = false;
+        if (atomic_compare_exchange_strong(&candidate->owned, &owned, true)) {
+            slot = candidate;
+            break;
+        }
+    }
+    if (!slot) {
+        slot = calloc(1, sizeof(KSSlowCallbackSlot));
+        if (!slot) {
+            return NULL;
+        }
+        atomic_store(&slot->owned, true);
+        KSSlowCallbackSlot *head = atomic_load(&ks_slots);
+        do {
+            slot->next = head;
+        } while (!atomic_compare_exchange_weak(&ks_slots, &head, slot));
+    }
+    slot->thread = pthread_self();
+    slot->stackLow = 0;
+    slot->stackHigh = 0;
+#if defined(__APPLE__)
+    slot->stackHigh = (uintptr_t)pthread_get_stackaddr_np(slot->thread);
+    slot->stackLow = slot->stackHigh - pthread_get_stacksize_np(slot->thread);
+#else
+    pthread_attr_t attributes;
+    if (pthread_getattr_np(slot->thread, &attributes) == 0) {
+        void *address;
+        size_t size;
+        if (pthread_attr_getstack(&attributes, &address, &size) == 0) {
+            slot->stackLow = (uintptr_t)address;
+            slot->stackHigh = slot->stackLow + size;
+        }
+        pthread_attr_destroy(&attributes);
+    }
+#endif
+    pthread_setspecific(ks_slotKey, slot);
+    return slot;
+}
+
+// Follows the saved frame pointers up from frame, staying within the thread's
+// stack, and stores return addresses from index frames on. backtrace() isn't
+// async-signal-safe, as glibc's loads and locks its unwinder; this only reads
+// the stack. Frames built without frame pointers cut the walk short.
+static int KSSlowCallbackWalkStack(KSSlowCallbackSlot *slot, uintptr_t frame, int frames) {
+    while (frames < KS_SLOW_CALLBACK_FRAMES && frame % sizeof(void *) == 0 &&
+           frame >= slot->stackLow && frame + 2 * sizeof(void *) <= slot->stackHigh) {
+        uintptr_t next = ((uintptr_t *)frame)[0];
+        void *returnAddress = ((void **)frame)[1];
+        if (!returnAddress) {
+            break;
+        }
+        slot->stack[frames++] = returnAddress;
+        // callers' frames sit higher up the stack
+        if (next <= frame) {
+            break;
+        }
+        frame = next;
+    }
+    return frames;
+}
+
+// The program counter and frame pointer the signal interrupted. Returns NO
+// where the register layout isn't known.
+static BOOL KSSlowCallbackInterruptedFrame(void *context, uintptr_t *pc, uintptr_t *frame) {
+    ucontext_t *ucontext = context;
+#if defined(__linux__) && defined(__x86_64__)
+    *pc = (uintptr_t)ucontext->uc_mcontext.gregs[REG_RIP];
+    *frame = (uintptr_t)ucontext->uc_mcontext.gregs[REG_RBP];
+    return YES;
+#elif defined(__linux__) && defined(__aarch64__)
+    *pc = (uintptr_t)ucontext->uc_mcontext.pc;
+    *frame = (uintptr_t)ucontext->uc_mcontext.regs[29];
+    return YES;
+#elif defined(__APPLE__) && defined(__x86_64__)
+    *pc = (uintptr_t)ucontext->uc_mcontext->__ss.__rip;
+    *frame = (uintptr_t)ucontext->uc_mcontext->__ss.__rbp;
+    return YES;
+#elif defined(__APPLE__) && defined(__arm64__)
+    *pc = (uintptr_t)__darwin_arm_thread_state64_get_pc(ucontext->uc_mcontext->__ss);
+    *frame = (uintptr_t)__darwin_arm_thread_state64_get_fp(ucontext->uc_mcontext->__ss);
+    return YES;
+#else
+    (void)ucontext;
+    return NO;
+#endif
+}
+
+// Records the interrupted function as frame 0 and its callers after it. Where
+// the interrupted registers can't be read, the walk starts from this handler
+// instead, so the stack begins at the signal trampoline.
+static void KSSlowCallbackSignalHandler(int signalNumber, siginfo_t *info, void *context) {
+    KSSlowCallbackSlot *slot = ks_threadSlot;
+    if (!slot) {
+        return;
+    }
+    uintptr_t pc = 0;
+    uintptr_t frame = 0;
+    int frames = 0;
+    if (context && KSSlowCallbackInterruptedFrame(context, &pc, &frame)) {
+        slot->stack[frames++] = (void *)pc;
+    } else {
+        frame = (uintptr_t)__builtin_frame_address(0);
+    }
+    atomic_store(&slot->stackFrames, KSSlowCallbackWalkStack(slot, frame, frames));
+}
+
+
+@interface KSSlowCallbackReport ()
+@property (nonatomic, readwrite) BOOL completed;
+@property (nonatomic, readwrite) NSTimeInterval duration;
+@property (nonatomic, readwrite) uintptr_t callbackAddress;
+@property (copy, nonatomic, readwrite) NSString *callbackSymbol;
+@property (nonatomic, readwrite) NSArray *runningStack;
+@end
+
+@implementation KSSlowCallbackReport
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %@ %@ for %.3fs%@%@>",
+            NSStringFromClass([self class]), self.callbackSymbol,
+            self.completed ? @"ran" : @"has been running", self.duration,
+            self.runningStack.count > 0 ? @", sampled at\n" : @"",
+            [self.runningStack componentsJoinedByString:@"\n"]];
+}
+
+@end
+
+
+static NSString *KSSlowCallbackSymbol(const void *invoke) {
+    Dl_info info;
+    if (invoke && dladdr(invoke, &info) && info.dli_sname) {
+        const char *image = info.dli_fname ? strrchr(info.dli_fname, '/') : NULL;
+        return [NSString stringWithFormat:@"%s + %lu (%s)", info.dli_sname,
+                (unsigned long)((uintptr_t)invoke - (uintptr_t)info.dli_saddr),
+                image ? image + 1 : (info.dli_fname ?: "?")];
+    }
+    return [NSString stringWithFormat:@"0x%lx", (unsigned long)(uintptr_t)invoke];
+}
+
+static KSSlowCallbackReport *KSSlowCallbackMakeReport(BOOL completed, uint64_t duration, const void *invoke,
+                                                      void **stack, int frames) {
+    KSSlowCallbackReport *report = [[KSSlowCallbackReport alloc] init];
+    report.completed = completed;
+    report.duration = KSClockInterval(duration);
+    report.callbackAddress = (uintptr_t)invoke;
+    report.callbackSymbol = KSSlowCallbackSymbol(invoke);
+    NSMutableArray *symbols = [NSMutableArray array];
+    if (frames > 0) {
+        char **names = backtrace_symbols(stack, frames);
+        for (int i = 0; names && i < frames; i++) {
+            [symbols addObject:@(names[i])];
+        }
+        free(names);
+    }
+    report.runningStack = symbols;
+    return report;
+}
+
+static void KSSlowCallbackDeliver(KSSlowCallbackReport *report) {
+    pthread_mutex_lock(&ks_settingsLock);
+    void (^handler)(KSSlowCallbackReport *) = ks_handler;
+    if (report.completed) {
+        if (!ks_recentReports) {
+            ks_recentReports = [NSMutableArray array];
+        }
+        [ks_recentReports addObject:report];
+        if (ks_recentReports.count > KS_SLOW_CALLBACK_RECENT_REPORTS) {
+            [ks_recentReports removeObjectAtIndex:0];
+        }
+    }
+    pthread_mutex_unlock(&ks_settingsLock);
+    if (handler) {
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0), ^{
+            handler(report);
+        });
+    }
+}
+
+
+#pragma mark - Hooks
+
+void KSSlowCallbackBegin(KSSlowCallbackFrame *frame, id block) {
+    if (!block) {
+        return;
+    }
+    KSSlowCallbackSlot *slot = ks_threadSlot;
+    if (!slot) {
+        slot = ks_threadSlot = KSSlowCallbackSlotClaim();
+        if (!slot) {
+            return;
+        }
+    }
+    frame->invoke = ((__bridge KSBlockLayout *)block)->invoke;
+    frame->previousStart = atomic_load_explicit(&slot->start, memory_order_relaxed);
+    frame->previousInvoke = atomic_load_explicit(&slot->invoke, memory_order_relaxed);
+    frame->start = KSClockNow();
+    atomic_store_explicit(&slot->invoke, frame->invoke, memory_order_relaxed);
+    atomic_store_explicit(&slot->start, frame->start, memory_order_release);
+}
+
+void KSSlowCallbackEnd(KSSlowCallbackFrame *frame) {
+    KSSlowCallbackSlot *slot = ks_threadSlot;
+    uint64_t duration = KSClockNow() - frame->start;
+
+    atomic_store(&slot->start, frame->previousStart);
+    atomic_store_explicit(&slot->invoke, frame->previousInvoke, memory_order_relaxed);
+    while (atomic_load(&slot->signalling)) {
+        sched_yield();
+    }
+
+    uint64_t threshold = atomic_load_explicit(&ks_threshold, memory_order_relaxed);
+    if (threshold == 0 || duration < threshold) {
+        return;
+    }
+    int frames = 0;
+    void *stack[KS_SLOW_CALLBACK_FRAMES];
+    if (atomic_load(&slot->noticedStart) == frame->start) {
+        frames = MAX(atomic_load(&slot->stackFrames), 0);
+        memcpy(stack, slot->stack, frames * sizeof(void *));
+    }
+    KSSlowCallbackDeliver(KSSlowCallbackMakeReport(YES, duration, frame->invoke, stack, frames));
+}
+
+
+#pragma mark - Watchdog
+
+// Reports each callback over the threshold once while it runs. With a sample
+// signal set, the first tick that notices the callback signals its thread and
+// the next one reports, with the stack if the thread has answered by then.
+static void KSSlowCallbackWatchdogFire(void) {
+    uint64_t threshold = atomic_load(&ks_threshold);
+    int sampleSignal = atomic_load(&ks_sampleSignal);
+    uint64_t now = KSClockNow();
+    for (KSSlowCallbackSlot *slot = atomic_load(&ks_slots); slot; slot = slot->next) {
+        uint64_t start = atomic_load_explicit(&slot->start, memory_order_acquire);
+        if (start == 0 || now - start < threshold || atomic_load(&slot->reportedStart) == start) {
+            continue;
+        }
+        const void *invoke = atomic_load_explicit(&slot->invoke, memory_order_relaxed);
+        if (sampleSignal != 0 && atomic_load(&slot->noticedStart) != start) {
+            atomic_store(&slot->noticedStart, start);
+            atomic_store(&slot->stackFrames, -1);
+            atomic_store(&slot->signalling, true);
+            // A thread leaving its callback waits in KSSlowCallbackEnd while
+            // signalling is set. Signals are delivered asynchronously, so it
+            // stays set until the handler has stored the sample, or for at most
+            // KS_SLOW_CALLBACK_SIGNAL_WAIT, which is as long as a callback that
+            // ends meanwhile is held up. A sample that comes later may be from
+            // after the callback.
+            if (atomic_load(&slot->start) == start && pthread_kill(slot->thread, sampleSignal) == 0) {
+                uint64_t deadline = KSClockNow() + KS_SLOW_CALLBACK_SIGNAL_WAIT;
+                while (atomic_load(&slot->stackFrames) < 0 && KSClockNow() < deadline) {
+                    sched_yield();
+                }
+            }
+            atomic_store(&slot->signalling, false);
+            continue;
+        }
+        void *stack[KS_SLOW_CALLBACK_FRAMES];
+        int frames = 0;
+        if (atomic_load(&slot->noticedStart) == start) {
+            frames = MAX(atomic_load(&slot->stackFrames), 0);
+            memcpy(stack, slot->stack, frames * sizeof(void *));
+        }
+        atomic_store(&slot->reportedStart, start);
+        KSSlowCallbackDeliver(KSSlowCallbackMakeReport(NO, now - start, invoke, stack, frames));
+    }
+}
+
+
+@implementation KSSlowCallbackWatchdog
+
++ (NSTimeInterval)threshold {
+    return KSClockInterval(atomic_load(&ks_threshold));
+}
+
++ (void)setThreshold:(NSTimeInterval)threshold {
+    uint64_t nanoseconds = threshold > 0 ? (uint64_t)(threshold * NSEC_PER_SEC) : 0;
+
+    pthread_mutex_lock(&ks_settingsLock);
+    atomic_store(&ks_threshold, nanoseconds);
+    atomic_store(&KSSlowCallbacksEnabled, nanoseconds > 0);
+    if (ks_watchdogTimer) {
+        dispatch_source_cancel(ks_watchdogTimer);
+        ks_watchdogTimer = nil;
+    }
+    if (nanoseconds > 0) {
+        uint64_t interval = MAX(nanoseconds / 2, NSEC_PER_MSEC);
+        dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0);
+        ks_watchdogTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, queue);
+        dispatch_source_set_timer(ks_watchdogTimer, dispatch_time(DISPATCH_TIME_NOW, interval), interval, interval / 10);
+        dispatch_source_set_event_handler(ks_watchdogTimer, ^{
+            KSSlowCallbackWatchdogFire();
+        });
+        dispatch_resume(ks_watchdogTimer);
+    }
+    pthread_mutex_unlock(&ks_settingsLock);
+}
+
++ (void)setHandler:(void (^)(KSSlowCallbackReport *))handler {
+    pthread_mutex_lock(&ks_settingsLock);
+    ks_handler = [handler copy];
+    pthread_mutex_unlock(&ks_settingsLock);
+}
+
++ (int)stackSampleSignal {
+    return atomic_load(&ks_sampleSignal);
+}
+
++ (void)setStackSampleSignal:(int)stackSampleSignal {
+    pthread_mutex_lock(&ks_settingsLock);
+    int previous = atomic_load(&ks_sampleSignal);
+    if (previous != stackSampleSignal) {
+        atomic_store(&ks_sampleSignal, 0);
+        if (previous != 0) {
+            sigaction(previous, &ks_previousAction, NULL);
+        }
+        if (stackSampleSignal != 0) {
+            struct sigaction action;
+            memset(&action, 0, sizeof(action));
+            action.sa_sigaction = KSSlowCallbackSignalHandler;
+            action.sa_flags = SA_SIGINFO | SA_RESTART;
+            sigemptyset(&action.sa_mask);
+            if (sigaction(stackSampleSignal, &action, &ks_previousAction) == 0) {
+                atomic_store(&ks_sampleSignal, stackSampleSignal);
+            }
+        }
+    }
+    pthread_mutex_unlock(&ks_settingsLock);
+}
+
++ (NSArray *)recentReports {
+    pthread_mutex_lock(&ks_settingsLock);
+    NSArray *reports = [ks_recentReports copy] ?: @[];
+    pthread_mutex_unlock(&ks_settingsLock);
+    return reports;
+}
+
++ (void)reset {
+    pthread_mutex_lock(&ks_settingsLock);
+    [ks_recentReports removeAllObjects];
+    pthread_mutex_unlock(&ks_settingsLock);
+}
+
+@end
@@ -0,0 +1,22 @@
+#import <Foundation/Foundation.h>
+#import <stdatomic.h>
+
+// Hooks KSPromise uses to feed KSSlowCallbackWatchdog. While the watchdog is
+// off each callback costs one relaxed load.
+
+// Lives on the stack of the thread running the callback. Callbacks run inline
+// from other callbacks nest, and each frame remembers the one it interrupted.
+typedef struct {
+    uint64_t start;
+    const void *invoke;
+    uint64_t previousStart;
+    const void *previousInvoke;
+} KSSlowCallbackFrame;
+
+extern atomic_bool KSSlowCallbacksEnabled;
+
+#define KS_SLOW_CALLBACKS_ENABLED() __builtin_expect(atomic_load_explicit(&KSSlowCallbacksEnabled, memory_order_relaxed), 0)
+
+// Leaves frame->start at 0 if the block is nil.
+void KSSlowCallbackBegin(KSSlowCallbackFrame *frame, id block);
+void KSSlowCallbackEnd(KSSlowCallbackFrame *frame);
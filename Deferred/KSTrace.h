@@ -0,0 +1,73 @@
+#import <Foundation/Foundation.h>
+#import <stdatomic.h>
+
+// Hooks KSPromise uses to feed KSPromiseTracing. Build with
+// KS_PROMISE_TRACING=0 to compile them out; when compiled in but not started,
+// each hook is one relaxed load and a predicted-not-taken branch.
+
+#ifndef KS_PROMISE_TRACING
+#define KS_PROMISE_TRACING 1
+#endif
+
+typedef NS_ENUM(uint32_t, KSTraceEventType) {
+    KSTraceEventCreate,
+    // related is the child promise
+    KSTraceEventThen,
+    KSTraceEventResolve,
+    KSTraceEventReject,
+    // related is the child promise
+    KSTraceEventCallbackBegin,
+    KSTraceEventCallbackEnd,
+    KSTraceEventCancel,
+    // identifier is the +when: promise, related is one of its parents
+    KSTraceEventWhenParent,
+    // identifier takes the state of related, a promise returned from a callback
+    KSTraceEventAdopt,
+    // identifier is the promise of a network request
+    KSTraceEventNetwork,
+};
+
+typedef struct {
+    uint64_t timestamp;
+    uint64_t identifier;
+    uint64_t related;
+    uint32_t thread;
+    KSTraceEventType type;
+    // a KSCreationSites stack id, or 0
+    uint32_t stack;
+} KSTraceEventRecord;
+
+@class KSPromise;
+
+// 0 if the promise was created while tracing was stopped.
+uint64_t KSTraceIdentifierForPromise(KSPromise *promise);
+
+// The events still held in the rings, grouped by thread and oldest first
+// within each thread. The caller frees the result.
+KSTraceEventRecord *KSTraceCopyEvents(size_t *count);
+
+uint64_t KSTraceNextIdentifier(void);
+void KSTraceRecord(KSTraceEventType type, uint64_t identifier, uint64_t related, uint32_t stack);
+
+#if KS_PROMISE_TRACING
+
+extern atomic_bool KSTraceEnabled;
+
+#define KS_TRACE_ENABLED() __builtin_expect(atomic_load_explicit(&KSTraceEnabled, memory_order_relaxed), 0)
+
+// Promises created while tracing was stopped have no identifier and are skipped.
+#define KS_TRACE_STACK(type, identifier, related, stack) do { \
+    if (KS_TRACE_ENABLED() && (identifier) != 0) { \
+        KSTraceRecord((type), (identifier), (related), (stack)); \
+    } \
+} while (0)
+
+#define KS_TRACE(type, identifier, related) KS_TRACE_STACK(type, identifier, related, 0)
+
+#else
+
+#define KS_TRACE_ENABLED() 0
+#define KS_TRACE_STACK(type, identifier, related, stack) do { } while (0)
+#define KS_TRACE(type, identifier, related) do { } while (0)
+
+#endif
@@ -2,15 +2,21 @@
 #import "KSNullabilityCompat.h"
 
 @class KSPromise;
+@class KSCompletionDeliveryPool;
 
 NS_ASSUME_NONNULL_BEGIN
 
 @interface KSURLSessionClient : NSObject <KSNetworkClient>
 
 @property (nonatomic, readonly) NSURLSession *session;
+// When set, completions are delivered on this pool instead of the queue
+// passed to -sendAsynchronousRequest:queue:. A pool that rejects the
+// completion rejects the promise with KSCompletionDeliveryPoolErrorQueueFull.
+@property (nonatomic, readonly, nullable) KSCompletionDeliveryPool *deliveryPool;
 
 - (instancetype)init;
 - (instancetype)initWithURLSession:(NSURLSession *)session;
+- (instancetype)initWithURLSession:(NSURLSession *)session deliveryPool:(nullable KSCompletionDeliveryPool *)deliveryPool;
 
 @end
 
@@ -1,8 +1,12 @@
 #import "KSURLSessionClient.h"
 #import "KSPromise.h"
+#import "KSCompletionDeliveryPool.h"
+#import "KSProbes.h"
+#import "KSTrace.h"
 
 @interface KSURLSessionClient ()
 @property (strong, nonatomic, readwrite) NSURLSession *session;
+@property (strong, nonatomic, readwrite) KSCompletionDeliveryPool *deliveryPool;
 @end
 
 @implementation KSURLSessionClient
@@ -12,25 +16,47 @@
 }
 
 - (instancetype)initWithURLSession:(NSURLSession *)session {
+    return [self initWithURLSession:session deliveryPool:nil];
+}
+
+- (instancetype)initWithURLSession:(NSURLSession *)session deliveryPool:(KSCompletionDeliveryPool *)deliveryPool {
     self = [super init];
     if (self) {
         self.session = session;
+        self.deliveryPool = deliveryPool;
     }
     return self;
 }
 
 - (KSPromise KS_GENERIC(KSNetworkResponse *) *)sendAsynchronousRequest:(NSURLRequest *)request queue:(NSOperationQueue *)queue {
-    return [KSPromise promise:^(resolveType  _Nonnull resolve, rejectType  _Nonnull reject) {
+    KSCompletionDeliveryPool *deliveryPool = self.deliveryPool;
+    uint64_t start = KS_PROBE_ENABLED(response) ? KSClockNow() : 0;
+    KS_PROBE2(request_start, (__bridge void *)request, [[request.URL absoluteString] UTF8String]);
+    KSPromise *promise = [KSPromise promise:^(resolveType  _Nonnull resolve, rejectType  _Nonnull reject) {
         [[self.session dataTaskWithRequest:request completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
-            [queue addOperationWithBlock:^{
+            uint64_t responded = KS_PROBE_ENABLED(completion_dispatch) ? KSClockNow() : 0;
+            KS_PROBE3(response, (__bridge void *)request,
+                      [response isKindOfClass:[NSHTTPURLResponse class]] ? (int)[(NSHTTPURLResponse *)response statusCode] : 0,
+                      KSProbeElapsed(start));
+            void (^complete)(void) = ^{
+                KS_PROBE2(completion_dispatch, (__bridge void *)request, KSProbeElapsed(responded));
                 if (error) {
                     reject(error);
                 } else {
                     resolve([KSNetworkResponse networkResponseWithURLResponse:response data:data]);
                 }
-            }];
+            };
+            if (!deliveryPool) {
+                [queue addOperationWithBlock:complete];
+            } else if (![deliveryPool tryExecute:complete]) {
+                reject([NSError errorWithDomain:KSCompletionDeliveryPoolErrorDomain
+                                           code:KSCompletionDeliveryPoolErrorQueueFull
+                                       userInfo:nil]);
+            }
         }] resume];
     }];
+    KS_TRACE(KSTraceEventNetwork, KSTraceIdentifierForPromise(promise), 0);
+    return promise;
 }
 
 @end
@@ -0,0 +1,30 @@
+#import <Foundation/Foundation.h>
+#import "KSExecutor.h"
+#import "KSNullabilityCompat.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Runs blocks on a fixed set of worker threads, one per core by default.
+// Each worker owns a deque: blocks submitted from a worker are pushed onto
+// and popped from the tail of its own deque (LIFO), idle workers steal from
+// the head of other deques (FIFO). Blocks submitted from other threads are
+// distributed round-robin.
+@interface KSWorkStealingExecutor : NSObject <KSExecutor>
+
+@property (nonatomic, readonly) NSUInteger workerCount;
+
++ (instancetype)sharedExecutor;
+
+- (instancetype)init;
+- (instancetype)initWithWorkerCount:(NSUInteger)workerCount;
+
+- (void)execute:(void (^)(void))block;
+
+// Lets the workers finish queued blocks, including any execute: had already
+// started queueing, and exit. Blocks submitted after shutdown run inline on
+// the submitting thread.
+- (void)shutdown;
+
+@end
+
+NS_ASSUME_NONNULL_END
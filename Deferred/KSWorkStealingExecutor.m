@@ -0,0 +1,280 @@
+#import "KSWorkStealingExecutor.h"
+#import <pthread.h>
+#import <stdatomic.h>
+
+
+typedef struct {
+    pthread_mutex_t lock;
+    void **items;
+    NSUInteger capacity;
+    NSUInteger head;
+    NSUInteger count;
+} KSWorkDeque;
+
+typedef struct {
+    KSWorkDeque *deques;
+    NSUInteger workerCount;
+    atomic_long pending;
+    // execute: calls between their shutdown check and pending++; workers
+    // don't exit while any are in flight
+    atomic_long submitting;
+    atomic_long idle;
+    atomic_ulong nextDeque;
+    atomic_bool shutdown;
+    atomic_long references;
+    pthread_mutex_t parkLock;
+    pthread_cond_t parkCondition;
+} KSWorkStealingPool;
+
+typedef struct {
+    KSWorkStealingPool *pool;
+    NSUInteger index;
+    uint32_t seed;
+} KSWorker;
+
+static __thread KSWorker *ks_currentWorker;
+
+
+#pragma mark - Deque
+
+static void KSWorkDequeInit(KSWorkDeque *deque) {
+    pthread_mutex_init(&deque->lock, NULL);
+    deque->capacity = 64;
+    deque->items = calloc(deque->capacity, sizeof(void *));
+    deque->head = 0;
+    deque->count = 0;
+}
+
+static void KSWorkDequeDestroy(KSWorkDeque *deque) {
+    for (NSUInteger i = 0; i < deque->count; i++) {
+        CFRelease(deque->items[(deque->head + i) % deque->capacity]);
+    }
+    free(deque->items);
+    pthread_mutex_destroy(&deque->lock);
+}
+
+static void KSWorkDequePushTail(KSWorkDeque *deque, void *item) {
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count == deque->capacity) {
+        NSUInteger capacity = deque->capacity * 2;
+        void **items = calloc(capacity, sizeof(void *));
+        for (NSUInteger i = 0; i < deque->count; i++) {
+            items[i] = deque->items[(deque->head + i) % deque->capacity];
+        }
+        free(deque->items);
+        deque->items = items;
+        deque->capacity = capacity;
+        deque->head = 0;
+    }
+    deque->items[(deque->head + deque->count) % deque->capacity] = item;
+    deque->count++;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+static void *KSWorkDequePopTail(KSWorkDeque *deque) {
+    void *item = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count > 0) {
+        deque->count--;
+        item = deque->items[(deque->head + deque->count) % deque->capacity];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return item;
+}
+
+static void *KSWorkDequeStealHead(KSWorkDeque *deque) {
+    void *item = NULL;
+    if (pthread_mutex_trylock(&deque->lock) != 0) {
+        return NULL;
+    }
+    if (deque->count > 0) {
+        item = deque->items[deque->head];
+        deque->head = (deque->head + 1) % deque->capacity;
+        deque->count--;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return item;
+}
+
+
+#pragma mark - Pool
+
+static void KSWorkStealingPoolRelease(KSWorkStealingPool *pool) {
+    if (atomic_fetch_sub(&pool->references, 1) != 1) {
+        return;
+    }
+    for (NSUInteger i = 0; i < pool->workerCount; i++) {
+        KSWorkDequeDestroy(&pool->deques[i]);
+    }
+    free(pool->deques);
+    pthread_mutex_destroy(&pool->parkLock);
+    pthread_cond_destroy(&pool->parkCondition);
+    free(pool);
+}
+
+static void *KSWorkStealingPoolSteal(KSWorkStealingPool *pool, KSWorker *thief) {
+    thief->seed ^= thief->seed << 13;
+    thief->seed ^= thief->seed >> 17;
+    thief->seed ^= thief->seed << 5;
+
+    NSUInteger start = thief->seed % pool->workerCount;
+    for (NSUInteger i = 0; i < pool->workerCount; i++) {
+        NSUInteger victim = (start + i) % pool->workerCount;
+        if (victim == thief->index) {
+            continue;
+        }
+        void *item = KSWorkDequeStealHead(&pool->deques[victim]);
+        if (item) {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+// Returns YES once the pool has been shut down and there is nothing left to run.
+static BOOL KSWorkStealingPoolPark(KSWorkStealingPool *pool) {
+    pthread_mutex_lock(&pool->parkLock);
+    atomic_fetch_add(&pool->idle, 1);
+    while (atomic_load(&pool->pending) <= 0 && !atomic_load(&pool->shutdown)) {
+        pthread_cond_wait(&pool->parkCondition, &pool->parkLock);
+    }
+    atomic_fetch_sub(&pool->idle, 1);
+    BOOL finished = atomic_load(&pool->shutdown) && atomic_load(&pool->pending) <= 0 &&
+                    atomic_load(&pool->submitting) == 0;
+    pthread_mutex_unlock(&pool->parkLock);
+    return finished;
+}
+
+static void *KSWorkerMain(void *context) {
+    KSWorker *worker = context;
+    KSWorkStealingPool *pool = worker->pool;
+    ks_currentWorker = worker;
+
+#if defined(__APPLE__)
+    pthread_setname_np("KSWorkStealingExecutor");
+#elif defined(__linux__)
+    pthread_setname_np(pthread_self(), "KSWorkStealing");
+#endif
+
+    while (YES) {
+        void *item = KSWorkDequePopTail(&pool->deques[worker->index]);
+        if (!item) {
+            item = KSWorkStealingPoolSteal(pool, worker);
+        }
+        if (item) {
+            atomic_fetch_sub(&pool->pending, 1);
+            @autoreleasepool {
+                void (^block)(void) = (__bridge_transfer void (^)(void))item;
+                block();
+            }
+        } else if (KSWorkStealingPoolPark(pool)) {
+            break;
+        }
+    }
+
+    ks_currentWorker = NULL;
+    free(worker);
+    KSWorkStealingPoolRelease(pool);
+    return NULL;
+}
+
+
+@implementation KSWorkStealingExecutor {
+    KSWorkStealingPool *_pool;
+}
+
++ (instancetype)sharedExecutor {
+    static KSWorkStealingExecutor *sharedExecutor;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedExecutor = [[self alloc] init];
+    });
+    return sharedExecutor;
+}
+
+- (instancetype)init {
+    return [self initWithWorkerCount:[[NSProcessInfo processInfo] activeProcessorCount]];
+}
+
+- (instancetype)initWithWorkerCount:(NSUInteger)workerCount {
+    self = [super init];
+    if (self) {
+        _workerCount = MAX(workerCount, (NSUInteger)1);
+
+        _pool = calloc(1, sizeof(KSWorkStealingPool));
+        _pool->workerCount = _workerCount;
+        _pool->deques = calloc(_workerCount, sizeof(KSWorkDeque));
+        atomic_init(&_pool->pending, 0);
+        atomic_init(&_pool->submitting, 0);
+        atomic_init(&_pool->idle, 0);
+        atomic_init(&_pool->nextDeque, 0);
+        atomic_init(&_pool->shutdown, false);
+        atomic_init(&_pool->references, (long)_workerCount + 1);
+        pthread_mutex_init(&_pool->parkLock, NULL);
+        pthread_cond_init(&_pool->parkCondition, NULL);
+
+        for (NSUInteger i = 0; i < _workerCount; i++) {
+            KSWorkDequeInit(&_pool->deques[i]);
+        }
+
+        pthread_attr_t attributes;
+        pthread_attr_init(&attributes);
+        pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+        for (NSUInteger i = 0; i < _workerCount; i++) {
+            KSWorker *worker = calloc(1, sizeof(KSWorker));
+            worker->pool = _pool;
+            worker->index = i;
+            worker->seed = (uint32_t)((i + 1) * 2654435761u) | 1;
+            pthread_t thread;
+            pthread_create(&thread, &attributes, KSWorkerMain, worker);
+        }
+        pthread_attr_destroy(&attributes);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [self shutdown];
+    KSWorkStealingPoolRelease(_pool);
+}
+
+- (void)execute:(void (^)(void))block {
+    KSWorkStealingPool *pool = _pool;
+    // Announced before the shutdown check, so a worker that has seen shutdown
+    // waits for this block to reach pending rather than leave it stranded in
+    // a deque. Once shut down nothing would run a queued block, so it runs
+    // inline instead of leaving the promise waiting on it pending for good.
+    atomic_fetch_add(&pool->submitting, 1);
+    if (atomic_load(&pool->shutdown)) {
+        atomic_fetch_sub(&pool->submitting, 1);
+        block();
+        return;
+    }
+
+    KSWorker *worker = ks_currentWorker;
+    NSUInteger index;
+    if (worker && worker->pool == pool) {
+        index = worker->index;
+    } else {
+        index = atomic_fetch_add(&pool->nextDeque, 1) % pool->workerCount;
+    }
+
+    KSWorkDequePushTail(&pool->deques[index], (__bridge_retained void *)[block copy]);
+    atomic_fetch_add(&pool->pending, 1);
+    atomic_fetch_sub(&pool->submitting, 1);
+
+    if (atomic_load(&pool->idle) > 0) {
+        pthread_mutex_lock(&pool->parkLock);
+        pthread_cond_signal(&pool->parkCondition);
+        pthread_mutex_unlock(&pool->parkLock);
+    }
+}
+
+- (void)shutdown {
+    pthread_mutex_lock(&_pool->parkLock);
+    atomic_store(&_pool->shutdown, true);
+    pthread_cond_broadcast(&_pool->parkCondition);
+    pthread_mutex_unlock(&_pool->parkLock);
+}
+
+@end
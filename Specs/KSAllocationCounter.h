@@ -0,0 +1,16 @@
+#import <Foundation/Foundation.h>
+
+// Counts heap allocations made by every thread while counting is enabled.
+// On Linux malloc, calloc and realloc are interposed; on Apple platforms the
+// default malloc zone is patched the first time counting is enabled.
+
+typedef struct {
+    uint64_t allocations;
+    uint64_t bytes;
+} KSAllocationCount;
+
+void KSAllocationCounterSetEnabled(BOOL enabled);
+// Counts only the allocations the calling thread makes, so work on other
+// threads, such as the test runner's, doesn't show up.
+void KSAllocationCounterSetEnabledOnCurrentThread(BOOL enabled);
+KSAllocationCount KSAllocationCounterRead(void);
@@ -0,0 +1,119 @@
+#import "KSAllocationCounter.h"
+#import <pthread.h>
+#import <stdatomic.h>
+
+#if defined(__APPLE__)
+#import <malloc/malloc.h>
+#import <mach/mach.h>
+#endif
+
+
+static atomic_bool ks_countingEnabled;
+// pthread_self doesn't allocate, unlike the first touch of a thread local
+static atomic_bool ks_countingOneThread;
+static pthread_t ks_countingThread;
+static atomic_uint_fast64_t ks_allocations;
+static atomic_uint_fast64_t ks_bytes;
+
+static inline void KSAllocationCounterRecord(size_t size) {
+    if (atomic_load_explicit(&ks_countingEnabled, memory_order_relaxed) &&
+        (!atomic_load_explicit(&ks_countingOneThread, memory_order_relaxed) ||
+         pthread_equal(pthread_self(), ks_countingThread))) {
+        atomic_fetch_add_explicit(&ks_allocations, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&ks_bytes, size, memory_order_relaxed);
+    }
+}
+
+
+#if defined(__linux__)
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *pointer, size_t size);
+
+void *malloc(size_t size) {
+    KSAllocationCounterRecord(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    KSAllocationCounterRecord(count * size);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+    KSAllocationCounterRecord(size);
+    return __libc_realloc(pointer, size);
+}
+
+static void KSAllocationCounterInstall(void) {
+}
+
+#elif defined(__APPLE__)
+
+static void *(*ks_zoneMalloc)(malloc_zone_t *zone, size_t size);
+static void *(*ks_zoneCalloc)(malloc_zone_t *zone, size_t count, size_t size);
+static void *(*ks_zoneRealloc)(malloc_zone_t *zone, void *pointer, size_t size);
+
+static void *KSZoneMalloc(malloc_zone_t *zone, size_t size) {
+    KSAllocationCounterRecord(size);
+    return ks_zoneMalloc(zone, size);
+}
+
+static void *KSZoneCalloc(malloc_zone_t *zone, size_t count, size_t size) {
+    KSAllocationCounterRecord(count * size);
+    return ks_zoneCalloc(zone, count, size);
+}
+
+static void *KSZoneRealloc(malloc_zone_t *zone, void *pointer, size_t size) {
+    KSAllocationCounterRecord(size);
+    return ks_zoneRealloc(zone, pointer, size);
+}
+
+static void KSAllocationCounterInstall(void) {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        malloc_zone_t *zone = malloc_default_zone();
+        vm_address_t page = trunc_page((vm_address_t)zone);
+        vm_protect(mach_task_self(), page, vm_page_size, 0, VM_PROT_READ | VM_PROT_WRITE);
+        ks_zoneMalloc = zone->malloc;
+        ks_zoneCalloc = zone->calloc;
+        ks_zoneRealloc = zone->realloc;
+        zone->malloc = KSZoneMalloc;
+        zone->calloc = KSZoneCalloc;
+        zone->realloc = KSZoneRealloc;
+        vm_protect(mach_task_self(), page, vm_page_size, 0, VM_PROT_READ);
+    });
+}
+
+#else
+
+static void KSAllocationCounterInstall(void) {
+}
+
+#endif
+
+
+void KSAllocationCounterSetEnabled(BOOL enabled) {
+    if (enabled) {
+        KSAllocationCounterInstall();
+    }
+    atomic_store(&ks_countingOneThread, NO);
+    atomic_store(&ks_countingEnabled, enabled);
+}
+
+void KSAllocationCounterSetEnabledOnCurrentThread(BOOL enabled) {
+    if (enabled) {
+        KSAllocationCounterInstall();
+        ks_countingThread = pthread_self();
+    }
+    atomic_store(&ks_countingOneThread, enabled);
+    atomic_store(&ks_countingEnabled, enabled);
+}
+
+KSAllocationCount KSAllocationCounterRead(void) {
+    KSAllocationCount count;
+    count.allocations = atomic_load(&ks_allocations);
+    count.bytes = atomic_load(&ks_bytes);
+    return count;
+}
@@ -0,0 +1,160 @@
+#import <Cedar/Cedar.h>
+#import "KSDeferred.h"
+#import "KSAsyncChannel.h"
+
+using namespace Cedar::Matchers;
+
+SPEC_BEGIN(KSAsyncChannelSpec)
+
+describe(@"KSAsyncChannel", ^{
+    __block KSAsyncChannel *channel;
+
+    beforeEach(^{
+        channel = [[KSAsyncChannel alloc] initWithCapacity:2];
+    });
+
+    it(@"should take sends while there is room", ^{
+        [channel send:@"A"].fulfilled should be_truthy;
+        [channel trySend:@"B"] should be_truthy;
+        channel.count should equal(2);
+
+        [channel trySend:@"C"] should equal(NO);
+        [channel send:@"C"].fulfilled should equal(NO);
+    });
+
+    it(@"should receive items in the order they were sent", ^{
+        [channel send:@"A"];
+        [channel send:@"B"];
+
+        [channel receive].value should equal(@"A");
+        [channel receive].value should equal(@"B");
+    });
+
+    it(@"should keep a send to a full channel pending until a receive makes room", ^{
+        [channel send:@"A"];
+        [channel send:@"B"];
+        KSPromise *send = [channel send:@"C"];
+
+        [channel receive].value should equal(@"A");
+        send.fulfilled should be_truthy;
+        channel.count should equal(2);
+        [channel receiveUpTo:5].value should equal(@[@"B", @"C"]);
+    });
+
+    it(@"should keep a receive from an empty channel pending until an item arrives", ^{
+        KSPromise *first = [channel receive];
+        KSPromise *second = [channel receiveUpTo:5];
+        first.fulfilled should equal(NO);
+
+        [channel send:@"A"].fulfilled should be_truthy;
+        [channel send:@"B"];
+        first.value should equal(@"A");
+        second.value should equal(@[@"B"]);
+        channel.count should equal(0);
+    });
+
+    it(@"should receive up to the given number of items at once", ^{
+        [channel send:@"A"];
+        [channel send:@"B"];
+
+        [channel receiveUpTo:1].value should equal(@[@"A"]);
+        [channel receiveUpTo:3].value should equal(@[@"B"]);
+    });
+
+    it(@"should withdraw a cancelled receive", ^{
+        KSPromise *cancelled = [channel receive];
+        KSPromise *next = [channel receive];
+        [cancelled cancel];
+
+        [channel send:@"A"];
+        next.value should equal(@"A");
+    });
+
+    it(@"should withdraw a cancelled send", ^{
+        [channel send:@"A"];
+        [channel send:@"B"];
+        [[channel send:@"C"] cancel];
+
+        [channel receiveUpTo:5].value should equal(@[@"A", @"B"]);
+        channel.count should equal(0);
+    });
+
+    describe(@"without capacity", ^{
+        beforeEach(^{
+            channel = [[KSAsyncChannel alloc] initWithCapacity:0];
+        });
+
+        it(@"should hand each item straight from sender to receiver", ^{
+            KSPromise *send = [channel send:@"A"];
+            send.fulfilled should equal(NO);
+
+            [channel receive].value should equal(@"A");
+            send.fulfilled should be_truthy;
+
+            KSPromise *receive = [channel receive];
+            [channel send:@"B"].fulfilled should be_truthy;
+            receive.value should equal(@"B");
+        });
+    });
+
+    describe(@"closing", ^{
+        it(@"should reject waiting and later sends", ^{
+            [channel send:@"A"];
+            [channel send:@"B"];
+            KSPromise *waiting = [channel send:@"C"];
+            [channel close];
+
+            waiting.error.code should equal(KSAsyncChannelErrorClosed);
+            [channel send:@"D"].error.domain should equal(KSAsyncChannelErrorDomain);
+            [channel trySend:@"D"] should equal(NO);
+        });
+
+        it(@"should let the buffered items be received, then reject receives", ^{
+            [channel send:@"A"];
+            [channel close];
+
+            channel.closed should be_truthy;
+            [channel receive].value should equal(@"A");
+            [channel receive].error.code should equal(KSAsyncChannelErrorClosed);
+        });
+
+        it(@"should reject waiting receives", ^{
+            KSPromise *waiting = [channel receive];
+            [channel close];
+
+            waiting.error.code should equal(KSAsyncChannelErrorClosed);
+        });
+    });
+
+    it(@"should never buffer more than its capacity under concurrent producers and consumers", ^{
+        __block NSUInteger mostBuffered = 0;
+        __block NSUInteger received = 0;
+        dispatch_group_t group = dispatch_group_create();
+        dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+        for (NSUInteger i = 0; i < 200; i++) {
+            dispatch_group_async(group, queue, ^{
+                [channel send:@(i)];
+            });
+            dispatch_group_enter(group);
+            dispatch_async(queue, ^{
+                NSUInteger buffered = channel.count;
+                @synchronized (channel) {
+                    mostBuffered = MAX(mostBuffered, buffered);
+                }
+                [[channel receive] then:^id(id value) {
+                    @synchronized (channel) {
+                        received++;
+                    }
+                    dispatch_group_leave(group);
+                    return value;
+                }];
+            });
+        }
+        dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+
+        received should equal(200);
+        mostBuffered should be_lte(2);
+    });
+});
+
+SPEC_END
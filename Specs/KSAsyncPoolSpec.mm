@@ -0,0 +1,181 @@
+#import <Cedar/Cedar.h>
+#import "KSDeferred.h"
+#import "KSAsyncPool.h"
+
+using namespace Cedar::Matchers;
+
+SPEC_BEGIN(KSAsyncPoolSpec)
+
+describe(@"KSAsyncPool", ^{
+    __block KSAsyncPool *pool;
+    __block NSUInteger created;
+    __block NSMutableArray *destroyed;
+
+    beforeEach(^{
+        created = 0;
+        destroyed = [NSMutableArray array];
+        pool = [[KSAsyncPool alloc] initWithMaximumCount:2 factory:^KSPromise *{
+            created++;
+            return [KSPromise resolve:[NSString stringWithFormat:@"object %lu", (unsigned long)created]];
+        }];
+        pool.destroyBlock = ^(id object) {
+            [destroyed addObject:object];
+        };
+    });
+
+    it(@"should create objects up to the maximum count", ^{
+        [pool checkout].value should equal(@"object 1");
+        [pool checkout].value should equal(@"object 2");
+        KSPromise *waiting = [pool checkout];
+
+        waiting.fulfilled should equal(NO);
+        pool.liveCount should equal(2);
+        pool.waiterCount should equal(1);
+    });
+
+    it(@"should lend out checked in objects again", ^{
+        id object = [pool checkout].value;
+        [pool checkin:object];
+
+        [pool checkout].value should equal(object);
+        created should equal(1);
+    });
+
+    it(@"should hand a checked in object straight to the first waiter", ^{
+        id first = [pool checkout].value;
+        [pool checkout];
+        KSPromise *waiting = [pool checkout];
+        KSPromise *next = [pool checkout];
+
+        [pool checkin:first];
+        waiting.value should equal(first);
+        next.fulfilled should equal(NO);
+        pool.idleCount should equal(0);
+    });
+
+    it(@"should drop a cancelled checkout from the queue", ^{
+        id first = [pool checkout].value;
+        [pool checkout];
+        KSPromise *cancelled = [pool checkout];
+        KSPromise *next = [pool checkout];
+
+        [cancelled cancel];
+        pool.waiterCount should equal(1);
+        [pool checkin:first];
+        next.value should equal(first);
+    });
+
+    it(@"should make a new object for a waiter when one is discarded", ^{
+        id first = [pool checkout].value;
+        [pool checkout];
+        KSPromise *waiting = [pool checkout];
+
+        [pool discard:first];
+        destroyed should equal(@[first]);
+        waiting.value should equal(@"object 3");
+        pool.liveCount should equal(2);
+    });
+
+    it(@"should discard idle objects that fail the health check", ^{
+        pool.healthCheck = ^BOOL(NSString *object) {
+            return ![object isEqual:@"object 1"];
+        };
+        [pool checkin:[pool checkout].value];
+
+        [pool checkout].value should equal(@"object 2");
+        destroyed should equal(@[@"object 1"]);
+        pool.liveCount should equal(1);
+    });
+
+    it(@"should make a new object for a waiter when a checked in one fails the health check", ^{
+        pool.healthCheck = ^BOOL(NSString *object) {
+            return ![object isEqual:@"object 1"];
+        };
+        id first = [pool checkout].value;
+        [pool checkout];
+        KSPromise *waiting = [pool checkout];
+
+        [pool checkin:first];
+        destroyed should equal(@[first]);
+        waiting.value should equal(@"object 3");
+        pool.liveCount should equal(2);
+        pool.idleCount should equal(0);
+    });
+
+    it(@"should discard objects idle for longer than the idle timeout", ^{
+        pool.idleTimeout = 0.01;
+        [pool checkin:[pool checkout].value];
+        [NSThread sleepForTimeInterval:0.02];
+        [pool evictIdleObjects];
+
+        pool.idleCount should equal(0);
+        pool.liveCount should equal(0);
+        destroyed should equal(@[@"object 1"]);
+    });
+
+    it(@"should pass on a factory failure and free the place", ^{
+        NSError *expectedError = [NSError errorWithDomain:@"Broken" code:1 userInfo:nil];
+        pool = [[KSAsyncPool alloc] initWithMaximumCount:1 factory:^KSPromise *{
+            return [KSPromise reject:expectedError];
+        }];
+
+        [pool checkout].error should equal(expectedError);
+        pool.liveCount should equal(0);
+    });
+
+    describe(@"withObject:", ^{
+        __block KSDeferred *work;
+
+        beforeEach(^{
+            work = [KSDeferred defer];
+        });
+
+        it(@"should check the object in once the work settles", ^{
+            KSPromise *result = [pool withObject:^KSPromise *(id object) {
+                return work.promise;
+            }];
+            pool.idleCount should equal(0);
+
+            [work resolveWithValue:@"done"];
+            result.value should equal(@"done");
+            pool.idleCount should equal(1);
+        });
+
+        it(@"should check the object in and cancel the work when cancelled", ^{
+            KSPromise *result = [pool withObject:^KSPromise *(id object) {
+                return work.promise;
+            }];
+            [result cancel];
+
+            work.promise.cancelled should be_truthy;
+            pool.idleCount should equal(1);
+        });
+
+        it(@"should check the object in when the work is cancelled elsewhere", ^{
+            KSPromise *result = [pool withObject:^KSPromise *(id object) {
+                return work.promise;
+            }];
+            [work.promise cancel];
+
+            pool.idleCount should equal(1);
+            result.cancelled should be_truthy;
+            [pool checkout].value should equal(@"object 1");
+        });
+
+        it(@"should leave the queue when cancelled while waiting", ^{
+            [pool checkout];
+            [pool checkout];
+            __block BOOL called = NO;
+            KSPromise *result = [pool withObject:^KSPromise *(id object) {
+                called = YES;
+                return work.promise;
+            }];
+            [result cancel];
+
+            pool.waiterCount should equal(0);
+            called should equal(NO);
+        });
+    });
+});
+
+SPEC_END
@@ -0,0 +1,96 @@
+#import <Cedar/Cedar.h>
+#import "KSDeferred.h"
+#import "KSAsyncReadWriteLock.h"
+
+using namespace Cedar::Matchers;
+
+SPEC_BEGIN(KSAsyncReadWriteLockSpec)
+
+describe(@"KSAsyncReadWriteLock", ^{
+    __block KSAsyncReadWriteLock *lock;
+
+    beforeEach(^{
+        lock = [[KSAsyncReadWriteLock alloc] init];
+    });
+
+    it(@"should let readers in together", ^{
+        [lock acquireRead].fulfilled should be_truthy;
+        [lock acquireRead].fulfilled should be_truthy;
+        lock.readerCount should equal(2);
+    });
+
+    it(@"should make a writer wait for the readers to leave", ^{
+        [lock acquireRead];
+        KSPromise *write = [lock acquireWrite];
+        write.fulfilled should equal(NO);
+
+        [lock releaseRead];
+        write.fulfilled should be_truthy;
+        lock.writing should be_truthy;
+    });
+
+    it(@"should make readers queued behind a writer wait for it", ^{
+        [lock acquireRead];
+        KSPromise *write = [lock acquireWrite];
+        KSPromise *read = [lock acquireRead];
+        read.fulfilled should equal(NO);
+
+        [lock releaseRead];
+        write.fulfilled should be_truthy;
+        read.fulfilled should equal(NO);
+
+        [lock releaseWrite];
+        read.fulfilled should be_truthy;
+    });
+
+    it(@"should let every reader at the front of the queue in at once", ^{
+        [lock acquireWrite];
+        KSPromise *first = [lock acquireRead];
+        KSPromise *second = [lock acquireRead];
+        KSPromise *write = [lock acquireWrite];
+
+        [lock releaseWrite];
+        first.fulfilled should be_truthy;
+        second.fulfilled should be_truthy;
+        write.fulfilled should equal(NO);
+        lock.waiterCount should equal(1);
+    });
+
+    it(@"should let the readers behind a cancelled writer in", ^{
+        [lock acquireRead];
+        KSPromise *write = [lock acquireWrite];
+        KSPromise *read = [lock acquireRead];
+
+        [write cancel];
+        read.fulfilled should be_truthy;
+        lock.readerCount should equal(2);
+        lock.waiterCount should equal(0);
+    });
+
+    it(@"should release the lock once the work done under it settles", ^{
+        KSDeferred *work = [KSDeferred defer];
+        [lock withWriteLock:^KSPromise *{
+            return work.promise;
+        }];
+        KSPromise *read = [lock acquireRead];
+        read.fulfilled should equal(NO);
+
+        [work resolveWithValue:nil];
+        read.fulfilled should be_truthy;
+        lock.writing should equal(NO);
+    });
+
+    it(@"should release the lock when the work done under it is cancelled", ^{
+        KSDeferred *work = [KSDeferred defer];
+        [lock withReadLock:^KSPromise *{
+            return work.promise;
+        }];
+        KSPromise *write = [lock acquireWrite];
+
+        [work.promise cancel];
+        write.fulfilled should be_truthy;
+        lock.readerCount should equal(0);
+    });
+});
+
+SPEC_END
@@ -0,0 +1,128 @@
+#import <Cedar/Cedar.h>
+#import "KSDeferred.h"
+#import "KSAsyncSemaphore.h"
+
+using namespace Cedar::Matchers;
+
+SPEC_BEGIN(KSAsyncSemaphoreSpec)
+
+describe(@"KSAsyncSemaphore", ^{
+    __block KSAsyncSemaphore *semaphore;
+
+    beforeEach(^{
+        semaphore = [[KSAsyncSemaphore alloc] initWithValue:2];
+    });
+
+    it(@"should hand out free permits straight away", ^{
+        [semaphore acquire].fulfilled should be_truthy;
+        [semaphore tryAcquire] should be_truthy;
+        semaphore.value should equal(0);
+        [semaphore tryAcquire] should equal(NO);
+    });
+
+    it(@"should queue waiters in order and hand each signal to the first", ^{
+        [semaphore acquire];
+        [semaphore acquire];
+        KSPromise *first = [semaphore acquire];
+        KSPromise *second = [semaphore acquire];
+        semaphore.waiterCount should equal(2);
+
+        [semaphore signal];
+        first.fulfilled should be_truthy;
+        second.fulfilled should equal(NO);
+        semaphore.value should equal(0);
+
+        [semaphore signal];
+        second.fulfilled should be_truthy;
+        [semaphore signal];
+        semaphore.value should equal(1);
+    });
+
+    it(@"should drop a cancelled waiter from the queue", ^{
+        [semaphore acquire];
+        [semaphore acquire];
+        KSPromise *cancelled = [semaphore acquire];
+        KSPromise *next = [semaphore acquire];
+
+        [cancelled cancel];
+        semaphore.waiterCount should equal(1);
+
+        [semaphore signal];
+        next.fulfilled should be_truthy;
+        cancelled.fulfilled should equal(NO);
+    });
+
+    it(@"should signal once the work done with a permit settles", ^{
+        KSDeferred *work = [KSDeferred defer];
+        KSPromise *result = [semaphore withPermit:^KSPromise *{
+            return work.promise;
+        }];
+        semaphore.value should equal(1);
+
+        [work resolveWithValue:@"A"];
+        result.value should equal(@"A");
+        semaphore.value should equal(2);
+    });
+
+    it(@"should signal when the work done with a permit is cancelled", ^{
+        KSDeferred *work = [KSDeferred defer];
+        [semaphore withPermit:^KSPromise *{
+            return work.promise;
+        }];
+        semaphore.value should equal(1);
+
+        [work.promise cancel];
+        semaphore.value should equal(2);
+    });
+
+    it(@"should signal straight away when there is no work", ^{
+        [semaphore withPermit:^KSPromise *{
+            return nil;
+        }];
+        semaphore.value should equal(2);
+    });
+
+    it(@"should never let more holders in than it has permits", ^{
+        __block int32_t holders = 0;
+        __block int32_t mostHolders = 0;
+        dispatch_group_t group = dispatch_group_create();
+        for (NSUInteger i = 0; i < 100; i++) {
+            dispatch_group_enter(group);
+            dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                [[semaphore acquire] then:^id(id value) {
+                    @synchronized (semaphore) {
+                        holders++;
+                        mostHolders = MAX(mostHolders, holders);
+                    }
+                    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                        @synchronized (semaphore) {
+                            holders--;
+                        }
+                        [semaphore signal];
+                        dispatch_group_leave(group);
+                    });
+                    return value;
+                }];
+            });
+        }
+        dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+
+        mostHolders should be_lte(2);
+        semaphore.value should equal(2);
+    });
+});
+
+describe(@"KSAsyncMutex", ^{
+    it(@"should let one holder in at a time", ^{
+        KSAsyncMutex *mutex = [[KSAsyncMutex alloc] init];
+        [mutex lock].fulfilled should be_truthy;
+        KSPromise *waiting = [mutex lock];
+        [mutex tryLock] should equal(NO);
+        waiting.fulfilled should equal(NO);
+
+        [mutex unlock];
+        waiting.fulfilled should be_truthy;
+    });
+});
+
+SPEC_END
@@ -0,0 +1,137 @@
+#import <Cedar/Cedar.h>
+#import "KSDeferred.h"
+#import "KSBatchLoader.h"
+
+using namespace Cedar::Matchers;
+
+SPEC_BEGIN(KSBatchLoaderSpec)
+
+describe(@"KSBatchLoader", ^{
+    __block dispatch_queue_t queue;
+    __block NSMutableArray *batches;
+    __block KSBatchLoader *loader;
+    __block NSError *expectedError;
+
+    beforeEach(^{
+        // Suspended so every load: in an example lands in the same tick.
+        queue = dispatch_queue_create("KSBatchLoaderSpec", DISPATCH_QUEUE_SERIAL);
+        dispatch_suspend(queue);
+        batches = [NSMutableArray array];
+        expectedError = [NSError errorWithDomain:@"Broken" code:1 userInfo:nil];
+        loader = [[KSBatchLoader alloc] initWithQueue:queue batchFunction:^KSPromise *(NSArray *keys) {
+            @synchronized (batches) {
+                [batches addObject:keys];
+            }
+            NSMutableArray *values = [NSMutableArray array];
+            for (NSString *key in keys) {
+                if ([key isEqual:@"missing"]) {
+                    [values addObject:[NSNull null]];
+                } else if ([key isEqual:@"broken"]) {
+                    [values addObject:expectedError];
+                } else {
+                    [values addObject:[key uppercaseString]];
+                }
+            }
+            return [KSPromise resolve:values];
+        }];
+    });
+
+    it(@"should send the keys requested in one tick as one batch", ^{
+        KSPromise *a = [loader load:@"a"];
+        KSPromise *b = [loader load:@"b"];
+        dispatch_resume(queue);
+
+        [a waitForValue] should equal(@"A");
+        [b waitForValue] should equal(@"B");
+        batches should equal(@[@[@"a", @"b"]]);
+    });
+
+    it(@"should send a key requested twice once and fulfill both callers", ^{
+        KSPromise *first = [loader load:@"a"];
+        KSPromise *second = [loader load:@"a"];
+        dispatch_resume(queue);
+
+        [first waitForValue] should equal(@"A");
+        [second waitForValue] should equal(@"A");
+        batches should equal(@[@[@"a"]]);
+    });
+
+    it(@"should leave the other callers of a key be when one cancels", ^{
+        KSPromise *first = [loader load:@"a"];
+        KSPromise *second = [loader load:@"a"];
+        [first cancel];
+        dispatch_resume(queue);
+
+        [second waitForValue] should equal(@"A");
+        first.fulfilled should equal(NO);
+    });
+
+    it(@"should start a new batch in the next tick", ^{
+        KSPromise *a = [loader load:@"a"];
+        dispatch_resume(queue);
+        [a waitForValue];
+
+        [[loader load:@"b"] waitForValue] should equal(@"B");
+        batches should equal(@[@[@"a"], @[@"b"]]);
+    });
+
+    it(@"should map NSNull to nil and NSError to a rejection of that key alone", ^{
+        KSPromise *missing = [loader load:@"missing"];
+        KSPromise *broken = [loader load:@"broken"];
+        KSPromise *a = [loader load:@"a"];
+        dispatch_resume(queue);
+
+        [a waitForValue] should equal(@"A");
+        missing.fulfilled should be_truthy;
+        missing.value should be_nil;
+        broken.error should equal(expectedError);
+    });
+
+    it(@"should split batches larger than the maximum batch size", ^{
+        loader.maximumBatchSize = 2;
+        KSPromise *all = [loader loadMany:@[@"a", @"b", @"c"]];
+        dispatch_resume(queue);
+
+        [all waitForValue] should equal(@[@"A", @"B", @"C"]);
+        batches should equal(@[@[@"a", @"b"], @[@"c"]]);
+    });
+
+    it(@"should send the keys collected so far on dispatch", ^{
+        KSPromise *a = [loader load:@"a"];
+        [loader dispatch];
+
+        a.value should equal(@"A");
+        dispatch_resume(queue);
+    });
+
+    describe(@"when the batch function fails", ^{
+        it(@"should reject every key of a rejected batch", ^{
+            loader = [[KSBatchLoader alloc] initWithQueue:queue batchFunction:^KSPromise *(NSArray *keys) {
+                return [KSPromise reject:expectedError];
+            }];
+            KSPromise *a = [loader load:@"a"];
+            KSPromise *b = [loader load:@"b"];
+            [loader dispatch];
+            dispatch_resume(queue);
+
+            a.error should equal(expectedError);
+            b.error should equal(expectedError);
+        });
+
+        it(@"should reject every key when the value count is wrong", ^{
+            loader = [[KSBatchLoader alloc] initWithQueue:queue batchFunction:^KSPromise *(NSArray *keys) {
+                return [KSPromise resolve:@[@"A"]];
+            }];
+            KSPromise *a = [loader load:@"a"];
+            KSPromise *b = [loader load:@"b"];
+            [loader dispatch];
+            dispatch_resume(queue);
+
+            a.error.domain should equal(KSBatchLoaderErrorDomain);
+            a.error.code should equal(KSBatchLoaderErrorValueCountMismatch);
+            b.error.code should equal(KSBatchLoaderErrorValueCountMismatch);
+        });
+    });
+});
+
+SPEC_END
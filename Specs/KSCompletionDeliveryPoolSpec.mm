@@ -0,0 +1,92 @@
+#import <Cedar/Cedar.h>
+#import "KSCompletionDeliveryPool.h"
+
+using namespace Cedar::Matchers;
+using namespace Cedar::Doubles;
+
+SPEC_BEGIN(KSCompletionDeliveryPoolSpec)
+
+describe(@"KSCompletionDeliveryPool", ^{
+    __block KSCompletionDeliveryPool *pool;
+    __block dispatch_semaphore_t gate;
+    __block dispatch_semaphore_t started;
+
+    // Occupies the single pool thread and fills the queue.
+    void (^saturate)(void) = ^{
+        gate = dispatch_semaphore_create(0);
+        started = dispatch_semaphore_create(0);
+        [pool tryExecute:^{
+            dispatch_semaphore_signal(started);
+            dispatch_semaphore_wait(gate, DISPATCH_TIME_FOREVER);
+        }];
+        dispatch_semaphore_wait(started, DISPATCH_TIME_FOREVER);
+        [pool tryExecute:^{}];
+    };
+
+    it(@"should deliver blocks on a pool thread and record queue waits", ^{
+        pool = [[KSCompletionDeliveryPool alloc] initWithThreadCount:1
+                                                   maximumQueueDepth:4
+                                                      overflowPolicy:KSCompletionDeliveryOverflowPolicyBlock];
+        __block NSThread *thread = nil;
+        dispatch_semaphore_t sema = dispatch_semaphore_create(0);
+        [pool execute:^{
+            thread = [NSThread currentThread];
+            dispatch_semaphore_signal(sema);
+        }];
+        dispatch_semaphore_wait(sema, DISPATCH_TIME_FOREVER);
+
+        thread should_not be_same_instance_as([NSThread currentThread]);
+        KSCompletionDeliveryPoolMetrics *metrics = [pool metrics];
+        metrics.deliveredCount should equal(1);
+        metrics.maximumQueueDepth should equal(1);
+        metrics.totalQueueWait should be_greater_than_or_equal_to(0);
+    });
+
+    context(@"when the queue is full", ^{
+        it(@"should reject with the reject policy", ^{
+            pool = [[KSCompletionDeliveryPool alloc] initWithThreadCount:1
+                                                       maximumQueueDepth:1
+                                                          overflowPolicy:KSCompletionDeliveryOverflowPolicyReject];
+            saturate();
+
+            __block BOOL ran = NO;
+            [pool tryExecute:^{ ran = YES; }] should equal(NO);
+            dispatch_semaphore_signal(gate);
+
+            ran should equal(NO);
+            [pool metrics].rejectedCount should equal(1);
+        });
+
+        it(@"should run the block on the calling thread with the inline policy", ^{
+            pool = [[KSCompletionDeliveryPool alloc] initWithThreadCount:1
+                                                       maximumQueueDepth:1
+                                                          overflowPolicy:KSCompletionDeliveryOverflowPolicyRunInline];
+            saturate();
+
+            __block NSThread *thread = nil;
+            [pool tryExecute:^{ thread = [NSThread currentThread]; }] should equal(YES);
+            dispatch_semaphore_signal(gate);
+
+            thread should be_same_instance_as([NSThread currentThread]);
+            [pool metrics].inlineCount should equal(1);
+        });
+
+        it(@"should wait for space with the block policy", ^{
+            pool = [[KSCompletionDeliveryPool alloc] initWithThreadCount:1
+                                                       maximumQueueDepth:1
+                                                          overflowPolicy:KSCompletionDeliveryOverflowPolicyBlock];
+            saturate();
+
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, 0.05 * NSEC_PER_SEC), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                dispatch_semaphore_signal(gate);
+            });
+            dispatch_semaphore_t sema = dispatch_semaphore_create(0);
+            [pool tryExecute:^{ dispatch_semaphore_signal(sema); }] should equal(YES);
+            dispatch_semaphore_wait(sema, DISPATCH_TIME_FOREVER);
+
+            [pool metrics].blockedCount should equal(1);
+        });
+    });
+});
+
+SPEC_END
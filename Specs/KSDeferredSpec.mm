@@ -4,6 +4,19 @@
 
 using namespace Cedar::Matchers;
 
+@interface KSDeferredSpecCountingExecutor : NSObject <KSExecutor>
+@property (nonatomic) NSUInteger executeCount;
+@end
+
+@implementation KSDeferredSpecCountingExecutor
+
+- (void)execute:(void (^)(void))block {
+    self.executeCount++;
+    block();
+}
+
+@end
+
 SPEC_BEGIN(KSDeferredSpec)
 
 describe(@"KSDeferred", ^{
@@ -23,6 +36,92 @@ describe(@"KSDeferred", ^{
         promise should_not be_nil;
     });
 
+    describe(@"bulk resolution", ^{
+        __block NSArray *deferreds;
+
+        beforeEach(^{
+            deferreds = @[deferred, [KSDeferred defer], [KSDeferred defer]];
+        });
+
+        it(@"should resolve every deferred with its value", ^{
+            [KSDeferred resolveDeferreds:deferreds withValues:@[@"A", [NSNull null], @"C"]];
+
+            [deferreds[0] promise].value should equal(@"A");
+            [deferreds[1] promise].fulfilled should be_truthy;
+            [deferreds[1] promise].value should be_nil;
+            [deferreds[2] promise].value should equal(@"C");
+        });
+
+        it(@"should reject every deferred with the error", ^{
+            NSError *error = [NSError errorWithDomain:@"MyError" code:1 userInfo:nil];
+            [KSDeferred rejectDeferreds:deferreds withError:error];
+
+            for (KSDeferred *each in deferreds) {
+                each.promise.error should equal(error);
+            }
+        });
+
+        it(@"should run continuations only once every deferred has settled", ^{
+            __block BOOL allSettledFirst = YES;
+            for (KSDeferred *each in deferreds) {
+                [each.promise then:^id(id value) {
+                    allSettledFirst = allSettledFirst && [deferreds.lastObject promise].fulfilled;
+                    return value;
+                }];
+            }
+            [KSDeferred resolveDeferreds:deferreds withValues:@[@"A", @"B", @"C"]];
+
+            allSettledFirst should be_truthy;
+        });
+
+        it(@"should hold back observers too, keeping registration order", ^{
+            NSMutableArray *order = [NSMutableArray array];
+            __block BOOL allSettledFirst = YES;
+            [deferred.promise then:^id(id value) {
+                [order addObject:@"then"];
+                return value;
+            }];
+            [deferred.promise onSettled:^(KSPromise *settled) {
+                [order addObject:@"observer"];
+                allSettledFirst = [deferreds.lastObject promise].fulfilled;
+            }];
+            [KSDeferred resolveDeferreds:deferreds withValues:@[@"A", @"B", @"C"]];
+
+            order should equal(@[@"then", @"observer"]);
+            allSettledFirst should be_truthy;
+        });
+
+        it(@"should hand each executor its continuations in one batch", ^{
+            KSDeferredSpecCountingExecutor *executor = [[KSDeferredSpecCountingExecutor alloc] init];
+            __block NSUInteger ran = 0;
+            for (KSDeferred *each in deferreds) {
+                [each.promise then:^id(id value) {
+                    ran++;
+                    return value;
+                } error:nil onExecutor:executor];
+            }
+            [KSDeferred resolveDeferreds:deferreds withValues:@[@"A", @"B", @"C"]];
+
+            ran should equal(3);
+            executor.executeCount should equal(1);
+        });
+
+        it(@"should let an inner batch join the outer one", ^{
+            __block BOOL ran = NO;
+            [promise then:^id(id value) {
+                ran = YES;
+                return value;
+            }];
+            [KSDeferred performBatchedResolution:^{
+                [KSDeferred performBatchedResolution:^{
+                    [deferred resolveWithValue:@"A"];
+                }];
+                ran should equal(NO);
+            }];
+            ran should equal(YES);
+        });
+    });
+
     describe(@"when", ^ {
         __block KSPromise *promise2;
         __block KSDeferred *deferred2;
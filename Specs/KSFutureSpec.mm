@@ -0,0 +1,219 @@
+#import <Cedar/Cedar.h>
+#import "KSDeferred.h"
+#import "KSFuture.h"
+
+using namespace Cedar::Matchers;
+using namespace Cedar::Doubles;
+
+SPEC_BEGIN(KSFutureSpec)
+
+describe(@"KSFuture", ^{
+    __block resolveType resolveFuture;
+    __block rejectType rejectFuture;
+    __block KSFuture *future;
+
+    beforeEach(^{
+        future = [KSFuture future:^(resolveType resolve, rejectType reject) {
+            resolveFuture = resolve;
+            rejectFuture = reject;
+        }];
+    });
+
+    describe(@"then:", ^{
+        it(@"should pass the value to the continuation once resolved", ^{
+            __block id received = nil;
+            [future then:^id(id value) {
+                received = value;
+                return value;
+            }];
+            received should be_nil;
+
+            resolveFuture(@"A");
+            received should equal(@"A");
+        });
+
+        it(@"should run the continuation immediately on a resolved future", ^{
+            __block id received = nil;
+            [[KSFuture resolve:@"A"] then:^id(id value) {
+                received = value;
+                return value;
+            }];
+            received should equal(@"A");
+        });
+
+        it(@"should chain values through the returned future", ^{
+            __block id received = nil;
+            [[[future then:^id(NSString *value) {
+                return [value stringByAppendingString:@"B"];
+            }] then:nil error:nil] then:^id(id value) {
+                received = value;
+                return value;
+            }];
+            resolveFuture(@"A");
+            received should equal(@"AB");
+        });
+
+        it(@"should pass errors past fulfilled callbacks to the next error callback", ^{
+            NSError *expected = [NSError errorWithDomain:@"Broken" code:1 userInfo:nil];
+            __block NSError *received = nil;
+            [[future then:^id(id value) {
+                return value;
+            }] error:^id(NSError *error) {
+                received = error;
+                return error;
+            }];
+            rejectFuture(expected);
+            received should equal(expected);
+        });
+
+        it(@"should adopt futures and promises returned from a callback", ^{
+            KSDeferred *deferred = [KSDeferred defer];
+            __block id received = nil;
+            [[[future then:^id(id value) {
+                return [KSFuture resolve:@"B"];
+            }] then:^id(id value) {
+                return deferred.promise;
+            }] then:^id(id value) {
+                received = value;
+                return value;
+            }];
+            resolveFuture(@"A");
+            received should be_nil;
+
+            [deferred resolveWithValue:@"C"];
+            received should equal(@"C");
+        });
+
+        it(@"should run the continuation on the executor", ^{
+            id<KSExecutor> queue = [KSMainThreadScheduler sharedScheduler];
+            __block BOOL onMainThread = NO;
+            dispatch_semaphore_t ran = dispatch_semaphore_create(0);
+            dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                [[KSFuture resolve:@"A"] then:^id(id value) {
+                    onMainThread = [NSThread isMainThread];
+                    dispatch_semaphore_signal(ran);
+                    return value;
+                } error:nil onExecutor:queue];
+            });
+            while (dispatch_semaphore_wait(ran, DISPATCH_TIME_NOW) != 0) {
+                [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+            }
+            onMainThread should be_truthy;
+        });
+    });
+
+    it(@"should let go of the value once it has been delivered", ^{
+        __weak id weakValue = nil;
+        @autoreleasepool {
+            NSMutableData *value = [NSMutableData dataWithLength:1024];
+            weakValue = value;
+            [future then:^id(id value) {
+                return nil;
+            }];
+            resolveFuture(value);
+        }
+        weakValue should be_nil;
+    });
+
+    describe(@"a second continuation", ^{
+        __block id received;
+
+        beforeEach(^{
+            received = nil;
+            [future then:^id(id value) {
+                received = value;
+                return value;
+            }];
+        });
+
+        it(@"should be rejected without disturbing the first", ^{
+            __block NSError *refused = nil;
+            [[future then:^id(id value) {
+                return value;
+            }] error:^id(NSError *error) {
+                refused = error;
+                return error;
+            }];
+            refused.domain should equal(KSFutureErrorDomain);
+            refused.code should equal(KSFutureErrorContinuationTaken);
+
+            resolveFuture(@"A");
+            received should equal(@"A");
+        });
+
+        it(@"should reject the promise made from the future", ^{
+            KSPromise *promise = [future promise];
+            promise.rejected should be_truthy;
+            promise.error.code should equal(KSFutureErrorContinuationTaken);
+
+            resolveFuture(@"A");
+            received should equal(@"A");
+        });
+
+        it(@"should not cancel the future when its child is cancelled", ^{
+            [[future then:^id(id value) {
+                return value;
+            }] cancel];
+            resolveFuture(@"A");
+            received should equal(@"A");
+        });
+    });
+
+    describe(@"converting", ^{
+        it(@"should settle with the promise it was made from", ^{
+            KSDeferred *deferred = [KSDeferred defer];
+            __block id received = nil;
+            [[KSFuture futureWithPromise:deferred.promise] then:^id(id value) {
+                received = value;
+                return value;
+            }];
+            [deferred resolveWithValue:@"A"];
+            received should equal(@"A");
+        });
+
+        it(@"should settle the promise made from it", ^{
+            KSPromise *promise = [future promise];
+            resolveFuture(@"A");
+            promise.value should equal(@"A");
+        });
+
+        it(@"should reject the promise made from a rejected future", ^{
+            NSError *expected = [NSError errorWithDomain:@"Broken" code:1 userInfo:nil];
+            KSPromise *promise = [future promise];
+            rejectFuture(expected);
+            promise.error should equal(expected);
+        });
+    });
+
+    describe(@"cancelling", ^{
+        it(@"should not run the continuation", ^{
+            __block BOOL ran = NO;
+            KSFuture *child = [future then:^id(id value) {
+                ran = YES;
+                return value;
+            }];
+            [child cancel];
+            resolveFuture(@"A");
+            ran should equal(NO);
+        });
+
+        it(@"should cancel the promise it was made from", ^{
+            KSDeferred *deferred = [KSDeferred defer];
+            [[KSFuture futureWithPromise:deferred.promise] cancel];
+            deferred.promise.cancelled should be_truthy;
+        });
+
+        it(@"should be cancelled by the promise made from it", ^{
+            __block BOOL ran = NO;
+            KSFuture *child = [future then:^id(id value) {
+                ran = YES;
+                return value;
+            }];
+            [[child promise] cancel];
+            resolveFuture(@"A");
+            ran should equal(NO);
+        });
+    });
+});
+
+SPEC_END
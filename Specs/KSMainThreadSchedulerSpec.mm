@@ -0,0 +1,116 @@
+#import <Cedar/Cedar.h>
+#import "KSDeferred.h"
+
+using namespace Cedar::Matchers;
+using namespace Cedar::Doubles;
+
+static void KSRunMainRunLoopUntil(BOOL (^condition)(void)) {
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:2.0];
+    while (!condition() && [timeout timeIntervalSinceNow] > 0) {
+        [[NSRunLoop mainRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+}
+
+SPEC_BEGIN(KSMainThreadSchedulerSpec)
+
+describe(@"KSMainThreadScheduler", ^{
+    __block KSMainThreadScheduler *scheduler;
+    __block NSMutableArray *drains;
+
+    beforeEach(^{
+        drains = [NSMutableArray array];
+        scheduler = [[KSMainThreadScheduler alloc] initWithFrameBudget:1.0];
+        scheduler.drainObserver = ^(KSMainThreadSchedulerDrainStatistics *statistics) {
+            [drains addObject:statistics];
+        };
+    });
+
+    it(@"should run blocks on the main thread in order", ^{
+        NSMutableArray *order = [NSMutableArray array];
+        __block BOOL onMainThread = NO;
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            [scheduler execute:^{
+                onMainThread = [NSThread isMainThread];
+                [order addObject:@1];
+            }];
+            [scheduler execute:^{
+                [order addObject:@2];
+            }];
+        });
+
+        KSRunMainRunLoopUntil(^BOOL{ return order.count == 2; });
+
+        order should equal(@[@1, @2]);
+        onMainThread should be_truthy;
+    });
+
+    it(@"should run everything in one turn when the budget allows it", ^{
+        __block NSUInteger executed = 0;
+        for (NSUInteger i = 0; i < 10; i++) {
+            [scheduler execute:^{
+                executed++;
+            }];
+        }
+
+        KSRunMainRunLoopUntil(^BOOL{ return executed == 10; });
+
+        drains.count should equal(1);
+        [drains[0] executedCount] should equal(10);
+        [drains[0] remainingCount] should equal(0);
+        scheduler.lastDrainStatistics should be_same_instance_as(drains[0]);
+    });
+
+    it(@"should yield to the run loop when the budget is spent", ^{
+        scheduler.frameBudget = 0;
+        __block NSUInteger executed = 0;
+        for (NSUInteger i = 0; i < 3; i++) {
+            [scheduler execute:^{
+                executed++;
+            }];
+        }
+
+        KSRunMainRunLoopUntil(^BOOL{ return executed == 3; });
+
+        drains.count should equal(3);
+        [drains[0] executedCount] should equal(1);
+        [drains[0] remainingCount] should equal(2);
+        [drains[2] remainingCount] should equal(0);
+        scheduler.pendingCount should equal(0);
+    });
+
+    it(@"should not grow its queue while it never empties", ^{
+        __block NSUInteger executed = 0;
+        __block NSUInteger largestQueue = 0;
+        __block void (^step)(void);
+        step = ^{
+            executed++;
+            largestQueue = MAX(largestQueue, [[scheduler valueForKey:@"queue"] count]);
+            if (executed < 1000) {
+                [scheduler execute:step];
+            }
+        };
+        // two chains, so there is always a block waiting behind the one running
+        [scheduler execute:step];
+        [scheduler execute:step];
+
+        KSRunMainRunLoopUntil(^BOOL{ return scheduler.pendingCount == 0; });
+        step = nil;
+
+        executed should be_gte(1000);
+        largestQueue should be_lte(8);
+    });
+
+    it(@"should run promise callbacks scheduled on it", ^{
+        __block id result = nil;
+        [[KSPromise resolve:@"A"] then:^id(id value) {
+            result = value;
+            return value;
+        } error:nil onExecutor:scheduler];
+
+        result should be_nil;
+        KSRunMainRunLoopUntil(^BOOL{ return result != nil; });
+        result should equal(@"A");
+    });
+});
+
+SPEC_END
@@ -0,0 +1,244 @@
+#import <Cedar/Cedar.h>
+#import "KSDeferred.h"
+#import "KSPromiseCache.h"
+
+using namespace Cedar::Matchers;
+
+SPEC_BEGIN(KSPromiseCacheSpec)
+
+describe(@"KSPromiseCache", ^{
+    __block KSPromiseCache *cache;
+    __block KSDeferred *deferred;
+    __block NSUInteger loads;
+    __block KSPromise *(^loader)(void);
+    __block NSError *expectedError;
+
+    beforeEach(^{
+        cache = [[KSPromiseCache alloc] init];
+        deferred = [KSDeferred defer];
+        loads = 0;
+        loader = ^KSPromise *{
+            loads++;
+            return deferred.promise;
+        };
+        expectedError = [NSError errorWithDomain:@"Broken" code:1 userInfo:nil];
+    });
+
+    it(@"should share one load between lookups while it is pending", ^{
+        KSPromise *first = [cache promiseForKey:@"a" loader:loader];
+        KSPromise *second = [cache promiseForKey:@"a" loader:loader];
+
+        loads should equal(1);
+
+        [deferred resolveWithValue:@"A"];
+        first.value should equal(@"A");
+        second.value should equal(@"A");
+    });
+
+    it(@"should keep loading for the other callers when one cancels", ^{
+        KSPromise *first = [cache promiseForKey:@"a" loader:loader];
+        KSPromise *second = [cache promiseForKey:@"a" loader:loader];
+
+        [first cancel];
+        deferred.promise.cancelled should equal(NO);
+        cache.count should equal(1);
+
+        [deferred resolveWithValue:@"A"];
+        second.value should equal(@"A");
+    });
+
+    it(@"should cancel the load once every caller has cancelled", ^{
+        KSPromise *first = [cache promiseForKey:@"a" loader:loader];
+        KSPromise *second = [cache promiseForKey:@"a" loader:loader];
+
+        [first cancel];
+        [first cancel];
+        deferred.promise.cancelled should equal(NO);
+        [second cancel];
+        deferred.promise.cancelled should be_truthy;
+        cache.count should equal(0);
+    });
+
+    it(@"should not drop a settled value when a caller cancels", ^{
+        [cache promiseForKey:@"a" loader:loader];
+        [deferred resolveWithValue:@"A"];
+
+        [[cache promiseForKey:@"a" loader:loader] cancel];
+        [cache cachedPromiseForKey:@"a"].value should equal(@"A");
+        loads should equal(1);
+    });
+
+    it(@"should keep fulfilled promises", ^{
+        [cache promiseForKey:@"a" loader:loader];
+        [deferred resolveWithValue:@"A"];
+
+        [cache promiseForKey:@"a" loader:loader].value should equal(@"A");
+        loads should equal(1);
+        [cache cachedPromiseForKey:@"a"].value should equal(@"A");
+        [cache cachedPromiseForKey:@"b"] should be_nil;
+    });
+
+    it(@"should load again once the time to live has passed", ^{
+        cache.timeToLive = 0.01;
+        [cache promiseForKey:@"a" loader:loader];
+        [deferred resolveWithValue:@"A"];
+        [NSThread sleepForTimeInterval:0.02];
+
+        [cache cachedPromiseForKey:@"a"] should be_nil;
+        [cache promiseForKey:@"a" loader:loader];
+        loads should equal(2);
+    });
+
+    describe(@"failures", ^{
+        it(@"should not keep them by default", ^{
+            KSPromise *promise = [cache promiseForKey:@"a" loader:loader];
+            [deferred rejectWithError:expectedError];
+
+            promise.error should equal(expectedError);
+            cache.count should equal(0);
+        });
+
+        it(@"should keep them for the failure time to live", ^{
+            cache.failureTimeToLive = 0.01;
+            [cache promiseForKey:@"a" loader:loader];
+            [deferred rejectWithError:expectedError];
+
+            [cache promiseForKey:@"a" loader:loader].error should equal(expectedError);
+            loads should equal(1);
+
+            [NSThread sleepForTimeInterval:0.02];
+            [cache cachedPromiseForKey:@"a"] should be_nil;
+        });
+    });
+
+    describe(@"the byte budget", ^{
+        it(@"should count NSData values by their length", ^{
+            loader = ^KSPromise *{
+                return [KSPromise resolve:[NSMutableData dataWithLength:100]];
+            };
+            [cache promiseForKey:@"a" loader:loader];
+            [cache promiseForKey:@"b" loader:loader];
+
+            cache.totalCost should equal(200);
+        });
+
+        it(@"should evict the least recently used values to stay within budget", ^{
+            cache.byteBudget = 16 * 10;
+            cache.costBlock = ^NSUInteger(id value) {
+                return 10;
+            };
+            for (NSUInteger i = 0; i < 100; i++) {
+                [cache promiseForKey:@(i) loader:^KSPromise *{
+                    return [KSPromise resolve:@(i)];
+                }];
+            }
+
+            cache.totalCost should be_lte(16 * 10);
+            cache.count should be_lte(16);
+            [cache cachedPromiseForKey:@99].value should equal(@99);
+        });
+
+        it(@"should apply to the whole cache rather than to each stripe", ^{
+            cache.byteBudget = 100;
+            cache.costBlock = ^NSUInteger(id value) {
+                return 40;
+            };
+            for (NSUInteger i = 0; i < 3; i++) {
+                [cache promiseForKey:@(i) loader:^KSPromise *{
+                    return [KSPromise resolve:@(i)];
+                }];
+            }
+
+            cache.totalCost should equal(80);
+            cache.count should equal(2);
+            [cache cachedPromiseForKey:@2].value should equal(@2);
+        });
+
+        it(@"should evict the least recently used values across every stripe", ^{
+            cache.byteBudget = 30;
+            cache.costBlock = ^NSUInteger(id value) {
+                return 10;
+            };
+            for (NSString *key in @[@"a", @"b", @"c"]) {
+                [cache promiseForKey:key loader:^KSPromise *{
+                    return [KSPromise resolve:key];
+                }];
+            }
+            [cache cachedPromiseForKey:@"a"];
+            [cache promiseForKey:@"d" loader:^KSPromise *{
+                return [KSPromise resolve:@"d"];
+            }];
+
+            [cache cachedPromiseForKey:@"b"] should be_nil;
+            [cache cachedPromiseForKey:@"a"].value should equal(@"a");
+            [cache cachedPromiseForKey:@"c"].value should equal(@"c");
+            [cache cachedPromiseForKey:@"d"].value should equal(@"d");
+
+            [cache promiseForKey:@"e" loader:^KSPromise *{
+                return [KSPromise resolve:@"e"];
+            }];
+            // a, c and d were just looked up in that order, so a is now the oldest
+            [cache cachedPromiseForKey:@"a"] should be_nil;
+            cache.count should equal(3);
+        });
+
+        it(@"should not keep a value costing more than the whole budget", ^{
+            cache.byteBudget = 100;
+            cache.costBlock = ^NSUInteger(id value) {
+                return 101;
+            };
+            [cache promiseForKey:@"a" loader:loader];
+            [deferred resolveWithValue:@"A"];
+
+            cache.totalCost should equal(0);
+            [cache cachedPromiseForKey:@"a"] should be_nil;
+        });
+    });
+
+    it(@"should drop settled promises but keep pending ones when memory runs low", ^{
+        [cache promiseForKey:@"settled" loader:^KSPromise *{
+            return [KSPromise resolve:@"A"];
+        }];
+        [cache promiseForKey:@"pending" loader:loader];
+        [cache evictSettledPromises];
+
+        [cache cachedPromiseForKey:@"settled"] should be_nil;
+        [cache cachedPromiseForKey:@"pending"] should_not be_nil;
+        cache.count should equal(1);
+    });
+
+    it(@"should drop a cancelled promise and cancel its load", ^{
+        [[cache promiseForKey:@"a" loader:loader] cancel];
+
+        deferred.promise.cancelled should be_truthy;
+        cache.count should equal(0);
+        [cache promiseForKey:@"a" loader:loader];
+        loads should equal(2);
+    });
+
+    it(@"should forget removed promises", ^{
+        [cache promiseForKey:@"a" loader:loader];
+        [cache promiseForKey:@"b" loader:loader];
+        [cache removePromiseForKey:@"a"];
+        [cache cachedPromiseForKey:@"a"] should be_nil;
+
+        [cache removeAllPromises];
+        cache.count should equal(0);
+    });
+
+    it(@"should share loads across threads", ^{
+        dispatch_apply(64, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+            [cache promiseForKey:@(i % 8) loader:^KSPromise *{
+                @synchronized (cache) {
+                    loads++;
+                }
+                return [KSPromise resolve:@(i % 8)];
+            }];
+        });
+
+        loads should equal(8);
+        [cache cachedPromiseForKey:@3].value should equal(@3);
+    });
+});
+
+SPEC_END
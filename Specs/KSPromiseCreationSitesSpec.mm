@@ -0,0 +1,85 @@
+#import <Cedar/Cedar.h>
+#import "KSDeferred.h"
+
+using namespace Cedar::Matchers;
+
+SPEC_BEGIN(KSPromiseCreationSitesSpec)
+
+describe(@"KSPromiseCreationSites", ^{
+    afterEach(^{
+        [KSPromiseCreationSites setSampleInterval:0];
+    });
+
+    it(@"should not record sites while sampling is off", ^{
+        KSPromise *promise = [KSPromise resolve:@"A"];
+        [KSPromiseCreationSites creationSiteOfPromise:promise] should be_nil;
+    });
+
+    context(@"when every promise is sampled", ^{
+        beforeEach(^{
+            [KSPromiseCreationSites setSampleInterval:1];
+        });
+
+        it(@"should record where a promise was created", ^{
+            KSDeferred *deferred = [KSDeferred defer];
+            [KSPromiseCreationSites creationSiteOfPromise:deferred.promise] should_not be_empty;
+        });
+
+        it(@"should record where then: was called", ^{
+            KSDeferred *deferred = [KSDeferred defer];
+            KSPromise *child = [deferred.promise then:^id(id value) {
+                return value;
+            }];
+            [KSPromiseCreationSites registrationSiteOfPromise:child] should_not be_empty;
+            [KSPromiseCreationSites registrationSiteOfPromise:deferred.promise] should be_nil;
+        });
+
+        it(@"should store a repeated stack once", ^{
+            [KSDeferred defer];
+            NSUInteger stacks = [KSPromiseCreationSites stackCount];
+            NSUInteger frames = [KSPromiseCreationSites frameCount];
+            for (NSUInteger i = 0; i < 1000; i++) {
+                [KSDeferred defer];
+            }
+            ([KSPromiseCreationSites stackCount] - stacks) should be_lte(2);
+            ([KSPromiseCreationSites frameCount] - frames) should be_lte(64);
+        });
+
+        it(@"should attach sites to traced events", ^{
+            [KSPromiseTracing reset];
+            [KSPromiseTracing start];
+            KSDeferred *deferred = [KSDeferred defer];
+            [KSPromiseTracing stop];
+
+            NSDictionary *trace = [NSJSONSerialization JSONObjectWithData:[KSPromiseTracing chromeTraceData] options:0 error:NULL];
+            NSDictionary *create = nil;
+            for (NSDictionary *event in trace[@"traceEvents"]) {
+                if ([event[@"ph"] isEqual:@"b"]) {
+                    create = event;
+                }
+            }
+            create should_not be_nil;
+            trace[@"stackFrames"][create[@"sf"]] should_not be_nil;
+            deferred should_not be_nil;
+        });
+    });
+
+    context(@"when one promise in four is sampled", ^{
+        beforeEach(^{
+            [KSPromiseCreationSites setSampleInterval:4];
+        });
+
+        it(@"should record a site for a quarter of them", ^{
+            NSUInteger sampled = 0;
+            for (NSUInteger i = 0; i < 40; i++) {
+                KSDeferred *deferred = [KSDeferred defer];
+                if ([KSPromiseCreationSites creationSiteOfPromise:deferred.promise]) {
+                    sampled++;
+                }
+            }
+            sampled should equal(10);
+        });
+    });
+});
+
+SPEC_END
@@ -0,0 +1,104 @@
+#import <Cedar/Cedar.h>
+#import "KSDeferred.h"
+#import "KSPromiseTracing.h"
+#import "KSPromiseCriticalPath.h"
+
+using namespace Cedar::Matchers;
+
+SPEC_BEGIN(KSPromiseCriticalPathSpec)
+
+describe(@"KSPromiseCriticalPath", ^{
+    beforeEach(^{
+        [KSPromiseTracing reset];
+        [KSPromiseTracing start];
+    });
+
+    afterEach(^{
+        [KSPromiseTracing stop];
+        [KSPromiseTracing reset];
+    });
+
+    it(@"should return nil for promises that were not traced", ^{
+        [KSPromiseTracing stop];
+        KSPromise *promise = [KSPromise resolve:@"A"];
+
+        [KSPromiseCriticalPath criticalPathToPromise:promise] should be_nil;
+    });
+
+    it(@"should return nil for pending promises", ^{
+        KSDeferred *deferred = [KSDeferred defer];
+
+        [KSPromiseCriticalPath criticalPathToPromise:deferred.promise] should be_nil;
+    });
+
+    describe(@"for a then: chain", ^{
+        __block KSPromise *child;
+
+        beforeEach(^{
+            KSDeferred *deferred = [KSDeferred defer];
+            child = [deferred.promise then:^id(id value) {
+                [NSThread sleepForTimeInterval:0.01];
+                return value;
+            }];
+            [NSThread sleepForTimeInterval:0.03];
+            [deferred resolveWithValue:@"A"];
+        });
+
+        it(@"should attribute the time to the wait for the parent and the callback", ^{
+            KSPromiseCriticalPath *path = [KSPromiseCriticalPath criticalPathToPromise:child];
+
+            path.externalTime should be_gte(0.03);
+            path.callbackTime should be_gte(0.01);
+            path.duration should be_gte(path.externalTime + path.callbackTime);
+            [path.stages.lastObject kind] should equal(KSPromiseCriticalPathStageCallback);
+        });
+
+        it(@"should name the longest stage", ^{
+            KSPromiseCriticalPath *path = [KSPromiseCriticalPath criticalPathToPromise:child];
+
+            path.dominantStage.kind should equal(KSPromiseCriticalPathStageExternal);
+            path.recommendation should contain(path.dominantStage.promiseIdentifier);
+        });
+
+        it(@"should find the same path in an exported trace", ^{
+            KSPromiseCriticalPath *path = [KSPromiseCriticalPath criticalPathToPromise:child];
+            KSPromiseCriticalPath *exported = [KSPromiseCriticalPath criticalPathInChromeTrace:[KSPromiseTracing chromeTraceData]
+                                                                          toPromiseIdentifier:[path.stages.lastObject promiseIdentifier]];
+
+            exported.stages.count should equal(path.stages.count);
+            [exported.stages valueForKey:@"promiseIdentifier"] should equal([path.stages valueForKey:@"promiseIdentifier"]);
+        });
+    });
+
+    it(@"should follow +when: through its last parent to settle", ^{
+        KSDeferred *fast = [KSDeferred defer];
+        KSDeferred *slow = [KSDeferred defer];
+        KSPromise *joined = [KSPromise when:@[fast.promise, slow.promise]];
+        [fast resolveWithValue:@"A"];
+        [NSThread sleepForTimeInterval:0.03];
+        [slow resolveWithValue:@"B"];
+
+        KSPromiseCriticalPath *path = [KSPromiseCriticalPath criticalPathToPromise:joined];
+        path.externalTime should be_gte(0.03);
+        path.dominantStage.kind should equal(KSPromiseCriticalPathStageExternal);
+    });
+
+    it(@"should follow a promise returned from a callback back into that callback", ^{
+        KSDeferred *first = [KSDeferred defer];
+        __block KSDeferred *second;
+        KSPromise *chained = [first.promise then:^id(id value) {
+            [NSThread sleepForTimeInterval:0.01];
+            second = [KSDeferred defer];
+            return second.promise;
+        }];
+        [first resolveWithValue:@"A"];
+        [NSThread sleepForTimeInterval:0.03];
+        [second resolveWithValue:@"B"];
+
+        KSPromiseCriticalPath *path = [KSPromiseCriticalPath criticalPathToPromise:chained];
+        path.externalTime should be_gte(0.03);
+        path.callbackTime should be_gte(0.01);
+    });
+});
+
+SPEC_END
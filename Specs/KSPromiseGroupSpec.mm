@@ -0,0 +1,122 @@
+#import <Cedar/Cedar.h>
+#import "KSDeferred.h"
+#import "KSPromiseGroup.h"
+
+using namespace Cedar::Matchers;
+using namespace Cedar::Doubles;
+
+SPEC_BEGIN(KSPromiseGroupSpec)
+
+describe(@"KSPromiseGroup", ^{
+    __block KSDeferred *first;
+    __block KSDeferred *second;
+    __block NSError *expectedError;
+
+    beforeEach(^{
+        first = [KSDeferred defer];
+        second = [KSDeferred defer];
+        expectedError = [NSError errorWithDomain:@"Broken" code:1 userInfo:nil];
+    });
+
+    it(@"should resolve with the values in spawn order once every task fulfills", ^{
+        KSPromise *promise = [KSPromiseGroup group:^(KSPromiseGroup *group) {
+            [group spawn:^KSPromise *{
+                return first.promise;
+            }];
+            [group spawn:^KSPromise *{
+                return second.promise;
+            }];
+        }];
+
+        [second resolveWithValue:@"B"];
+        promise.fulfilled should equal(NO);
+        [first resolveWithValue:nil];
+        promise.value should equal(@[[NSNull null], @"B"]);
+    });
+
+    it(@"should resolve an empty group when it closes", ^{
+        [KSPromiseGroup group:^(KSPromiseGroup *group) {}].value should equal(@[]);
+    });
+
+    it(@"should not resolve before it is closed", ^{
+        KSPromiseGroup *group = [[KSPromiseGroup alloc] init];
+        [group addPromise:first.promise];
+        [first resolveWithValue:@"A"];
+        group.promise.fulfilled should equal(NO);
+
+        [group close];
+        group.promise.value should equal(@[@"A"]);
+    });
+
+    it(@"should cancel the other tasks and reject when one fails", ^{
+        KSPromise *promise = [KSPromiseGroup group:^(KSPromiseGroup *group) {
+            [group addPromise:first.promise];
+            [group addPromise:second.promise];
+        }];
+
+        [first rejectWithError:expectedError];
+        promise.error should equal(expectedError);
+        second.promise.cancelled should equal(YES);
+    });
+
+    it(@"should cancel the other tasks and itself when a task is cancelled from outside", ^{
+        KSPromise *promise = [KSPromiseGroup group:^(KSPromiseGroup *group) {
+            [group addPromise:first.promise];
+            [group addPromise:second.promise];
+        }];
+
+        [first.promise cancel];
+        promise.cancelled should equal(YES);
+        second.promise.cancelled should equal(YES);
+    });
+
+    it(@"should leave settled tasks alone when it fails", ^{
+        __block BOOL cancelled = NO;
+        [first whenCancelled:^{
+            cancelled = YES;
+        }];
+        [KSPromiseGroup group:^(KSPromiseGroup *group) {
+            [group addPromise:first.promise];
+            [group addPromise:second.promise];
+        }];
+
+        [first resolveWithValue:@"A"];
+        [second rejectWithError:expectedError];
+        cancelled should equal(NO);
+    });
+
+    it(@"should not start tasks after it has failed", ^{
+        KSPromiseGroup *group = [[KSPromiseGroup alloc] init];
+        [group addPromise:[KSPromise reject:expectedError]];
+
+        __block BOOL started = NO;
+        KSPromise *late = [group spawn:^KSPromise *{
+            started = YES;
+            return first.promise;
+        }];
+        started should equal(NO);
+        late.cancelled should equal(YES);
+    });
+
+    it(@"should cancel its tasks when its promise is cancelled", ^{
+        KSPromise *promise = [KSPromiseGroup group:^(KSPromiseGroup *group) {
+            [group addPromise:first.promise];
+            [group addPromise:second.promise];
+        }];
+
+        [promise cancel];
+        first.promise.cancelled should equal(YES);
+        second.promise.cancelled should equal(YES);
+    });
+
+    it(@"should cancel its tasks when it is cancelled", ^{
+        KSPromiseGroup *group = [[KSPromiseGroup alloc] init];
+        [group addPromise:first.promise];
+        [group cancel];
+
+        first.promise.cancelled should equal(YES);
+        group.promise.cancelled should equal(YES);
+    });
+});
+
+SPEC_END
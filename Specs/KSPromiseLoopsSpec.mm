@@ -0,0 +1,175 @@
+#import <Cedar/Cedar.h>
+#import "KSDeferred.h"
+#import "KSPromise+Loops.h"
+
+using namespace Cedar::Matchers;
+using namespace Cedar::Doubles;
+
+SPEC_BEGIN(KSPromiseLoopsSpec)
+
+describe(@"KSPromise+Loops", ^{
+    __block NSError *expectedError;
+
+    beforeEach(^{
+        expectedError = [NSError errorWithDomain:@"Broken" code:1 userInfo:nil];
+    });
+
+    describe(@"+sequence:", ^{
+        it(@"should call each factory after the previous promise fulfills", ^{
+            KSDeferred *first = [KSDeferred defer];
+            __block BOOL secondCalled = NO;
+            KSPromise *promise = [KSPromise sequence:@[^{
+                return first.promise;
+            }, ^{
+                secondCalled = YES;
+                return [KSPromise resolve:@"B"];
+            }, ^{
+                return (KSPromise *)nil;
+            }]];
+            secondCalled should equal(NO);
+
+            [first resolveWithValue:@"A"];
+            secondCalled should equal(YES);
+            promise.value should equal(@[@"A", @"B", [NSNull null]]);
+        });
+
+        it(@"should reject with the first error and call no more factories", ^{
+            __block BOOL thirdCalled = NO;
+            KSPromise *promise = [KSPromise sequence:@[^{
+                return [KSPromise resolve:@"A"];
+            }, ^{
+                return [KSPromise reject:expectedError];
+            }, ^{
+                thirdCalled = YES;
+                return [KSPromise resolve:@"C"];
+            }]];
+
+            promise.error should equal(expectedError);
+            thirdCalled should equal(NO);
+        });
+
+        it(@"should resolve an empty sequence with an empty array", ^{
+            [KSPromise sequence:@[]].value should equal(@[]);
+        });
+    });
+
+    describe(@"+repeatWhile:initialValue:body:", ^{
+        it(@"should run the body until the condition fails", ^{
+            KSPromise *promise = [KSPromise repeatWhile:^BOOL(NSNumber *value) {
+                return value.integerValue < 5;
+            } initialValue:@0 body:^id(NSNumber *value) {
+                return [KSPromise resolve:@(value.integerValue + 1)];
+            }];
+
+            promise.value should equal(@5);
+        });
+
+        it(@"should wait for iterations that finish later", ^{
+            __block KSDeferred *pending = nil;
+            KSPromise *promise = [KSPromise repeatWhile:^BOOL(NSNumber *value) {
+                return value.integerValue < 2;
+            } initialValue:@0 body:^id(NSNumber *value) {
+                pending = [KSDeferred defer];
+                return pending.promise;
+            }];
+
+            [pending resolveWithValue:@1];
+            promise.fulfilled should equal(NO);
+            [pending resolveWithValue:@2];
+            promise.value should equal(@2);
+        });
+
+        it(@"should reject when the body returns an error", ^{
+            KSPromise *promise = [KSPromise repeatWhile:^BOOL(id value) {
+                return YES;
+            } initialValue:nil body:^id(id value) {
+                return expectedError;
+            }];
+
+            promise.error should equal(expectedError);
+        });
+
+        it(@"should run many synchronous iterations in constant stack and live promises", ^{
+            [KSPromiseMetrics start];
+            uint64_t live = [KSPromiseMetrics snapshot].liveCount;
+            __block int64_t mostLive = 0;
+            KSPromise *promise = [KSPromise repeatWhile:^BOOL(NSNumber *value) {
+                if (value.integerValue % 10000 == 0) {
+                    mostLive = MAX(mostLive, (int64_t)([KSPromiseMetrics snapshot].liveCount - live));
+                }
+                return value.integerValue < 200000;
+            } initialValue:@0 body:^id(NSNumber *value) {
+                return [KSPromise resolve:@(value.integerValue + 1)];
+            }];
+            [KSPromiseMetrics stop];
+
+            promise.value should equal(@200000);
+            mostLive should be_lte(4);
+        });
+
+        it(@"should stop starting iterations once cancelled", ^{
+            __block KSDeferred *pending = nil;
+            __block NSUInteger iterations = 0;
+            KSPromise *promise = [KSPromise repeatWhile:^BOOL(id value) {
+                return YES;
+            } initialValue:nil body:^id(id value) {
+                iterations++;
+                pending = [KSDeferred defer];
+                return pending.promise;
+            }];
+
+            [promise cancel];
+            [pending resolveWithValue:@"A"];
+            iterations should equal(1);
+        });
+    });
+
+    describe(@"+forEach:concurrency:block:", ^{
+        it(@"should keep at most concurrency iterations outstanding", ^{
+            NSMutableArray *deferreds = [NSMutableArray array];
+            NSArray *numbers = @[@0, @1, @2, @3, @4, @5];
+            KSPromise *promise = [KSPromise forEach:numbers concurrency:2 block:^id(id object) {
+                KSDeferred *deferred = [KSDeferred defer];
+                [deferreds addObject:deferred];
+                return deferred.promise;
+            }];
+
+            deferreds.count should equal(2);
+            [deferreds[0] resolveWithValue:nil];
+            deferreds.count should equal(3);
+            for (NSUInteger i = 1; i < numbers.count; i++) {
+                [deferreds[i] resolveWithValue:nil];
+            }
+            deferreds.count should equal(6);
+            promise.fulfilled should equal(YES);
+        });
+
+        it(@"should reject with the first error and start no more iterations", ^{
+            __block NSUInteger calls = 0;
+            KSPromise *promise = [KSPromise forEach:@[@0, @1, @2, @3] concurrency:1 block:^id(NSNumber *number) {
+                calls++;
+                return number.integerValue == 1 ? expectedError : number;
+            }];
+
+            promise.error should equal(expectedError);
+            calls should equal(2);
+        });
+
+        it(@"should run many synchronous iterations without overflowing the stack", ^{
+            NSMutableArray *numbers = [NSMutableArray array];
+            for (NSUInteger i = 0; i < 200000; i++) {
+                [numbers addObject:@(i)];
+            }
+            __block NSUInteger sum = 0;
+            KSPromise *promise = [KSPromise forEach:numbers concurrency:4 block:^id(NSNumber *number) {
+                sum += number.unsignedIntegerValue;
+                return [KSPromise resolve:number];
+            }];
+
+            promise.fulfilled should equal(YES);
+            sum should equal(199999UL * 200000UL / 2);
+        });
+    });
+});
+
+SPEC_END
@@ -0,0 +1,124 @@
+#import <Cedar/Cedar.h>
+#import "KSDeferred.h"
+#import "KSPromiseMetrics.h"
+
+using namespace Cedar::Matchers;
+
+SPEC_BEGIN(KSPromiseMetricsSpec)
+
+describe(@"KSPromiseMetrics", ^{
+    __block KSPromiseMetricsSnapshot *before;
+
+    beforeEach(^{
+        [KSPromiseMetrics start];
+        [KSPromiseMetrics reset];
+        before = [KSPromiseMetrics snapshot];
+    });
+
+    afterEach(^{
+        [KSPromiseMetrics setStallThreshold:0];
+        [KSPromiseMetrics setStallHandler:nil];
+        [KSPromiseCreationSites setSampleInterval:0];
+        [KSPromiseMetrics stop];
+    });
+
+    it(@"should count live and pending promises", ^{
+        KSDeferred *deferred = [KSDeferred defer];
+        KSPromiseMetricsSnapshot *pending = [KSPromiseMetrics snapshot];
+        (pending.createdCount - before.createdCount) should equal(1);
+        (pending.liveCount - before.liveCount) should equal(1);
+        (pending.pendingCount - before.pendingCount) should equal(1);
+
+        [deferred resolveWithValue:@"A"];
+        KSPromiseMetricsSnapshot *settled = [KSPromiseMetrics snapshot];
+        settled.pendingCount should equal(before.pendingCount);
+        (settled.liveCount - before.liveCount) should equal(1);
+    });
+
+    it(@"should count continuations waiting on pending promises", ^{
+        KSDeferred *deferred = [KSDeferred defer];
+        [deferred.promise then:^id(id value) { return value; }];
+        [deferred.promise then:^id(id value) { return value; }];
+
+        ([KSPromiseMetrics snapshot].continuationQueueDepth - before.continuationQueueDepth) should equal(2);
+
+        [deferred resolveWithValue:@"A"];
+        [KSPromiseMetrics snapshot].continuationQueueDepth should equal(before.continuationQueueDepth);
+    });
+
+    it(@"should drop the continuations of cancelled promises from the queue depth", ^{
+        KSDeferred *deferred = [KSDeferred defer];
+        [deferred.promise then:^id(id value) { return value; }];
+        [deferred.promise cancel];
+
+        [KSPromiseMetrics snapshot].continuationQueueDepth should equal(before.continuationQueueDepth);
+    });
+
+    it(@"should record callback and pending times", ^{
+        KSDeferred *deferred = [KSDeferred defer];
+        [deferred.promise then:^id(id value) {
+            [NSThread sleepForTimeInterval:0.005];
+            return value;
+        }];
+        [NSThread sleepForTimeInterval:0.01];
+        [deferred resolveWithValue:@"A"];
+
+        KSPromiseMetricsSnapshot *snapshot = [KSPromiseMetrics snapshot];
+        snapshot.callbackExecutionTime.count should equal(1);
+        snapshot.resolveToCallbackTime.count should equal(1);
+        snapshot.callbackExecutionTime.maximum should be_gte(0.005);
+        [snapshot.pendingTime valueAtPercentile:100] should be_gte(0.01);
+    });
+
+    it(@"should not count promises created while stopped", ^{
+        [KSPromiseMetrics stop];
+        KSDeferred *deferred = [KSDeferred defer];
+        [KSPromiseMetrics start];
+
+        [KSPromiseMetrics snapshot].createdCount should equal(before.createdCount);
+        deferred should_not be_nil;
+    });
+
+    describe(@"the stall watchdog", ^{
+        __block KSDeferred *deferred;
+
+        beforeEach(^{
+            [KSPromiseMetrics setStallThreshold:0.02];
+            [KSPromiseCreationSites setSampleInterval:1];
+            deferred = [KSDeferred defer];
+        });
+
+        it(@"should report promises pending past the threshold with their creation site", ^{
+            [NSThread sleepForTimeInterval:0.03];
+
+            NSArray *stalled = [KSPromiseMetrics snapshot].stalledPromises;
+            stalled.count should equal(1);
+            KSPromiseStallReport *report = stalled.firstObject;
+            report.promiseAddress should equal((uintptr_t)(__bridge void *)deferred.promise);
+            report.pendingDuration should be_gte(0.02);
+            report.creationSite should_not be_empty;
+        });
+
+        it(@"should stop reporting a promise once it settles", ^{
+            [NSThread sleepForTimeInterval:0.03];
+            [deferred resolveWithValue:@"A"];
+
+            [KSPromiseMetrics snapshot].stalledPromises should be_empty;
+        });
+
+        it(@"should call the stall handler once per promise", ^{
+            __block NSUInteger reports = 0;
+            dispatch_semaphore_t reported = dispatch_semaphore_create(0);
+            [KSPromiseMetrics setStallHandler:^(KSPromiseStallReport *report) {
+                reports++;
+                dispatch_semaphore_signal(reported);
+            }];
+
+            dispatch_semaphore_wait(reported, dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_SEC)) should equal(0);
+            [NSThread sleepForTimeInterval:0.05];
+            reports should equal(1);
+        });
+    });
+});
+
+SPEC_END
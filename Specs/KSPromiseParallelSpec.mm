@@ -0,0 +1,81 @@
+#import <Cedar/Cedar.h>
+#import "KSPromise+Parallel.h"
+
+using namespace Cedar::Matchers;
+using namespace Cedar::Doubles;
+
+SPEC_BEGIN(KSPromiseParallelSpec)
+
+describe(@"KSPromise+Parallel", ^{
+    __block NSMutableArray *numbers;
+
+    beforeEach(^{
+        numbers = [NSMutableArray array];
+        for (NSInteger i = 0; i < 1000; i++) {
+            [numbers addObject:@(i)];
+        }
+    });
+
+    describe(@"+parallelMap:chunkSize:block:", ^{
+        it(@"should resolve with the mapped values in order", ^{
+            KSPromise *promise = [KSPromise parallelMap:numbers chunkSize:64 block:^id(NSNumber *number) {
+                return @(number.integerValue * 2);
+            }];
+
+            NSArray *values = [promise waitForValue];
+            values.count should equal(1000);
+            values[0] should equal(@0);
+            values[999] should equal(@1998);
+        });
+
+        it(@"should replace nil results with NSNull", ^{
+            KSPromise *promise = [KSPromise parallelMap:@[@1, @2] chunkSize:0 block:^id(id object) {
+                return nil;
+            }];
+
+            [promise waitForValue] should equal(@[[NSNull null], [NSNull null]]);
+        });
+
+        it(@"should resolve an empty array with an empty array", ^{
+            KSPromise *promise = [KSPromise parallelMap:@[] chunkSize:0 block:^id(id object) {
+                return object;
+            }];
+
+            [promise waitForValue] should equal(@[]);
+        });
+
+        it(@"should reject when the block returns an error", ^{
+            NSError *error = [NSError errorWithDomain:@"ERROR" code:1 userInfo:nil];
+            KSPromise *promise = [KSPromise parallelMap:numbers chunkSize:10 block:^id(NSNumber *number) {
+                return number.integerValue == 500 ? error : number;
+            }];
+
+            [promise waitForValue] should equal(error);
+            promise.rejected should be_truthy;
+        });
+    });
+
+    describe(@"+parallelReduce:chunkSize:initialValue:block:combine:", ^{
+        it(@"should fold every chunk and combine the results", ^{
+            KSPromise *promise = [KSPromise parallelReduce:numbers chunkSize:37 initialValue:@0 block:^id(NSNumber *sum, NSNumber *number) {
+                return @(sum.integerValue + number.integerValue);
+            } combine:^id(NSNumber *left, NSNumber *right) {
+                return @(left.integerValue + right.integerValue);
+            }];
+
+            [promise waitForValue] should equal(@499500);
+        });
+
+        it(@"should resolve with the initial value for an empty array", ^{
+            KSPromise *promise = [KSPromise parallelReduce:@[] chunkSize:0 initialValue:@0 block:^id(id sum, id number) {
+                return number;
+            } combine:^id(id left, id right) {
+                return right;
+            }];
+
+            [promise waitForValue] should equal(@0);
+        });
+    });
+});
+
+SPEC_END
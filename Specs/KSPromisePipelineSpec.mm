@@ -0,0 +1,112 @@
+#import <Cedar/Cedar.h>
+#import "KSDeferred.h"
+#import "KSPromisePipeline.h"
+
+using namespace Cedar::Matchers;
+using namespace Cedar::Doubles;
+
+SPEC_BEGIN(KSPromisePipelineSpec)
+
+describe(@"KSPromisePipeline", ^{
+    __block NSError *expectedError;
+
+    beforeEach(^{
+        expectedError = [NSError errorWithDomain:@"Broken" code:1 userInfo:nil];
+    });
+
+    it(@"should run the stages in order", ^{
+        KSPromisePipeline *pipeline = [[[KSPromisePipeline pipeline] then:^id(NSString *value) {
+            return [value stringByAppendingString:@"B"];
+        }] then:^id(NSString *value) {
+            return [value stringByAppendingString:@"C"];
+        }];
+
+        pipeline.stageCount should equal(2);
+        [pipeline applyToPromise:[KSPromise resolve:@"A"]].value should equal(@"ABC");
+    });
+
+    it(@"should be reusable across promises", ^{
+        KSPromisePipeline *pipeline = [[KSPromisePipeline pipeline] then:^id(NSNumber *value) {
+            return @(value.integerValue * 2);
+        }];
+
+        [pipeline applyToPromise:[KSPromise resolve:@1]].value should equal(@2);
+        [pipeline applyToPromise:[KSPromise resolve:@5]].value should equal(@10);
+    });
+
+    it(@"should not change the pipeline it was built from", ^{
+        KSPromisePipeline *pipeline = [KSPromisePipeline pipeline];
+        [pipeline then:^id(id value) {
+            return value;
+        }];
+        pipeline.stageCount should equal(0);
+    });
+
+    it(@"should skip fulfilled callbacks after a stage returns an error", ^{
+        __block BOOL skipped = YES;
+        KSPromisePipeline *pipeline = [[[[KSPromisePipeline pipeline] then:^id(id value) {
+            return expectedError;
+        }] then:^id(id value) {
+            skipped = NO;
+            return value;
+        }] error:^id(NSError *error) {
+            return @"recovered";
+        }];
+
+        KSPromise *promise = [pipeline applyToPromise:[KSPromise resolve:@"A"]];
+        skipped should equal(YES);
+        promise.value should equal(@"recovered");
+    });
+
+    it(@"should reject with an error nothing handles", ^{
+        KSPromisePipeline *pipeline = [[KSPromisePipeline pipeline] then:^id(id value) {
+            return value;
+        }];
+
+        [pipeline applyToPromise:[KSPromise reject:expectedError]].error should equal(expectedError);
+    });
+
+    it(@"should reject when the last stage returns an error", ^{
+        KSPromisePipeline *pipeline = [[KSPromisePipeline pipeline] then:^id(id value) {
+            return expectedError;
+        }];
+
+        [pipeline applyToPromise:[KSPromise resolve:@"A"]].error should equal(expectedError);
+    });
+
+    it(@"should wait for a promise returned from a stage before running the rest", ^{
+        KSDeferred *deferred = [KSDeferred defer];
+        KSPromisePipeline *pipeline = [[[KSPromisePipeline pipeline] then:^id(id value) {
+            return deferred.promise;
+        }] then:^id(NSString *value) {
+            return [value stringByAppendingString:@"C"];
+        }];
+
+        KSPromise *promise = [pipeline applyToPromise:[KSPromise resolve:@"A"]];
+        promise.fulfilled should equal(NO);
+
+        [deferred resolveWithValue:@"B"];
+        promise.value should equal(@"BC");
+    });
+
+    it(@"should add a single child promise however many stages it has", ^{
+        KSPromisePipeline *pipeline = [KSPromisePipeline pipeline];
+        for (NSUInteger i = 0; i < 8; i++) {
+            pipeline = [pipeline then:^id(NSNumber *value) {
+                return @(value.integerValue + 1);
+            }];
+        }
+        KSPromise *source = [KSPromise resolve:@0];
+
+        [KSPromiseMetrics start];
+        uint64_t before = [KSPromiseMetrics snapshot].createdCount;
+        KSPromise *promise = [pipeline applyToPromise:source];
+        uint64_t created = [KSPromiseMetrics snapshot].createdCount - before;
+        [KSPromiseMetrics stop];
+
+        promise.value should equal(@8);
+        created should equal(1);
+    });
+});
+
+SPEC_END
@@ -198,6 +198,71 @@ describe(@"KSPromise", ^{
             });
         });
     });
+
+    describe(@"onSettled:", ^{
+        __block resolveType resolvePromise;
+        __block rejectType rejectPromise;
+
+        beforeEach(^{
+            promise = [KSPromise promise:^(resolveType resolve, rejectType reject) {
+                resolvePromise = resolve;
+                rejectPromise = reject;
+            }];
+        });
+
+        it(@"calls the observer with the promise once it is fulfilled", ^{
+            __block KSPromise *observed = nil;
+            [promise onSettled:^(KSPromise *settled) {
+                observed = settled;
+            }];
+            observed should be_nil;
+
+            resolvePromise(@"A");
+            observed should be_same_instance_as(promise);
+            observed.value should equal(@"A");
+        });
+
+        it(@"calls the observer once the promise is rejected", ^{
+            __block BOOL done = NO;
+            [promise onSettled:^(KSPromise *settled) {
+                done = settled.rejected;
+            }];
+            rejectPromise([NSError errorWithDomain:@"Broken" code:1 userInfo:nil]);
+            done should equal(YES);
+        });
+
+        it(@"calls the observer immediately on a settled promise", ^{
+            resolvePromise(@"A");
+            __block BOOL done = NO;
+            [promise onSettled:^(KSPromise *settled) {
+                done = YES;
+            }];
+            done should equal(YES);
+        });
+
+        it(@"runs observers and callbacks in the order they were registered", ^{
+            NSMutableArray *order = [NSMutableArray array];
+            [promise then:^id(id value) {
+                [order addObject:@"then"];
+                return value;
+            }];
+            [promise onSettled:^(KSPromise *settled) {
+                [order addObject:@"observer"];
+            }];
+            resolvePromise(@"A");
+            order should equal(@[@"then", @"observer"]);
+        });
+
+        it(@"does not call the observer of a cancelled promise", ^{
+            __block BOOL done = NO;
+            [promise onSettled:^(KSPromise *settled) {
+                done = YES;
+            }];
+            [promise cancel];
+            resolvePromise(@"A");
+            done should equal(NO);
+        });
+    });
 });
 
 SPEC_END
@@ -0,0 +1,31 @@
+#import <Foundation/Foundation.h>
+
+// Runs randomized interleavings of resolve, reject, then:error:, cancel,
+// addCancellable: and waitForValueWithTimeout: from many threads against a
+// shared set of promises, then checks that every promise settled at most once
+// and that every callback ran exactly once (or never, if the promise was
+// cancelled before it settled).
+
+@interface KSPromiseStressResult : NSObject
+
+@property (nonatomic, readonly) NSUInteger operationCount;
+@property (nonatomic, readonly) NSUInteger promiseCount;
+@property (nonatomic, readonly) NSUInteger duplicateSettleCount;
+@property (nonatomic, readonly) NSTimeInterval duration;
+@property (nonatomic, readonly) double operationsPerSecond;
+@property (nonatomic, readonly) NSArray<NSString *> *violations;
+
+@end
+
+
+@interface KSPromiseStressHarness : NSObject
+
+@property (nonatomic) NSUInteger threadCount;
+@property (nonatomic) NSUInteger rounds;
+@property (nonatomic) NSUInteger promisesPerRound;
+@property (nonatomic) NSUInteger operationsPerThread;
+@property (nonatomic) unsigned int seed;
+
+- (KSPromiseStressResult *)run;
+
+@end
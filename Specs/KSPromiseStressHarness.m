@@ -0,0 +1,312 @@
+#import "KSPromiseStressHarness.h"
+#import "KSDeferred.h"
+#import <pthread.h>
+#import <stdatomic.h>
+
+
+static NSString *const KSPromiseStressErrorDomain = @"KSPromiseStress";
+
+typedef NS_ENUM(NSUInteger, KSStressOperation) {
+    KSStressOperationResolve,
+    KSStressOperationReject,
+    KSStressOperationThen,
+    KSStressOperationCancel,
+    KSStressOperationAddCancellable,
+    KSStressOperationWait,
+    KSStressOperationCount
+};
+
+static atomic_uint_fast64_t ks_duplicateSettles;
+
+
+// Settling a settled promise is an expected race here; KSPromise asserts on
+// it, so count the assertion instead of raising.
+@interface KSStressAssertionHandler : NSAssertionHandler
+@end
+
+@implementation KSStressAssertionHandler
+
+- (void)handleFailureInMethod:(SEL)selector
+                       object:(id)object
+                         file:(NSString *)fileName
+                   lineNumber:(NSInteger)line
+                  description:(NSString *)format, ... {
+    atomic_fetch_add(&ks_duplicateSettles, 1);
+}
+
+@end
+
+
+@interface KSStressCancellable : NSObject <KSCancellable> {
+@public
+    atomic_uint cancelCount;
+}
+@end
+
+@implementation KSStressCancellable
+
+- (void)cancel {
+    atomic_fetch_add(&cancelCount, 1);
+}
+
+@end
+
+
+@interface KSStressRegistration : NSObject {
+@public
+    NSUInteger fulfilledCalls;
+    NSUInteger rejectedCalls;
+    id seen;
+}
+@end
+
+@implementation KSStressRegistration
+@end
+
+
+@interface KSStressRecord : NSObject {
+@public
+    pthread_mutex_t lock;
+    KSDeferred *deferred;
+    NSMutableSet *resolveAttempts;
+    NSMutableSet *rejectAttempts;
+    NSMutableArray *registrations;
+    NSMutableArray *cancellables;
+    NSMutableArray *observations;
+    NSUInteger cancelCount;
+}
+@end
+
+@implementation KSStressRecord
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&lock, NULL);
+        deferred = [KSDeferred defer];
+        resolveAttempts = [NSMutableSet set];
+        rejectAttempts = [NSMutableSet set];
+        registrations = [NSMutableArray array];
+        cancellables = [NSMutableArray array];
+        observations = [NSMutableArray array];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    pthread_mutex_destroy(&lock);
+}
+
+- (void)performOperation:(KSStressOperation)operation tag:(NSUInteger)tag {
+    KSPromise *promise = deferred.promise;
+    switch (operation) {
+        case KSStressOperationResolve: {
+            NSNumber *value = @(tag);
+            pthread_mutex_lock(&lock);
+            [resolveAttempts addObject:value];
+            pthread_mutex_unlock(&lock);
+            [deferred resolveWithValue:value];
+            break;
+        }
+        case KSStressOperationReject: {
+            NSError *error = [NSError errorWithDomain:KSPromiseStressErrorDomain code:tag userInfo:nil];
+            pthread_mutex_lock(&lock);
+            [rejectAttempts addObject:@(tag)];
+            pthread_mutex_unlock(&lock);
+            [deferred rejectWithError:error];
+            break;
+        }
+        case KSStressOperationThen: {
+            KSStressRegistration *registration = [[KSStressRegistration alloc] init];
+            pthread_mutex_lock(&lock);
+            [registrations addObject:registration];
+            pthread_mutex_unlock(&lock);
+            [promise then:^id(id value) {
+                pthread_mutex_lock(&self->lock);
+                registration->fulfilledCalls++;
+                registration->seen = value;
+                pthread_mutex_unlock(&self->lock);
+                return value;
+            } error:^id(NSError *error) {
+                pthread_mutex_lock(&self->lock);
+                registration->rejectedCalls++;
+                registration->seen = error;
+                pthread_mutex_unlock(&self->lock);
+                return error;
+            }];
+            break;
+        }
+        case KSStressOperationCancel:
+            pthread_mutex_lock(&lock);
+            cancelCount++;
+            pthread_mutex_unlock(&lock);
+            [promise cancel];
+            break;
+        case KSStressOperationAddCancellable: {
+            KSStressCancellable *cancellable = [[KSStressCancellable alloc] init];
+            pthread_mutex_lock(&lock);
+            [cancellables addObject:cancellable];
+            pthread_mutex_unlock(&lock);
+            [promise addCancellable:cancellable];
+            break;
+        }
+        case KSStressOperationWait: {
+            id observation = [promise waitForValueWithTimeout:0.0005];
+            if (![observation isKindOfClass:[NSError class]] || ![[observation domain] isEqualToString:@"KSPromise"]) {
+                pthread_mutex_lock(&lock);
+                [observations addObject:observation ? observation : [NSNull null]];
+                pthread_mutex_unlock(&lock);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+- (void)verifyIntoViolations:(NSMutableArray *)violations {
+    KSPromise *promise = deferred.promise;
+    NSString *name = [NSString stringWithFormat:@"<promise %p>", promise];
+    BOOL fulfilled = promise.fulfilled;
+    BOOL rejected = promise.rejected;
+    id final = fulfilled ? promise.value : promise.error;
+
+    if (fulfilled && rejected) {
+        [violations addObject:[name stringByAppendingString:@" was both fulfilled and rejected"]];
+        return;
+    }
+    if (fulfilled && ![resolveAttempts containsObject:promise.value]) {
+        [violations addObject:[NSString stringWithFormat:@"%@ was fulfilled with %@, which was never passed to resolve", name, promise.value]];
+    }
+    if (rejected && ![rejectAttempts containsObject:@(promise.error.code)]) {
+        [violations addObject:[NSString stringWithFormat:@"%@ was rejected with %@, which was never passed to reject", name, promise.error]];
+    }
+
+    for (KSStressRegistration *registration in registrations) {
+        NSUInteger calls = registration->fulfilledCalls + registration->rejectedCalls;
+        if (!fulfilled && !rejected) {
+            if (calls != 0) {
+                [violations addObject:[NSString stringWithFormat:@"%@ never settled but a callback ran %lu times", name, (unsigned long)calls]];
+            }
+        } else if (calls != 1) {
+            [violations addObject:[NSString stringWithFormat:@"%@ settled but a callback ran %lu times", name, (unsigned long)calls]];
+        } else if ((fulfilled && registration->fulfilledCalls != 1) || (rejected && registration->rejectedCalls != 1)) {
+            [violations addObject:[name stringByAppendingString:@" ran the wrong callback for its state"]];
+        } else if (registration->seen != final) {
+            [violations addObject:[NSString stringWithFormat:@"%@ passed %@ to a callback but settled with %@", name, registration->seen, final]];
+        }
+    }
+
+    for (id observation in observations) {
+        if (observation != final) {
+            [violations addObject:[NSString stringWithFormat:@"%@ returned %@ from a wait but settled with %@", name, observation, final]];
+        }
+    }
+
+    for (KSStressCancellable *cancellable in cancellables) {
+        unsigned int count = atomic_load(&cancellable->cancelCount);
+        if (cancelCount > 0 && count == 0) {
+            [violations addObject:[name stringByAppendingString:@" was cancelled but did not cancel a cancellable"]];
+        } else if (cancelCount == 0 && count > 0) {
+            [violations addObject:[name stringByAppendingString:@" cancelled a cancellable without being cancelled"]];
+        }
+    }
+}
+
+@end
+
+
+@interface KSPromiseStressResult ()
+@property (nonatomic, readwrite) NSUInteger operationCount;
+@property (nonatomic, readwrite) NSUInteger promiseCount;
+@property (nonatomic, readwrite) NSUInteger duplicateSettleCount;
+@property (nonatomic, readwrite) NSTimeInterval duration;
+@property (nonatomic, readwrite) NSArray<NSString *> *violations;
+@end
+
+@implementation KSPromiseStressResult
+
+- (double)operationsPerSecond {
+    return self.duration > 0 ? self.operationCount / self.duration : 0;
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %lu operations on %lu promises in %.3fs (%.0f ops/s), %lu duplicate settles, %lu violations>",
+            NSStringFromClass([self class]),
+            (unsigned long)self.operationCount, (unsigned long)self.promiseCount,
+            self.duration, self.operationsPerSecond,
+            (unsigned long)self.duplicateSettleCount, (unsigned long)self.violations.count];
+}
+
+@end
+
+
+@implementation KSPromiseStressHarness
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _threadCount = MAX([[NSProcessInfo processInfo] activeProcessorCount], (NSUInteger)4);
+        _rounds = 20;
+        _promisesPerRound = 64;
+        _operationsPerThread = 2000;
+        _seed = (unsigned int)time(NULL);
+    }
+    return self;
+}
+
+- (KSPromiseStressResult *)run {
+    NSMutableArray *violations = [NSMutableArray array];
+    NSUInteger threadCount = MAX(self.threadCount, (NSUInteger)1);
+    NSUInteger promisesPerRound = MAX(self.promisesPerRound, (NSUInteger)1);
+    NSUInteger operationsPerThread = self.operationsPerThread;
+    NSTimeInterval duration = 0;
+    uint64_t duplicatesBefore = atomic_load(&ks_duplicateSettles);
+
+    for (NSUInteger round = 0; round < self.rounds; round++) {
+        NSMutableArray *records = [NSMutableArray arrayWithCapacity:promisesPerRound];
+        for (NSUInteger i = 0; i < promisesPerRound; i++) {
+            [records addObject:[[KSStressRecord alloc] init]];
+        }
+        unsigned int roundSeed = self.seed + (unsigned int)round * 7919;
+
+        NSTimeInterval start = [[NSProcessInfo processInfo] systemUptime];
+        dispatch_apply(threadCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t thread) {
+            NSMutableDictionary *threadDictionary = [[NSThread currentThread] threadDictionary];
+            id previousHandler = threadDictionary[NSAssertionHandlerKey];
+            threadDictionary[NSAssertionHandlerKey] = [[KSStressAssertionHandler alloc] init];
+
+            unsigned int state = roundSeed ^ (unsigned int)(thread * 2654435761u);
+            for (NSUInteger i = 0; i < operationsPerThread; i++) {
+                @autoreleasepool {
+                    KSStressRecord *record = records[rand_r(&state) % promisesPerRound];
+                    KSStressOperation operation = rand_r(&state) % KSStressOperationCount;
+                    [record performOperation:operation tag:thread * operationsPerThread + i];
+                }
+            }
+
+            if (previousHandler) {
+                threadDictionary[NSAssertionHandlerKey] = previousHandler;
+            } else {
+                [threadDictionary removeObjectForKey:NSAssertionHandlerKey];
+            }
+        });
+        duration += [[NSProcessInfo processInfo] systemUptime] - start;
+
+        for (KSStressRecord *record in records) {
+            [record verifyIntoViolations:violations];
+            // pending callbacks capture the record; cancelling drops them
+            [record->deferred.promise cancel];
+        }
+    }
+
+    KSPromiseStressResult *result = [[KSPromiseStressResult alloc] init];
+    result.operationCount = self.rounds * threadCount * operationsPerThread;
+    result.promiseCount = self.rounds * promisesPerRound;
+    result.duplicateSettleCount = (NSUInteger)(atomic_load(&ks_duplicateSettles) - duplicatesBefore);
+    result.duration = duration;
+    result.violations = violations;
+    return result;
+}
+
+@end
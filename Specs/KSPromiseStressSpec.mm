@@ -0,0 +1,34 @@
+#import <Cedar/Cedar.h>
+#import "KSPromiseStressHarness.h"
+
+using namespace Cedar::Matchers;
+
+SPEC_BEGIN(KSPromiseStressSpec)
+
+describe(@"KSPromise under concurrent access", ^{
+    __block KSPromiseStressHarness *harness;
+
+    beforeEach(^{
+        harness = [[KSPromiseStressHarness alloc] init];
+        harness.rounds = 10;
+        harness.operationsPerThread = 1000;
+    });
+
+    it(@"should settle each promise once and run each callback exactly once", ^{
+        KSPromiseStressResult *result = [harness run];
+        NSLog(@"%@ (seed %u)", result, harness.seed);
+
+        result.violations should be_empty;
+        result.operationCount should equal(10 * harness.threadCount * 1000);
+    });
+
+    it(@"should hold up when many threads share a few promises", ^{
+        harness.promisesPerRound = 2;
+        KSPromiseStressResult *result = [harness run];
+        NSLog(@"%@ (seed %u)", result, harness.seed);
+
+        result.violations should be_empty;
+    });
+});
+
+SPEC_END
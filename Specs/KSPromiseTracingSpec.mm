@@ -0,0 +1,103 @@
+#import <Cedar/Cedar.h>
+#import "KSDeferred.h"
+#import "KSPromiseTracing.h"
+
+using namespace Cedar::Matchers;
+
+static NSArray *KSTraceEvents(void) {
+    NSDictionary *trace = [NSJSONSerialization JSONObjectWithData:[KSPromiseTracing chromeTraceData] options:0 error:NULL];
+    return trace[@"traceEvents"];
+}
+
+static NSArray *KSTraceEventsNamed(NSArray *events, NSString *name, NSString *phase) {
+    return [events filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"name == %@ AND ph == %@", name, phase]];
+}
+
+SPEC_BEGIN(KSPromiseTracingSpec)
+
+describe(@"KSPromiseTracing", ^{
+    beforeEach(^{
+        [KSPromiseTracing reset];
+    });
+
+    afterEach(^{
+        [KSPromiseTracing stop];
+        [KSPromiseTracing reset];
+    });
+
+    it(@"should not record anything until started", ^{
+        KSDeferred *deferred = [KSDeferred defer];
+        [deferred.promise then:^id(id value) { return value; }];
+        [deferred resolveWithValue:@"A"];
+
+        KSTraceEvents() should be_empty;
+    });
+
+    context(@"when started", ^{
+        __block KSDeferred *deferred;
+        __block KSPromise *child;
+
+        beforeEach(^{
+            [KSPromiseTracing start];
+            deferred = [KSDeferred defer];
+            child = [deferred.promise then:^id(id value) { return value; }];
+            [deferred resolveWithValue:@"A"];
+            [KSPromiseTracing stop];
+        });
+
+        it(@"should record each promise as an async span", ^{
+            NSArray *events = KSTraceEvents();
+            KSTraceEventsNamed(events, @"promise", @"b").count should equal(2);
+            NSArray *ends = KSTraceEventsNamed(events, @"promise", @"e");
+            ends.count should equal(2);
+            [ends valueForKeyPath:@"args.state"] should equal(@[@"fulfilled", @"fulfilled"]);
+        });
+
+        it(@"should link the then: registration to the child promise", ^{
+            NSArray *events = KSTraceEvents();
+            NSArray *thens = KSTraceEventsNamed(events, @"then", @"n");
+            thens.count should equal(1);
+
+            NSArray *creates = KSTraceEventsNamed(events, @"promise", @"b");
+            thens[0][@"id"] should equal(creates[0][@"id"]);
+            thens[0][@"args"][@"child"] should equal(creates[1][@"id"]);
+        });
+
+        it(@"should record the callback as a slice on the thread that ran it", ^{
+            NSArray *events = KSTraceEvents();
+            NSArray *begins = KSTraceEventsNamed(events, @"callback", @"B");
+            NSArray *ends = KSTraceEventsNamed(events, @"callback", @"E");
+            begins.count should equal(1);
+            ends.count should equal(1);
+            begins[0][@"tid"] should equal(ends[0][@"tid"]);
+        });
+
+        it(@"should record cancellation", ^{
+            [KSPromiseTracing start];
+            KSDeferred *cancelled = [KSDeferred defer];
+            [cancelled.promise cancel];
+            [KSPromiseTracing stop];
+
+            KSTraceEventsNamed(KSTraceEvents(), @"cancel", @"n").count should equal(1);
+        });
+
+        it(@"should record the parents of +when:", ^{
+            [KSPromiseTracing reset];
+            [KSPromiseTracing start];
+            KSDeferred *first = [KSDeferred defer];
+            KSDeferred *second = [KSDeferred defer];
+            [KSPromise when:@[first.promise, second.promise]];
+            [KSPromiseTracing stop];
+
+            KSTraceEventsNamed(KSTraceEvents(), @"when", @"n").count should equal(2);
+        });
+
+        it(@"should drop everything on reset", ^{
+            [KSPromiseTracing reset];
+
+            KSTraceEvents() should be_empty;
+        });
+    });
+});
+
+SPEC_END
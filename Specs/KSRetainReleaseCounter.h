@@ -0,0 +1,14 @@
+#import <Foundation/Foundation.h>
+
+// Counts -retain and -release messages sent to NSObject subclasses by the
+// thread that enabled counting, while it is enabled. The first call swaps
+// NSObject's implementations, which also moves every ARC retain and release
+// onto the counted message path.
+
+typedef struct {
+    uint64_t retains;
+    uint64_t releases;
+} KSRetainReleaseCount;
+
+void KSRetainReleaseCounterSetEnabled(BOOL enabled);
+KSRetainReleaseCount KSRetainReleaseCounterRead(void);
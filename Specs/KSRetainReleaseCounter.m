@@ -0,0 +1,59 @@
+#import "KSRetainReleaseCounter.h"
+#import <objc/runtime.h>
+#import <pthread.h>
+#import <stdatomic.h>
+
+
+static atomic_bool ks_countingEnabled;
+static pthread_t ks_countingThread;
+static atomic_uint_fast64_t ks_retains;
+static atomic_uint_fast64_t ks_releases;
+
+// Raw pointers keep ARC from retaining the receiver inside the hooks.
+static void *(*ks_originalRetain)(void *object, SEL _cmd);
+static void (*ks_originalRelease)(void *object, SEL _cmd);
+
+static void *KSCountingRetain(void *object, SEL _cmd) {
+    if (atomic_load_explicit(&ks_countingEnabled, memory_order_relaxed) &&
+        pthread_equal(pthread_self(), ks_countingThread)) {
+        atomic_fetch_add_explicit(&ks_retains, 1, memory_order_relaxed);
+    }
+    return ks_originalRetain(object, _cmd);
+}
+
+static void KSCountingRelease(void *object, SEL _cmd) {
+    if (atomic_load_explicit(&ks_countingEnabled, memory_order_relaxed) &&
+        pthread_equal(pthread_self(), ks_countingThread)) {
+        atomic_fetch_add_explicit(&ks_releases, 1, memory_order_relaxed);
+    }
+    ks_originalRelease(object, _cmd);
+}
+
+static void KSRetainReleaseCounterInstall(void) {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        Class class = [NSObject class];
+        Method retain = class_getInstanceMethod(class, sel_registerName("retain"));
+        Method release = class_getInstanceMethod(class, sel_registerName("release"));
+        ks_originalRetain = (void *(*)(void *, SEL))method_getImplementation(retain);
+        ks_originalRelease = (void (*)(void *, SEL))method_getImplementation(release);
+        method_setImplementation(retain, (IMP)KSCountingRetain);
+        method_setImplementation(release, (IMP)KSCountingRelease);
+    });
+}
+
+
+void KSRetainReleaseCounterSetEnabled(BOOL enabled) {
+    if (enabled) {
+        KSRetainReleaseCounterInstall();
+        ks_countingThread = pthread_self();
+    }
+    atomic_store(&ks_countingEnabled, enabled);
+}
+
+KSRetainReleaseCount KSRetainReleaseCounterRead(void) {
+    KSRetainReleaseCount count;
+    count.retains = atomic_load(&ks_retains);
+    count.releases = atomic_load(&ks_releases);
+    return count;
+}
@@ -0,0 +1,93 @@
+#import <Cedar/Cedar.h>
+#import "KSDeferred.h"
+#import <signal.h>
+
+using namespace Cedar::Matchers;
+
+SPEC_BEGIN(KSSlowCallbackWatchdogSpec)
+
+describe(@"KSSlowCallbackWatchdog", ^{
+    __block KSDeferred *deferred;
+
+    beforeEach(^{
+        [KSSlowCallbackWatchdog reset];
+        [KSSlowCallbackWatchdog setThreshold:0.02];
+        deferred = [KSDeferred defer];
+    });
+
+    afterEach(^{
+        [KSSlowCallbackWatchdog setThreshold:0];
+        [KSSlowCallbackWatchdog setHandler:nil];
+        [KSSlowCallbackWatchdog setStackSampleSignal:0];
+    });
+
+    it(@"should not report fast callbacks", ^{
+        [deferred.promise then:^id(id value) {
+            return value;
+        }];
+        [deferred resolveWithValue:@"A"];
+
+        [KSSlowCallbackWatchdog recentReports] should be_empty;
+    });
+
+    it(@"should report callbacks that run past the threshold", ^{
+        [deferred.promise then:^id(id value) {
+            [NSThread sleepForTimeInterval:0.03];
+            return value;
+        }];
+        [deferred resolveWithValue:@"A"];
+
+        NSArray *reports = [KSSlowCallbackWatchdog recentReports];
+        reports.count should equal(1);
+        KSSlowCallbackReport *report = reports.firstObject;
+        report.completed should be_truthy;
+        report.duration should be_gte(0.03);
+        report.callbackAddress should_not equal(0);
+        report.callbackSymbol.length should be_gte(1);
+    });
+
+    it(@"should time error callbacks", ^{
+        [deferred.promise then:nil error:^id(NSError *error) {
+            [NSThread sleepForTimeInterval:0.03];
+            return error;
+        }];
+        [deferred rejectWithError:[NSError errorWithDomain:@"KSSlowCallbackWatchdogSpec" code:1 userInfo:nil]];
+
+        [KSSlowCallbackWatchdog recentReports].count should equal(1);
+    });
+
+    it(@"should not time anything while off", ^{
+        [KSSlowCallbackWatchdog setThreshold:0];
+        [deferred.promise then:^id(id value) {
+            [NSThread sleepForTimeInterval:0.03];
+            return value;
+        }];
+        [deferred resolveWithValue:@"A"];
+
+        [KSSlowCallbackWatchdog recentReports] should be_empty;
+    });
+
+    it(@"should report a callback while it is still running with a sampled stack", ^{
+        [KSSlowCallbackWatchdog setStackSampleSignal:SIGUSR2];
+        __block KSSlowCallbackReport *running = nil;
+        dispatch_semaphore_t reported = dispatch_semaphore_create(0);
+        [KSSlowCallbackWatchdog setHandler:^(KSSlowCallbackReport *report) {
+            if (!report.completed) {
+                running = report;
+                dispatch_semaphore_signal(reported);
+            }
+        }];
+        [deferred.promise then:^id(id value) {
+            dispatch_semaphore_wait(reported, dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_SEC));
+            return value;
+        }];
+        [deferred resolveWithValue:@"A"];
+
+        running should_not be_nil;
+        running.duration should be_gte(0.02);
+        running.runningStack should_not be_empty;
+        [KSSlowCallbackWatchdog recentReports].count should equal(1);
+    });
+});
+
+SPEC_END
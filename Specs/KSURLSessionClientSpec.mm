@@ -1,5 +1,6 @@
 #import <Cedar/Cedar.h>
 #import "KSURLSessionClient.h"
+#import "KSCompletionDeliveryPool.h"
 #import "KSPromise.h"
 #import "KSNetworkClientSpecURLProtocol.h"
 
@@ -73,6 +74,35 @@ describe(@"KSURLSessionClient", ^{
         });
     });
 
+    context(@"when created with a delivery pool", ^{
+        __block KSCompletionDeliveryPool *pool;
+
+        beforeEach(^{
+            [NSURLProtocol registerClass:[KSNetworkClientSpecURLProtocol class]];
+            pool = [[KSCompletionDeliveryPool alloc] initWithThreadCount:1
+                                                       maximumQueueDepth:8
+                                                          overflowPolicy:KSCompletionDeliveryOverflowPolicyBlock];
+            client = [[KSURLSessionClient alloc] initWithURLSession:[NSURLSession sharedSession] deliveryPool:pool];
+        });
+
+        it(@"should deliver the completion on the pool instead of the queue", ^{
+            NSURLRequest *request = [[NSURLRequest alloc] initWithURL:[NSURL URLWithString:@"pass://foo"]];
+            KSPromise KS_GENERIC(KSNetworkResponse *) *promise = [client sendAsynchronousRequest:request queue:queue];
+            __block NSOperationQueue *successQueue = queue;
+
+            dispatch_semaphore_t sema = dispatch_semaphore_create(0);
+            [promise then:^id(KSNetworkResponse *value) {
+                successQueue = [NSOperationQueue currentQueue];
+                dispatch_semaphore_signal(sema);
+                return value;
+            }];
+            dispatch_semaphore_wait(sema, DISPATCH_TIME_FOREVER);
+
+            successQueue should_not be_same_instance_as(queue);
+            [pool metrics].deliveredCount should equal(1);
+        });
+    });
+
     context(@"when created with a provided session", ^{
         beforeEach(^{
             NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
@@ -0,0 +1,141 @@
+#import <Cedar/Cedar.h>
+#import "KSDeferred.h"
+
+using namespace Cedar::Matchers;
+using namespace Cedar::Doubles;
+
+SPEC_BEGIN(KSWorkStealingExecutorSpec)
+
+describe(@"KSWorkStealingExecutor", ^{
+    __block KSWorkStealingExecutor *executor;
+
+    beforeEach(^{
+        executor = [[KSWorkStealingExecutor alloc] initWithWorkerCount:1];
+    });
+
+    afterEach(^{
+        [executor shutdown];
+    });
+
+    it(@"should run blocks off the calling thread", ^{
+        __block NSThread *thread = nil;
+        dispatch_semaphore_t sema = dispatch_semaphore_create(0);
+        [executor execute:^{
+            thread = [NSThread currentThread];
+            dispatch_semaphore_signal(sema);
+        }];
+        dispatch_semaphore_wait(sema, DISPATCH_TIME_FOREVER);
+
+        thread should_not be_nil;
+        thread should_not be_same_instance_as([NSThread currentThread]);
+    });
+
+    it(@"should run blocks submitted after shutdown inline", ^{
+        [executor shutdown];
+        KSPromise *promise = [[KSPromise resolve:@"A"] then:^id(id value) {
+            return value;
+        } error:nil onExecutor:executor];
+
+        promise.value should equal(@"A");
+    });
+
+    it(@"should run every block when execute: races shutdown", ^{
+        dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+        for (NSUInteger round = 0; round < 50; round++) {
+            KSWorkStealingExecutor *racing = [[KSWorkStealingExecutor alloc] initWithWorkerCount:2];
+            dispatch_group_t group = dispatch_group_create();
+            dispatch_apply(64, queue, ^(size_t i) {
+                if (i == 32) {
+                    [racing shutdown];
+                }
+                dispatch_group_enter(group);
+                [racing execute:^{
+                    dispatch_group_leave(group);
+                }];
+            });
+
+            long timedOut = dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, 5 * NSEC_PER_SEC));
+            timedOut should equal(0);
+        }
+    });
+
+    it(@"should run blocks scheduled from a worker on that worker, newest first", ^{
+        NSMutableArray *order = [NSMutableArray array];
+        __block NSThread *outerThread = nil;
+        __block NSThread *innerThread = nil;
+        dispatch_semaphore_t sema = dispatch_semaphore_create(0);
+        [executor execute:^{
+            outerThread = [NSThread currentThread];
+            [executor execute:^{
+                [order addObject:@"first"];
+                dispatch_semaphore_signal(sema);
+            }];
+            [executor execute:^{
+                [order addObject:@"second"];
+                innerThread = [NSThread currentThread];
+            }];
+        }];
+        dispatch_semaphore_wait(sema, DISPATCH_TIME_FOREVER);
+
+        order should equal(@[@"second", @"first"]);
+        innerThread should be_same_instance_as(outerThread);
+    });
+
+    describe(@"+async:onExecutor:", ^{
+        it(@"should resolve with the value returned by the block", ^{
+            KSPromise *promise = [KSPromise async:^id{
+                return @"A";
+            } onExecutor:executor];
+
+            [promise waitForValue] should equal(@"A");
+            promise.fulfilled should be_truthy;
+        });
+
+        it(@"should reject when the block returns an error", ^{
+            NSError *error = [NSError errorWithDomain:@"ERROR" code:1 userInfo:nil];
+            KSPromise *promise = [KSPromise async:^id{
+                return error;
+            } onExecutor:executor];
+
+            [promise waitForValue] should equal(error);
+            promise.rejected should be_truthy;
+        });
+
+        it(@"should chain a promise returned by the block", ^{
+            KSPromise *promise = [KSPromise async:^id{
+                return [KSPromise async:^id{
+                    return @"B";
+                } onExecutor:executor];
+            } onExecutor:executor];
+
+            [promise waitForValue] should equal(@"B");
+        });
+
+        it(@"should join fork-join trees of async promises", ^{
+            NSMutableArray *promises = [NSMutableArray array];
+            for (NSInteger i = 0; i < 100; i++) {
+                [promises addObject:[KSPromise async:^id{
+                    return @(i);
+                } onExecutor:[KSWorkStealingExecutor sharedExecutor]]];
+            }
+
+            NSArray *values = [[KSPromise when:promises] waitForValue];
+            values.count should equal(100);
+        });
+    });
+
+    describe(@"-then:error:onExecutor:", ^{
+        it(@"should run the callback on the executor", ^{
+            __block NSThread *thread = nil;
+            KSPromise *promise = [[KSPromise resolve:@"A"] then:^id(id value) {
+                thread = [NSThread currentThread];
+                return [value stringByAppendingString:@"B"];
+            } error:nil onExecutor:executor];
+
+            [promise waitForValue] should equal(@"AB");
+            thread should_not be_same_instance_as([NSThread currentThread]);
+        });
+    });
+});
+
+SPEC_END